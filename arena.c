@@ -0,0 +1,89 @@
+// arena.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ALIGN_UP(n) (((n) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+#define BLOCK_HEADER ALIGN_UP(sizeof(ArenaBlock))
+
+static ArenaBlock* new_block(size_t size) {
+    ArenaBlock* block = malloc(BLOCK_HEADER + size);
+    if (!block) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void arena_init(Arena* arena, size_t block_size) {
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->block_size = block_size ? ALIGN_UP(block_size) : 64 * 1024;
+    arena->bytes_used = 0;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = ALIGN_UP(size ? size : 1);
+
+    // Walk forward through blocks kept by a previous reset before growing.
+    ArenaBlock* block = arena->current;
+    while (block && block->used + size > block->size) {
+        block = block->next;
+        if (block) block->used = 0;
+    }
+
+    if (!block) {
+        block = new_block(size > arena->block_size ? size : arena->block_size);
+        if (arena->current) {
+            block->next = arena->current->next;
+            arena->current->next = block;
+        } else {
+            arena->head = block;
+        }
+    }
+    arena->current = block;
+
+    void* ptr = (char*)block + BLOCK_HEADER + block->used;
+    block->used += size;
+    arena->bytes_used += size;
+    return ptr;
+}
+
+char* arena_strdup(Arena* arena, const char* s) {
+    size_t len = strlen(s) + 1;
+    char* copy = arena_alloc(arena, len);
+    memcpy(copy, s, len);
+    return copy;
+}
+
+void arena_reset(Arena* arena) {
+    if (arena->head) arena->head->used = 0;
+    arena->current = arena->head;
+    arena->bytes_used = 0;
+}
+
+void arena_destroy(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->bytes_used = 0;
+}
+
+size_t arena_reserved(const Arena* arena) {
+    size_t total = 0;
+    for (ArenaBlock* block = arena->head; block; block = block->next) {
+        total += BLOCK_HEADER + block->size;
+    }
+    return total;
+}
@@ -0,0 +1,32 @@
+// arena.h
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump-pointer region. Individual allocations are never freed; the whole
+// region is recycled with arena_reset or released with arena_destroy.
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+    // payload follows
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;
+    ArenaBlock* current;
+    size_t block_size;
+    size_t bytes_used;      // bytes handed out since the last reset, each
+                            // request rounded up to 16-byte alignment
+} Arena;
+
+void   arena_init(Arena* arena, size_t block_size);
+void*  arena_alloc(Arena* arena, size_t size);
+char*  arena_strdup(Arena* arena, const char* s);
+void   arena_reset(Arena* arena);      // keeps the blocks for reuse
+void   arena_destroy(Arena* arena);    // returns every block to the heap
+size_t arena_reserved(const Arena* arena);
+
+#endif
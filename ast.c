@@ -4,91 +4,130 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ast.h"
+#include "arena.h"
+#include "intern.h"
+#include "trace.h"
+#include "walk.h"
 
-static void* checked_malloc(size_t size) {
-    void* ptr = malloc(size);
-    if (!ptr) {
-        fprintf(stderr, "Out of memory\n");
-        exit(1);
+#define AST_ARENA_BLOCK (256 * 1024)
+
+// Owns every node and statement array of the current compilation.
+static _Thread_local Arena ast_arena;
+static _Thread_local int ast_arena_ready = 0;
+static _Thread_local size_t ast_node_count = 0;
+
+static Arena* current_arena() {
+    if (!ast_arena_ready) {
+        arena_init(&ast_arena, AST_ARENA_BLOCK);
+        ast_arena_ready = 1;
     }
-    return ptr;
+    return &ast_arena;
+}
+
+static void* arena_malloc(size_t size) {
+    return arena_alloc(current_arena(), size);
+}
+
+static ASTNode* new_node(NodeType type) {
+    ASTNode* node = arena_malloc(sizeof(ASTNode));
+    node->type = type;
+    node->resolved_type = TYPE_UNKNOWN;
+    ast_node_count++;
+    return node;
+}
+
+void ast_arena_reset() {
+    if (ast_arena_ready) arena_reset(&ast_arena);
+    ast_node_count = 0;
+}
+
+void ast_arena_destroy() {
+    if (ast_arena_ready) arena_destroy(&ast_arena);
+    ast_arena_ready = 0;
+    ast_node_count = 0;
+}
+
+AstArenaStats ast_arena_stats() {
+    AstArenaStats stats;
+    stats.nodes = ast_node_count;
+    stats.bytes_used = ast_arena_ready ? ast_arena.bytes_used : 0;
+    stats.bytes_reserved = ast_arena_ready ? arena_reserved(&ast_arena) : 0;
+    return stats;
 }
 
 ASTNode* make_int_node(int value) {
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    node->type = NODE_INT;
+    ASTNode* node = new_node(NODE_INT);
     node->int_value = value;
     return node;
 }
 ASTNode* make_bool_node(int value) {
-  printf("DEBUG: Make bool node with value %d\n", value);
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    if (!node){
-      fprintf(stderr, "Memory allocation failed for bool node");
-      exit(1);
-    }
-    node->type = NODE_BOOL;
+  TRACE(TRACE_AST, TRACE_DEBUG, "Make bool node with value %d\n", value);
+    ASTNode* node = new_node(NODE_BOOL);
     node->int_value = value; // same field used for ints
-    printf("DEBUG: Bool node created %p\n", (void*)node);
+    TRACE(TRACE_AST, TRACE_VERBOSE, "Bool node created %p\n", (void*)node);
     return node;
 }
 
 
-ASTNode* make_var_node(char* name) {
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    node->type = NODE_VAR;
-    node->var_name = strdup(name);
+ASTNode* make_var_node(int var_id) {
+    ASTNode* node = new_node(NODE_VAR);
+    node->var_id = var_id;
+    node->var_symbol = -1;
     return node;
 }
 
-ASTNode* make_binop_node(char* op, ASTNode* left, ASTNode* right) {
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    node->type = NODE_BINOP;
-    node->binop.op = strdup(op);
+ASTNode* make_binop_node(BinOp op, ASTNode* left, ASTNode* right) {
+    ASTNode* node = new_node(NODE_BINOP);
+    node->binop.op = op;
+    node->binop.line = 0;
     node->binop.left = left;
     node->binop.right = right;
     return node;
 }
 
-ASTNode* make_assign_node(char* name, ASTNode* expr) {
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    node->type = NODE_ASSIGN;
-    node->assign.var_name = strdup(name);
+ASTNode* make_assign_node(int var_id, ASTNode* expr) {
+    ASTNode* node = new_node(NODE_ASSIGN);
+    node->assign.var_id = var_id;
+    node->assign.symbol = -1;
     node->assign.expr = expr;
     return node;
 }
 
-ASTNode* make_declaration_node(char* name, ASTNode* init, Type declared_type) {
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    node->type = NODE_DECL;
-    node->decl.var_name = strdup(name);
+ASTNode* make_declaration_node(int var_id, ASTNode* init, Type declared_type) {
+    ASTNode* node = new_node(NODE_DECL);
+    node->decl.var_id = var_id;
+    node->decl.symbol = -1;
     node->decl.init_value = init;
     node->decl.declared_type = declared_type;
     return node;
 }
 
 ASTNode* make_print_node(ASTNode* expr) {
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    node->type = NODE_PRINT;
+    ASTNode* node = new_node(NODE_PRINT);
     node->print_expr = expr;
     return node;
 }
 
 ASTNode* make_if_node(ASTNode* condition, ASTNode* if_body, ASTNode* else_body) {
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    node->type = NODE_IF;
+    ASTNode* node = new_node(NODE_IF);
     node->if_stmt.condition = condition;
     node->if_stmt.if_body = if_body;
     node->if_stmt.else_body = else_body;
     return node;
 }
 
+ASTNode* make_while_node(ASTNode* condition, ASTNode* body) {
+    ASTNode* node = new_node(NODE_WHILE);
+    node->while_stmt.condition = condition;
+    node->while_stmt.body = body;
+    return node;
+}
+
 ASTNode* make_stmt_list_node() {
-    ASTNode* node = checked_malloc(sizeof(ASTNode));
-    node->type = NODE_STMT_LIST;
+    ASTNode* node = new_node(NODE_STMT_LIST);
     node->stmt_list.count = 0;
     node->stmt_list.capacity = 4;
-    node->stmt_list.stmts = checked_malloc(sizeof(ASTNode*) * node->stmt_list.capacity);
+    node->stmt_list.stmts = arena_malloc(sizeof(ASTNode*) * node->stmt_list.capacity);
     return node;
 }
 
@@ -98,59 +137,114 @@ void add_statement(ASTNode* list, ASTNode* stmt) {
         exit(1);
     }
     if (list->stmt_list.count == list->stmt_list.capacity) {
+        // The old array stays in the arena until the next reset
+        ASTNode** grown = arena_malloc(sizeof(ASTNode*) * list->stmt_list.capacity * 2);
+        memcpy(grown, list->stmt_list.stmts, sizeof(ASTNode*) * list->stmt_list.count);
+        list->stmt_list.stmts = grown;
         list->stmt_list.capacity *= 2;
-        list->stmt_list.stmts = realloc(list->stmt_list.stmts, sizeof(ASTNode*) * list->stmt_list.capacity);
     }
     list->stmt_list.stmts[list->stmt_list.count++] = stmt;
 }
-void print_ast(ASTNode* node, int indent) {
+const char* binop_symbol(BinOp op) {
+    switch (op) {
+        case OP_ADD: return "+";
+        case OP_SUB: return "-";
+        case OP_MUL: return "*";
+        case OP_DIV: return "/";
+        case OP_EQ:  return "==";
+        case OP_NE:  return "!=";
+        case OP_LT:  return "<";
+        case OP_LE:  return "<=";
+        case OP_GT:  return ">";
+        case OP_GE:  return ">=";
+    }
+    return "?";
+}
+
+// Pre-order walk on an explicit stack; children are pushed in reverse so
+// they pop in source order. Frames in state PRINT_THEN/PRINT_ELSE/PRINT_DO
+// only print their label, which (as before) is not indented.
+enum { PRINT_NODE, PRINT_THEN, PRINT_ELSE, PRINT_DO };
+
+static void push_print(WalkStack* stack, ASTNode* node, int indent) {
     if (!node) return;
+    walk_push(stack, node, PRINT_NODE)->data[0] = indent;
+}
+
+void print_ast(ASTNode* node, int indent) {
+    WalkStack stack = {0};
+    push_print(&stack, node, indent);
 
-    for (int i = 0; i < indent; ++i) printf("  ");
-
-    switch (node->type) {
-        case NODE_INT:
-            printf("INT: %d\n", node->int_value);
-            break;
-    case NODE_BOOL:
-      printf("BOOL: %s\n", node->int_value ? "true" : "false");
-      break;
-        case NODE_VAR:
-            printf("VAR: %s\n", node->var_name);
-            break;
-        case NODE_BINOP:
-            printf("BINOP: %s\n", node->binop.op);
-            print_ast(node->binop.left, indent + 1);
-            print_ast(node->binop.right, indent + 1);
-            break;
-        case NODE_ASSIGN:
-            printf("ASSIGN: %s\n", node->assign.var_name);
-            print_ast(node->assign.expr, indent + 1);
-            break;
-        case NODE_DECL:
-            printf("DECL: %s\n", node->decl.var_name);
-            if (node->decl.init_value)
-                print_ast(node->decl.init_value, indent + 1);
-            break;
-        case NODE_PRINT:
-            printf("PRINT:\n");
-            print_ast(node->print_expr, indent + 1);
-            break;
-        case NODE_IF:
-            printf("IF:\n");
-            print_ast(node->if_stmt.condition, indent + 1);
+    while (stack.count > 0) {
+        WalkFrame frame = walk_pop(&stack);
+        if (frame.state == PRINT_THEN) {
             printf("THEN:\n");
-            print_ast(node->if_stmt.if_body, indent + 1);
-            if (node->if_stmt.else_body) {
-                printf("ELSE:\n");
-                print_ast(node->if_stmt.else_body, indent + 1);
-            }
-            break;
-        case NODE_STMT_LIST:
-            printf("STMT_LIST:\n");
-            for (int i = 0; i < node->stmt_list.count; i++) {
-                print_ast(node->stmt_list.stmts[i], indent + 1);
-            }
-            break;
+            continue;
+        }
+        if (frame.state == PRINT_ELSE) {
+            printf("ELSE:\n");
+            continue;
+        }
+        if (frame.state == PRINT_DO) {
+            printf("DO:\n");
+            continue;
+        }
+
+        node = frame.node;
+        indent = frame.data[0];
+        for (int i = 0; i < indent; ++i) printf("  ");
+
+        switch (node->type) {
+            case NODE_INT:
+                printf("INT: %d\n", node->int_value);
+                break;
+            case NODE_BOOL:
+                printf("BOOL: %s\n", node->int_value ? "true" : "false");
+                break;
+            case NODE_VAR:
+                printf("VAR: %s\n", intern_name(node->var_id));
+                break;
+            case NODE_BINOP:
+                printf("BINOP: %s\n", binop_symbol(node->binop.op));
+                push_print(&stack, node->binop.right, indent + 1);
+                push_print(&stack, node->binop.left, indent + 1);
+                break;
+            case NODE_ASSIGN:
+                printf("ASSIGN: %s\n", intern_name(node->assign.var_id));
+                push_print(&stack, node->assign.expr, indent + 1);
+                break;
+            case NODE_DECL:
+                printf("DECL: %s\n", intern_name(node->decl.var_id));
+                push_print(&stack, node->decl.init_value, indent + 1);
+                break;
+            case NODE_PRINT:
+                printf("PRINT:\n");
+                push_print(&stack, node->print_expr, indent + 1);
+                break;
+            case NODE_IF:
+                printf("IF:\n");
+                if (node->if_stmt.else_body) {
+                    push_print(&stack, node->if_stmt.else_body, indent + 1);
+                    walk_push(&stack, NULL, PRINT_ELSE);
+                }
+                push_print(&stack, node->if_stmt.if_body, indent + 1);
+                walk_push(&stack, NULL, PRINT_THEN);
+                push_print(&stack, node->if_stmt.condition, indent + 1);
+                break;
+            case NODE_WHILE:
+                printf("WHILE:\n");
+                push_print(&stack, node->while_stmt.body, indent + 1);
+                walk_push(&stack, NULL, PRINT_DO);
+                push_print(&stack, node->while_stmt.condition, indent + 1);
+                break;
+            case NODE_STMT_LIST:
+                printf("STMT_LIST:\n");
+                for (int i = node->stmt_list.count - 1; i >= 0; i--) {
+                    push_print(&stack, node->stmt_list.stmts[i], indent + 1);
+                }
+                break;
+        }
     }
+
+    walk_free(&stack);
 }
@@ -3,6 +3,8 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stddef.h>
+
 typedef enum {
     NODE_INT,
     NODE_BOOL,
@@ -12,41 +14,65 @@ typedef enum {
     NODE_DECL,
     NODE_PRINT,
     NODE_IF,
-    NODE_STMT_LIST
+    NODE_STMT_LIST,
+    NODE_WHILE
 } NodeType;
 
+typedef enum {
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE
+} BinOp;
+
 typedef enum {
   TYPE_INT,
   TYPE_ERROR,
-  TYPE_BOOL
+  TYPE_BOOL,
+  TYPE_UNKNOWN      // not resolved yet
 } Type;
 
 typedef struct ASTNode {
     NodeType type;
+    Type resolved_type;     // cached by semantic analysis, TYPE_UNKNOWN until then
  
+    // `symbol` fields hold the index of the bound entry in the semantic
+    // symbol table, -1 until resolved; it stays valid for the compilation.
     union {
         // NODE_INT
         int int_value;
 
-        // NODE_VAR
-        char* var_name;
+        // NODE_VAR (interned name)
+        struct {
+            int var_id;
+            int var_symbol;
+        };
 
         // NODE_BINOP
         struct {
-            char* op;
+            BinOp op;
+            int line;           // source line of a division, 0 for other operators
             struct ASTNode* left;
             struct ASTNode* right;
         } binop;
 
         // NODE_ASSIGN
         struct {
-            char* var_name;
+            int var_id;
+            int symbol;
             struct ASTNode* expr;
         } assign;
 
         // NODE_DECL
         struct {
-            char* var_name;
+            int var_id;
+            int symbol;
             struct ASTNode* init_value; // can be NULL
 	  Type declared_type;
         } decl;
@@ -61,6 +87,12 @@ typedef struct ASTNode {
             struct ASTNode* else_body; // can be NULL
         } if_stmt;
 
+        // NODE_WHILE
+        struct {
+            struct ASTNode* condition;
+            struct ASTNode* body;
+        } while_stmt;
+
         // NODE_STMT_LIST
         struct {
             struct ASTNode** stmts;
@@ -74,14 +106,27 @@ typedef struct ASTNode {
 // Create functions
 ASTNode* make_int_node(int value);
 ASTNode* make_bool_node(int value);
-ASTNode* make_var_node(char* name);
-ASTNode* make_binop_node(char* op, ASTNode* left, ASTNode* right);
-ASTNode* make_assign_node(char* name, ASTNode* expr);
-ASTNode* make_declaration_node(char* name, ASTNode* init, Type declared_type);
+ASTNode* make_var_node(int var_id);
+ASTNode* make_binop_node(BinOp op, ASTNode* left, ASTNode* right);
+ASTNode* make_assign_node(int var_id, ASTNode* expr);
+ASTNode* make_declaration_node(int var_id, ASTNode* init, Type declared_type);
 ASTNode* make_print_node(ASTNode* expr);
 ASTNode* make_if_node(ASTNode* condition, ASTNode* if_body, ASTNode* else_body);
+ASTNode* make_while_node(ASTNode* condition, ASTNode* body);
 ASTNode* make_stmt_list_node();
 void     add_statement(ASTNode* list, ASTNode* stmt);
 void print_ast(ASTNode* node, int indent);
+const char* binop_symbol(BinOp op);
+
+// Nodes and statement arrays come from one arena per compilation
+typedef struct {
+    size_t nodes;
+    size_t bytes_used;
+    size_t bytes_reserved;
+} AstArenaStats;
+
+void ast_arena_reset();    // frees every node at once, keeps the memory warm
+void ast_arena_destroy();  // returns the arena to the heap
+AstArenaStats ast_arena_stats();
 
 #endif
@@ -0,0 +1,279 @@
+// batch.c
+//
+// Many inputs in one process. Each worker owns a contiguous share of the
+// file list, takes from the front of it and, once it runs dry, steals from
+// the back of another worker's share. Compiler state is thread-local, so a
+// worker simply runs the whole pipeline per file and resets its arenas.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "context.h"
+#include "ast.h"
+#include "semantic.h"
+#include "intern.h"
+#include "codegen.h"
+#include "cache.h"
+#include "trace.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    int head;               // owner takes from here
+    int tail;               // thieves take from here; the share is [head, tail)
+} WorkQueue;
+
+typedef struct {
+    pthread_t thread;
+    int id;
+    int compiled;
+    int failed;
+    int stolen;
+} Worker;
+
+static const BatchOptions* options;
+static char** files;
+static int file_count;
+static int file_capacity;
+static WorkQueue* queues;
+static int queue_count;
+
+static void add_file(const char* path) {
+    if (file_count == file_capacity) {
+        file_capacity = file_capacity ? file_capacity * 2 : 256;
+        files = realloc(files, sizeof(char*) * file_capacity);
+        if (!files) {
+            fprintf(stderr, "Memory allocation failed for batch file list\n");
+            exit(1);
+        }
+    }
+    files[file_count] = strdup(path);
+    if (!files[file_count]) {
+        fprintf(stderr, "Memory allocation failed for batch file list\n");
+        exit(1);
+    }
+    file_count++;
+}
+
+static int has_suffix(const char* s, const char* suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static void collect(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        add_file(path);
+        return;
+    }
+    DIR* dir = opendir(path);
+    if (!dir) {
+        perror(path);
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || has_suffix(entry->d_name, ".tac")) continue;
+        char full[4096];
+        snprintf(full, sizeof(full), "%s/%s", path, entry->d_name);
+        if (stat(full, &st) == 0 && S_ISREG(st.st_mode)) add_file(full);
+    }
+    closedir(dir);
+}
+
+// foo.src -> foo.tac; names without an extension just gain one
+static void output_path(const char* input, char* out, size_t size) {
+    const char* slash = strrchr(input, '/');
+    const char* dot = strrchr(input, '.');
+    size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - input) : strlen(input);
+    snprintf(out, size, "%.*s.tac", (int)stem, input);
+}
+
+static void begin_phase(PipelineObserver* observer, const char* name) {
+    if (observer && observer->phase) observer->phase(name, observer->arg);
+}
+
+int batch_compile_tree(ASTNode* root, TacProgram* tac, const BatchOptions* opts,
+                       PipelineObserver* observer) {
+    PassStats unobserved;
+    PassStats* stats = observer ? &observer->stats : &unobserved;
+
+    // Folding rewrites the tree, which neither the one-pass mode (it has
+    // no checked tree) nor the flat one (it has no tree) goes back to
+    if (opts->flat) {
+        // Batch and server workers pass no observer and get a layout of
+        // their own for this tree
+        FlatAst own;
+        FlatAst* flat = observer && observer->flat ? observer->flat : &own;
+        if (flat == &own) flat_init(&own);
+        begin_phase(observer, "flatten");
+        flat_build(flat, root);
+        begin_phase(observer, "semantic");
+        int failed = semantic_check_flat(flat) != 0;
+        if (!failed) {
+            begin_phase(observer, "codegen");
+            generate_code_flat(flat, tac);
+        }
+        if (flat == &own) flat_free(&own);
+        if (failed) return 1;
+    } else if (opts->one_pass) {
+        begin_phase(observer, "check+gen");
+        if (generate_code_checked(root, tac) != 0) return 1;
+    } else {
+        begin_phase(observer, "semantic");
+        if (semantic_check(root) != 0) return 1;
+        if (opts->optimize) {
+            begin_phase(observer, "fold");
+            fold_constants(root, &stats->fold);
+        }
+        begin_phase(observer, "codegen");
+        generate_code(root, tac);
+    }
+    if (opts->optimize) {
+        begin_phase(observer, "optimize");
+        peephole_optimize(tac, &stats->peephole);
+        if (opts->sccp) sccp_optimize(tac, &stats->sccp);
+        lvn_optimize(tac, &stats->lvn);
+        loop_optimize(tac, &stats->loop);
+        // Strength reduction leaves copies behind
+        peephole_optimize(tac, &stats->peephole_after_loops);
+        cfg_simplify(tac, &stats->cfg);
+        allocate_temps(tac, opts->max_temps, &stats->regalloc);
+    }
+    return 0;
+}
+
+static int compile_file(const char* path, TacProgram* tac) {
+    CompileContext ctx;
+    if (context_load(&ctx, path) != 0) return 1;
+
+    char out[4096];
+    output_path(path, out, sizeof(out));
+    uint64_t key = 0;
+    if (cache_enabled()) {
+        key = cache_key(ctx.buffer, ctx.length, options->cache_flags);
+        if (cache_fetch(key, out)) {
+            context_release(&ctx);
+            return 0;
+        }
+    }
+
+    parse_context(&ctx);
+    context_release(&ctx);
+
+    int failed = ctx.syntax_errors > 0 || !ctx.root;
+    if (!failed) failed = batch_compile_tree(ctx.root, tac, options, NULL);
+    if (!failed) {
+        emit_TAC_to_file(tac, out);
+        if (cache_enabled()) cache_store(key, out);
+    }
+    if (failed) fprintf(stderr, "%s: compilation failed\n", path);
+
+    // Variable names in the TAC point into the intern table, so this comes last
+    ast_arena_reset();
+    intern_reset();
+    return failed;
+}
+
+static int take(WorkQueue* q, int from_tail) {
+    int index = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) index = from_tail ? --q->tail : q->head++;
+    pthread_mutex_unlock(&q->lock);
+    return index;
+}
+
+static void* worker_main(void* arg) {
+    Worker* self = arg;
+    TacProgram tac;
+    tac_init(&tac);
+
+    for (;;) {
+        int index = take(&queues[self->id], 0);
+        for (int v = 1; index < 0 && v < queue_count; v++) {
+            index = take(&queues[(self->id + v) % queue_count], 1);
+            if (index >= 0) self->stolen++;
+        }
+        // Nothing new is ever queued, so empty everywhere means done
+        if (index < 0) break;
+
+        self->failed += compile_file(files[index], &tac);
+        self->compiled++;
+    }
+
+    tac_free(&tac);
+    ast_arena_destroy();
+    intern_destroy();
+    return NULL;
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int batch_compile(char** inputs, int input_count, const BatchOptions* opts) {
+    options = opts;
+    for (int i = 0; i < input_count; i++) collect(inputs[i]);
+    if (file_count == 0) {
+        fprintf(stderr, "No input files\n");
+        return 1;
+    }
+
+    queue_count = opts->threads < 1 ? 1 : opts->threads;
+    if (queue_count > file_count) queue_count = file_count;
+    queues = calloc(queue_count, sizeof(WorkQueue));
+    Worker* workers = calloc(queue_count, sizeof(Worker));
+    if (!queues || !workers) {
+        fprintf(stderr, "Memory allocation failed for batch workers\n");
+        exit(1);
+    }
+    for (int i = 0; i < queue_count; i++) {
+        pthread_mutex_init(&queues[i].lock, NULL);
+        queues[i].head = (int)((long long)file_count * i / queue_count);
+        queues[i].tail = (int)((long long)file_count * (i + 1) / queue_count);
+    }
+
+    // Traces compiled into the front end would serialize the workers on stdout
+    int saved_trace_mask = trace_mask;
+    trace_mask = 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < queue_count; i++) {
+        workers[i].id = i;
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    int failed = 0, stolen = 0;
+    for (int i = 0; i < queue_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+        failed += workers[i].failed;
+        stolen += workers[i].stolen;
+    }
+    double seconds = now_seconds() - start;
+    trace_mask = saved_trace_mask;
+
+    printf("Batch: %d files on %d threads in %.3f s (%.0f files/s), %d stolen, %d failed\n",
+           file_count, queue_count, seconds, seconds > 0 ? file_count / seconds : 0.0,
+           stolen, failed);
+
+    for (int i = 0; i < queue_count; i++) pthread_mutex_destroy(&queues[i].lock);
+    for (int i = 0; i < file_count; i++) free(files[i]);
+    free(files);
+    free(queues);
+    free(workers);
+    files = NULL;
+    file_count = file_capacity = 0;
+    return failed;
+}
@@ -0,0 +1,63 @@
+// batch.h
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "ast.h"
+#include "tac.h"
+#include "flatast.h"
+#include "fold.h"
+#include "peephole.h"
+#include "sccp.h"
+#include "lvn.h"
+#include "loop.h"
+#include "cfg.h"
+#include "regalloc.h"
+
+typedef struct {
+    int threads;            // worker threads
+    int optimize;           // run the same passes as a single compile
+    int max_temps;          // temp pool cap for the allocator, 0 = none
+    const char* cache_flags; // flags part of the cache key, when caching
+    int one_pass;           // check during code generation, see --one-pass
+    int sccp;               // constant propagation on SSA before value numbering
+    int flat;               // check and generate from the flat AST, see --flat
+} BatchOptions;
+
+// What each pass of batch_compile_tree reported
+typedef struct {
+    FoldStats fold;
+    PeepholeStats peephole;
+    SccpStats sccp;
+    LvnStats lvn;
+    LoopStats loop;
+    PeepholeStats peephole_after_loops;
+    CfgStats cfg;
+    RegAllocStats regalloc;
+} PassStats;
+
+// Lets the compiler and bench time and report batch_compile_tree. `phase`
+// (may be NULL) is called as each phase starts: "flatten", "semantic",
+// "fold", "codegen", "check+gen" or "optimize". The caller closes the last
+// one after batch_compile_tree returns.
+typedef struct {
+    void (*phase)(const char* name, void* arg);
+    void* arg;
+    FlatAst* flat;          // where options->flat builds the layout, or NULL
+    PassStats stats;
+} PipelineObserver;
+
+// Compiles every input to a .tac file beside it (foo.src -> foo.tac) on a
+// work-stealing pool. A directory contributes each regular file in it
+// except .tac outputs. Returns the number of inputs that failed.
+int batch_compile(char** inputs, int input_count, const BatchOptions* options);
+
+// Semantic analysis through temp allocation on a parsed tree, with the
+// passes `options` asks for; what every compile runs between parsing and
+// writing its TAC. `observer` may be NULL; with options->flat and no
+// observer->flat, the flat layout is built and freed inside the call.
+// Returns nonzero if the program has errors.
+int batch_compile_tree(ASTNode* root, TacProgram* tac, const BatchOptions* options,
+                       PipelineObserver* observer);
+
+#endif
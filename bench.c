@@ -0,0 +1,349 @@
+// bench.c
+//
+// Times each compiler phase on generated programs of increasing size and
+// prints the results as JSON. Links against the compiler sources with
+// parser.tab.c built using -DNO_COMPILER_MAIN:
+//
+//     bench [--sizes 1K,1M,64M,1G] [--runs N] [--out FILE] [--idents N]
+//           [--expr-depth N] [--if-depth N] [--bool-percent P] [--loop-percent P]
+//           [--seed S] [--flat] [--no-sccp] [--lexer flex|scalar|sse2|avx2|auto]
+//           [--decls 1K,10K,100K,1M]
+//
+// Every phase is reported as the best of the runs; lex scans the input on
+// its own, parse includes the scanning it drives.
+//
+// --flat also builds the flat AST layout (flatast.h) after parsing and
+// times semantic analysis and code generation on it, next to the node
+// memory of both layouts. Folding is skipped then, so the tree's semantic
+// and codegen phases see the same program as the flat ones.
+//
+// --no-sccp leaves constant propagation out of the optimize phase, to
+// compare tac_instructions and tac_branches with and without it.
+//
+// --lexer picks the scanner for lex and parse (scanner.h); the default is
+// the widest hand-written one the CPU runs.
+//
+// --decls replaces --sizes and --idents: each entry declares that many
+// variables up front, followed by DECL_BODY_BYTES of statements per
+// declaration that read and assign them at random. Results then also carry
+// the semantic time per declaration, which stays flat while symbol table
+// lookups are O(1).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "generator.h"
+#include "context.h"
+#include "ast.h"
+#include "semantic.h"
+#include "intern.h"
+#include "codegen.h"
+#include "batch.h"
+#include "cache.h"
+#include "trace.h"
+#include "flatast.h"
+#include "scanner.h"
+
+enum { PHASE_LOAD, PHASE_LEX, PHASE_PARSE, PHASE_SEMANTIC, PHASE_FOLD,
+       PHASE_CODEGEN, PHASE_OPTIMIZE, PHASE_EMIT, PHASE_COUNT };
+
+static const char* phase_names[PHASE_COUNT] = {
+    "load", "lex", "parse", "semantic", "fold", "codegen", "optimize", "emit"
+};
+
+enum { FLAT_BUILD, FLAT_SEMANTIC, FLAT_CODEGEN, FLAT_PHASE_COUNT };
+
+static const char* flat_phase_names[FLAT_PHASE_COUNT] = { "flatten", "semantic", "codegen" };
+
+typedef struct {
+    size_t source_bytes;
+    long tokens;
+    size_t ast_nodes;
+    int tac_instructions;
+    int tac_branches;
+    double best[PHASE_COUNT];
+
+    // --flat
+    size_t tree_bytes;
+    size_t flat_bytes;
+    double flat_best[FLAT_PHASE_COUNT];
+} SizeResult;
+
+// Statement bytes generated per declaration with --decls
+#define DECL_BODY_BYTES 48
+
+static int compare_flat = 0;
+static int use_sccp = 1;
+static FlatAst flat_ast;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t parse_size(const char* s, char** end) {
+    double value = strtod(s, end);
+    switch (**end) {
+        case 'k': case 'K': value *= 1024; (*end)++; break;
+        case 'm': case 'M': value *= 1024 * 1024; (*end)++; break;
+        case 'g': case 'G': value *= 1024.0 * 1024 * 1024; (*end)++; break;
+    }
+    return (size_t)value;
+}
+
+static void keep_best(double* best, double seconds) {
+    if (*best < 0 || seconds < *best) *best = seconds;
+}
+
+static void record(SizeResult* r, int phase, double seconds) {
+    keep_best(&r->best[phase], seconds);
+}
+
+// Times batch_compile_tree's phases into a SizeResult as they start
+typedef struct {
+    SizeResult* r;
+    double* running;        // best time of the phase running, NULL before the first
+    double start;
+} PhaseClock;
+
+// With --flat the pipeline's semantic and codegen run on the flat layout
+static double* phase_best(SizeResult* r, const char* name) {
+    if (compare_flat) {
+        if (strcmp(name, "flatten") == 0) return &r->flat_best[FLAT_BUILD];
+        if (strcmp(name, "semantic") == 0) return &r->flat_best[FLAT_SEMANTIC];
+        if (strcmp(name, "codegen") == 0) return &r->flat_best[FLAT_CODEGEN];
+    }
+    if (strcmp(name, "semantic") == 0) return &r->best[PHASE_SEMANTIC];
+    if (strcmp(name, "fold") == 0) return &r->best[PHASE_FOLD];
+    if (strcmp(name, "codegen") == 0) return &r->best[PHASE_CODEGEN];
+    return &r->best[PHASE_OPTIMIZE];
+}
+
+static void stop_clock(PhaseClock* clock) {
+    if (clock->running) keep_best(clock->running, now_seconds() - clock->start);
+    clock->running = NULL;
+}
+
+static void clock_phase(const char* name, void* arg) {
+    PhaseClock* clock = arg;
+    stop_clock(clock);
+    clock->running = phase_best(clock->r, name);
+    clock->start = now_seconds();
+}
+
+// One pass of the whole pipeline over `path`; returns 0 on success
+static int run_once(const char* path, const char* tac_path, SizeResult* r, TacProgram* tac) {
+    double t0 = now_seconds();
+    CompileContext ctx;
+    if (context_load(&ctx, path) != 0) return 1;
+    double t1 = now_seconds();
+    record(r, PHASE_LOAD, t1 - t0);
+
+    r->tokens = scan_context(&ctx);
+    intern_reset();
+    double t2 = now_seconds();
+    record(r, PHASE_LEX, t2 - t1);
+
+    parse_context(&ctx);
+    double t3 = now_seconds();
+    record(r, PHASE_PARSE, t3 - t2);
+    r->source_bytes = ctx.length;
+    context_release(&ctx);
+    if (ctx.syntax_errors > 0 || !ctx.root) return 1;
+    r->ast_nodes = ast_arena_stats().nodes;
+
+    // The tree's walks, for comparison; the pipeline then runs on the flat
+    // layout, which sees the same program because nothing is folded
+    if (compare_flat) {
+        t3 = now_seconds();
+        if (semantic_check(ctx.root) != 0) return 1;
+        double t4 = now_seconds();
+        generate_code(ctx.root, tac);
+        double t5 = now_seconds();
+        record(r, PHASE_SEMANTIC, t4 - t3);
+        record(r, PHASE_FOLD, 0);
+        record(r, PHASE_CODEGEN, t5 - t4);
+    }
+
+    BatchOptions options = { 1, 1, 0, NULL, 0, use_sccp, compare_flat };
+    PhaseClock clock = { r, NULL, 0 };
+    PipelineObserver observer = { .phase = clock_phase, .arg = &clock, .flat = &flat_ast };
+    if (batch_compile_tree(ctx.root, tac, &options, &observer) != 0) return 1;
+    stop_clock(&clock);
+    if (compare_flat) {
+        r->tree_bytes = ast_arena_stats().bytes_used;
+        r->flat_bytes = flat_bytes(&flat_ast);
+    }
+
+    double t7 = now_seconds();
+    emit_TAC_to_file(tac, tac_path);
+    double t8 = now_seconds();
+    record(r, PHASE_EMIT, t8 - t7);
+    r->tac_instructions = tac->count;
+    r->tac_branches = 0;
+    for (int i = 0; i < tac->count; i++) r->tac_branches += tac_is_cond_jump((TacOp)tac->code[i].op);
+
+    ast_arena_reset();
+    intern_reset();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    GeneratorOptions gen;
+    generator_defaults(&gen);
+    const char* sizes = "1K,64K,1M,16M";
+    const char* out_path = NULL;
+    const char* decls = NULL;
+    int runs = 3;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizes = argv[++i];
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--idents") == 0 && i + 1 < argc) {
+            gen.identifiers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--expr-depth") == 0 && i + 1 < argc) {
+            gen.expr_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--if-depth") == 0 && i + 1 < argc) {
+            gen.if_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bool-percent") == 0 && i + 1 < argc) {
+            gen.bool_percent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loop-percent") == 0 && i + 1 < argc) {
+            gen.loop_percent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            gen.seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--flat") == 0) {
+            compare_flat = 1;
+        } else if (strcmp(argv[i], "--no-sccp") == 0) {
+            use_sccp = 0;
+        } else if (strcmp(argv[i], "--decls") == 0 && i + 1 < argc) {
+            decls = argv[++i];
+        } else if (strcmp(argv[i], "--lexer") == 0 && i + 1 < argc) {
+            ScannerKind kind;
+            if (scanner_parse_kind(argv[++i], &kind) != 0) {
+                fprintf(stderr, "Unknown or unsupported scanner '%s'\n", argv[i]);
+                return 1;
+            }
+            scanner_use(kind);
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (runs < 1) runs = 1;
+
+    FILE* out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror("fopen");
+        return 1;
+    }
+    trace_mask = 0;
+
+    char source_path[] = "/tmp/bench_XXXXXX";
+    int fd = mkstemp(source_path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    char tac_path[64];
+    snprintf(tac_path, sizeof(tac_path), "%s.tac", source_path);
+
+    fprintf(out, "{\n  \"compiler_version\": \"%s\",\n", COMPILER_VERSION);
+    fprintf(out, "  \"runs\": %d,\n", runs);
+    fprintf(out, "  \"lexer\": \"%s\",\n", scanner_kind_name(scanner_in_use()));
+    fprintf(out, "  \"generator\": {\"identifiers\": %d, \"expr_depth\": %d, \"if_depth\": %d, "
+                 "\"bool_percent\": %d, \"loop_percent\": %d, \"seed\": %u},\n",
+            gen.identifiers, gen.expr_depth, gen.if_depth, gen.bool_percent, gen.loop_percent,
+            gen.seed);
+    fprintf(out, "  \"results\": [");
+
+    TacProgram tac;
+    tac_init(&tac);
+    flat_init(&flat_ast);
+    int first = 1;
+    const char* p = decls ? decls : sizes;
+    while (*p) {
+        char* end;
+        size_t target = parse_size(p, &end);
+        p = *end == ',' ? end + 1 : end;
+        if (target == 0) {
+            if (end == p) break;
+            continue;
+        }
+        if (decls) {
+            // Declarations alone take about 14 bytes each
+            gen.identifiers = (int)target;
+            gen.size = target * (14 + DECL_BODY_BYTES);
+        } else {
+            gen.size = target;
+        }
+
+        FILE* source = fopen(source_path, "w");
+        if (!source) {
+            perror("fopen");
+            return 1;
+        }
+        generate_program(source, &gen);
+        fclose(source);
+
+        SizeResult r;
+        memset(&r, 0, sizeof(r));
+        for (int i = 0; i < PHASE_COUNT; i++) r.best[i] = -1;
+        for (int i = 0; i < FLAT_PHASE_COUNT; i++) r.flat_best[i] = -1;
+        for (int run = 0; run < runs; run++) {
+            if (run_once(source_path, tac_path, &r, &tac) != 0) {
+                fprintf(stderr, "Generated program failed to compile (size %zu)\n", gen.size);
+                return 1;
+            }
+        }
+
+        double total = 0;
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            if (i != PHASE_LEX) total += r.best[i];     // parse already scans
+        }
+        fprintf(out, "%s\n    {\"target_bytes\": %zu, \"source_bytes\": %zu, \"identifiers\": %d, "
+                     "\"tokens\": %ld, \"ast_nodes\": %zu, \"tac_instructions\": %d, "
+                     "\"tac_branches\": %d,\n     \"seconds\": {",
+                first ? "" : ",", gen.size, r.source_bytes, gen.identifiers, r.tokens, r.ast_nodes,
+                r.tac_instructions, r.tac_branches);
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            fprintf(out, "%s\"%s\": %.6f", i ? ", " : "", phase_names[i], r.best[i]);
+        }
+        fprintf(out, "},\n     \"total_seconds\": %.6f, \"mb_per_second\": %.2f",
+                total, total > 0 ? r.source_bytes / total / (1024 * 1024) : 0.0);
+        if (decls) {
+            fprintf(out, ", \"semantic_ns_per_decl\": %.1f",
+                    r.best[PHASE_SEMANTIC] * 1e9 / gen.identifiers);
+        }
+        if (compare_flat) {
+            fprintf(out, ",\n     \"flat\": {\"tree_bytes\": %zu, \"flat_bytes\": %zu, \"seconds\": {",
+                    r.tree_bytes, r.flat_bytes);
+            for (int i = 0; i < FLAT_PHASE_COUNT; i++) {
+                fprintf(out, "%s\"%s\": %.6f", i ? ", " : "", flat_phase_names[i], r.flat_best[i]);
+            }
+            fprintf(out, "}}");
+        }
+        fprintf(out, "}");
+        fflush(out);
+        first = 0;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(out, "\n  ],\n  \"peak_rss_kb\": %ld\n}\n", usage.ru_maxrss);
+
+    unlink(source_path);
+    unlink(tac_path);
+    tac_free(&tac);
+    flat_free(&flat_ast);
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,253 @@
+// cache.c
+//
+// Content-addressed store of finished TAC: <dir>/<key>.tac, where the key
+// hashes the source bytes, COMPILER_VERSION and the flags that change the
+// output. Entries are written to a private temp file and renamed into
+// place, so concurrent compilers sharing a directory never see a partial
+// entry. A hit refreshes the entry's mtime, which is what eviction orders by.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <stdatomic.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+#define STATS_FILE "stats"
+
+static char cache_dir[4096];
+static size_t cache_max_bytes;
+static int cache_on = 0;
+
+static atomic_llong hits, misses, stores, evictions;
+static atomic_uint temp_serial;
+
+void cache_open(const char* dir, size_t max_bytes) {
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        perror(dir);
+        return;
+    }
+    snprintf(cache_dir, sizeof(cache_dir), "%s", dir);
+    cache_max_bytes = max_bytes;
+    cache_on = 1;
+}
+
+int cache_enabled() {
+    return cache_on;
+}
+
+// ---------------------------------------------------------------------------
+// Hashing: 8 bytes per step, multiply-xorshift mixing, murmur3 finalizer
+
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t length) {
+    const unsigned char* p = data;
+    const uint64_t m = 0x9e3779b97f4a7c15ULL;
+    while (length >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        h = (h ^ mix(v)) * m;
+        h ^= h >> 29;
+        p += 8;
+        length -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, length);
+    h = (h ^ mix(tail ^ length)) * m;
+    return mix(h);
+}
+
+uint64_t cache_key(const char* source, size_t length, const char* flags) {
+    uint64_t h = hash_bytes(0x243f6a8885a308d3ULL, COMPILER_VERSION, sizeof(COMPILER_VERSION) - 1);
+    h = hash_bytes(h, flags, strlen(flags));
+    return hash_bytes(h ^ length, source, length);
+}
+
+// ---------------------------------------------------------------------------
+// Entries
+
+static void entry_path(uint64_t key, char* out, size_t size) {
+    snprintf(out, size, "%s/%016llx.tac", cache_dir, (unsigned long long)key);
+}
+
+// Copies `from` to `to` through a temp file in the destination directory
+// and renames it into place
+static int copy_atomically(const char* from, const char* to, const char* temp_dir) {
+    FILE* in = fopen(from, "rb");
+    if (!in) return -1;
+
+    char temp[4200];
+    snprintf(temp, sizeof(temp), "%s/.tmp.%d.%u", temp_dir, (int)getpid(),
+             atomic_fetch_add(&temp_serial, 1));
+    FILE* out = fopen(temp, "wb");
+    if (!out) {
+        fclose(in);
+        return -1;
+    }
+    char buffer[65536];
+    size_t n;
+    int ok = 1;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (fwrite(buffer, 1, n, out) != n) {
+            ok = 0;
+            break;
+        }
+    }
+    fclose(in);
+    if (fclose(out) != 0) ok = 0;
+    if (!ok || rename(temp, to) != 0) {
+        unlink(temp);
+        return -1;
+    }
+    return 0;
+}
+
+static void directory_of(const char* path, char* out, size_t size) {
+    const char* slash = strrchr(path, '/');
+    if (slash) snprintf(out, size, "%.*s", (int)(slash - path), path);
+    else snprintf(out, size, ".");
+}
+
+int cache_fetch(uint64_t key, const char* out_path) {
+    char path[sizeof(cache_dir) + 300], out_dir[4096];
+    entry_path(key, path, sizeof(path));
+    directory_of(out_path, out_dir, sizeof(out_dir));
+    if (copy_atomically(path, out_path, out_dir) != 0) {
+        atomic_fetch_add(&misses, 1);
+        return 0;
+    }
+    utimensat(AT_FDCWD, path, NULL, 0);    // mark as recently used
+    atomic_fetch_add(&hits, 1);
+    return 1;
+}
+
+void cache_store(uint64_t key, const char* tac_path) {
+    char path[sizeof(cache_dir) + 300];
+    entry_path(key, path, sizeof(path));
+    if (copy_atomically(tac_path, path, cache_dir) == 0) atomic_fetch_add(&stores, 1);
+}
+
+// ---------------------------------------------------------------------------
+// Eviction and counters
+
+typedef struct {
+    char name[32];
+    time_t mtime;
+    off_t size;
+} Entry;
+
+static int older_first(const void* a, const void* b) {
+    const Entry* x = a;
+    const Entry* y = b;
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+static void evict() {
+    DIR* dir = opendir(cache_dir);
+    if (!dir) return;
+
+    Entry* entries = NULL;
+    int count = 0, capacity = 0;
+    size_t total = 0;
+    struct dirent* d;
+    while ((d = readdir(dir)) != NULL) {
+        size_t len = strlen(d->d_name);
+        if (len != 20 || strcmp(d->d_name + 16, ".tac") != 0) continue;
+        char path[sizeof(cache_dir) + 300];
+        snprintf(path, sizeof(path), "%s/%s", cache_dir, d->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            Entry* grown = realloc(entries, sizeof(Entry) * capacity);
+            if (!grown) break;
+            entries = grown;
+        }
+        memcpy(entries[count].name, d->d_name, len + 1);
+        entries[count].mtime = st.st_mtime;
+        entries[count].size = st.st_size;
+        total += st.st_size;
+        count++;
+    }
+    closedir(dir);
+
+    if (total > cache_max_bytes) {
+        qsort(entries, count, sizeof(Entry), older_first);
+        for (int i = 0; i < count && total > cache_max_bytes; i++) {
+            char path[sizeof(cache_dir) + 300];
+            snprintf(path, sizeof(path), "%s/%s", cache_dir, entries[i].name);
+            // Another process may have evicted it already
+            if (unlink(path) == 0) atomic_fetch_add(&evictions, 1);
+            total -= entries[i].size;
+        }
+    }
+    free(entries);
+}
+
+static void read_counters(FILE* f, CacheStats* totals) {
+    memset(totals, 0, sizeof(*totals));
+    if (fscanf(f, "hits %lld misses %lld stores %lld evictions %lld",
+               &totals->hits, &totals->misses, &totals->stores, &totals->evictions) != 4) {
+        memset(totals, 0, sizeof(*totals));
+    }
+}
+
+void cache_close(CacheStats* stats) {
+    if (!cache_on) return;
+    evict();
+
+    CacheStats mine = { atomic_load(&hits), atomic_load(&misses),
+                        atomic_load(&stores), atomic_load(&evictions) };
+    if (stats) *stats = mine;
+
+    // Fold this process's counts into the shared totals under a lock
+    char path[sizeof(cache_dir) + 300];
+    snprintf(path, sizeof(path), "%s/" STATS_FILE, cache_dir);
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd >= 0 && flock(fd, LOCK_EX) == 0) {
+        FILE* f = fdopen(fd, "r+");
+        if (f) {
+            CacheStats totals;
+            read_counters(f, &totals);
+            totals.hits += mine.hits;
+            totals.misses += mine.misses;
+            totals.stores += mine.stores;
+            totals.evictions += mine.evictions;
+            rewind(f);
+            fprintf(f, "hits %lld misses %lld stores %lld evictions %lld\n",
+                    totals.hits, totals.misses, totals.stores, totals.evictions);
+            fflush(f);
+            fclose(f);      // also drops the lock
+            fd = -1;
+        }
+    }
+    if (fd >= 0) close(fd);
+    cache_on = 0;
+}
+
+int cache_read_totals(const char* dir, CacheStats* totals) {
+    char path[sizeof(cache_dir) + 300];
+    snprintf(path, sizeof(path), "%s/" STATS_FILE, dir);
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        memset(totals, 0, sizeof(*totals));
+        return -1;
+    }
+    flock(fileno(f), LOCK_SH);
+    read_counters(f, totals);
+    fclose(f);
+    return 0;
+}
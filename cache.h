@@ -0,0 +1,41 @@
+// cache.h
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Part of every key; bump it whenever a change alters the generated TAC so
+// entries written by older compilers stop matching
+#define COMPILER_VERSION "3"
+
+typedef struct {
+    long long hits;
+    long long misses;
+    long long stores;
+    long long evictions;
+} CacheStats;
+
+// Enables the cache in `dir` (created if missing), bounded to `max_bytes`
+void cache_open(const char* dir, size_t max_bytes);
+int  cache_enabled();
+
+// Key for a source buffer compiled with the given flags
+uint64_t cache_key(const char* source, size_t length, const char* flags);
+
+// On a hit copies the cached TAC to `out_path` and returns 1; returns 0 on
+// a miss. Both are counted.
+int  cache_fetch(uint64_t key, const char* out_path);
+
+// Copies a freshly written TAC file into the cache under `key`
+void cache_store(uint64_t key, const char* tac_path);
+
+// Evicts least recently used entries down to the size bound and adds this
+// process's counters to the totals kept in the cache directory
+void cache_close(CacheStats* stats);
+
+// Totals across every process that has used `dir`
+int  cache_read_totals(const char* dir, CacheStats* totals);
+
+#endif
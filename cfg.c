@@ -0,0 +1,264 @@
+// cfg.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+
+static void* checked_malloc(size_t size) {
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed for control-flow graph\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static void add_block(BlockList* out, int start, int end) {
+    BasicBlock* b = &out->blocks[out->count++];
+    b->start = start;
+    b->end = end;
+    b->succ_count = 0;
+}
+
+void split_blocks(const TacProgram* prog, BlockList* out) {
+    out->blocks = checked_malloc(sizeof(BasicBlock) * (prog->count + 1));
+    out->count = 0;
+    out->label_block = NULL;
+
+    int start = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (prog->code[i].op == TAC_LABEL && i > start) {
+            add_block(out, start, i);
+            start = i;
+        }
+        if (tac_is_jump((TacOp)prog->code[i].op)) {
+            add_block(out, start, i + 1);
+            start = i + 1;
+        }
+    }
+    if (start < prog->count) {
+        add_block(out, start, prog->count);
+    }
+}
+
+void build_cfg(const TacProgram* prog, BlockList* out) {
+    split_blocks(prog, out);
+
+    out->label_block = checked_malloc(sizeof(int) * (prog->label_count + 1));
+    for (int l = 0; l < prog->label_count; l++) out->label_block[l] = -1;
+    for (int b = 0; b < out->count; b++) {
+        for (int i = out->blocks[b].start; i < out->blocks[b].end; i++) {
+            if (prog->code[i].op != TAC_LABEL) break;
+            out->label_block[prog->code[i].dst] = b;
+        }
+    }
+
+    for (int b = 0; b < out->count; b++) {
+        BasicBlock* block = &out->blocks[b];
+        const TACInstruction* last = &prog->code[block->end - 1];
+        if (last->op != TAC_GOTO && b + 1 < out->count) {
+            block->succ[block->succ_count++] = b + 1;
+        }
+        if (tac_is_jump((TacOp)last->op)) {
+            int target = out->label_block[last->dst];
+            if (target >= 0 && (block->succ_count == 0 || block->succ[0] != target)) {
+                block->succ[block->succ_count++] = target;
+            }
+        }
+    }
+}
+
+void free_blocks(BlockList* blocks) {
+    free(blocks->blocks);
+    free(blocks->label_block);
+    blocks->blocks = NULL;
+    blocks->label_block = NULL;
+    blocks->count = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Simplification
+
+static _Thread_local int* label_pos;      // label -> instruction index of the label
+static _Thread_local char* dead;          // instructions to drop at the next compaction
+
+static void index_labels(const TacProgram* prog) {
+    for (int l = 0; l < prog->label_count; l++) label_pos[l] = -1;
+    for (int i = 0; i < prog->count; i++) {
+        if (prog->code[i].op == TAC_LABEL) label_pos[prog->code[i].dst] = i;
+    }
+}
+
+// First instruction at or after `i` that is not a label
+static int skip_labels(const TacProgram* prog, int i) {
+    while (i < prog->count && prog->code[i].op == TAC_LABEL) i++;
+    return i;
+}
+
+// Does `label` mark the position that execution falls into after `i`?
+static int falls_into(const TacProgram* prog, int i, int label) {
+    int pos = label_pos[label];
+    return pos > i && skip_labels(prog, i + 1) >= pos;
+}
+
+static int compact(TacProgram* prog) {
+    int out = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (!dead[i]) prog->code[out++] = prog->code[i];
+    }
+    int removed = prog->count - out;
+    prog->count = out;
+    memset(dead, 0, prog->count);
+    return removed;
+}
+
+static int thread_jumps(TacProgram* prog, CfgStats* stats) {
+    int changed = 0;
+    for (int i = 0; i < prog->count; i++) {
+        TACInstruction* ins = &prog->code[i];
+        if (!tac_is_jump((TacOp)ins->op)) continue;
+
+        int target = ins->dst;
+        for (int hops = 0; hops < 32; hops++) {
+            int pos = label_pos[target];
+            if (pos < 0) break;
+            int next = skip_labels(prog, pos);
+            if (next >= prog->count || prog->code[next].op != TAC_GOTO) break;
+            if (prog->code[next].dst == target || next == i) break;
+            target = prog->code[next].dst;
+        }
+        if (target != ins->dst) {
+            ins->dst = target;
+            stats->jumps_threaded++;
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+static int layout_fall_through(TacProgram* prog, CfgStats* stats) {
+    int changed = 0;
+    for (int i = 0; i < prog->count; i++) {
+        TACInstruction* ins = &prog->code[i];
+        if (!tac_is_jump((TacOp)ins->op) || dead[i]) continue;
+
+        // A jump to where we would go anyway
+        if (falls_into(prog, i, ins->dst)) {
+            dead[i] = 1;
+            stats->jumps_removed++;
+            changed = 1;
+            continue;
+        }
+
+        // if c goto L1; goto L2; L1:  ->  if !c goto L2; L1:
+        if (tac_is_cond_jump((TacOp)ins->op) && i + 1 < prog->count &&
+            prog->code[i + 1].op == TAC_GOTO && falls_into(prog, i + 1, ins->dst)) {
+            if (ins->op == TAC_IFGOTO) {
+                ins->op = TAC_IF_EQ;
+                ins->b_kind = OPND_IMM;
+                ins->b = 0;
+            } else {
+                ins->op = tac_negate_compare((TacOp)ins->op);
+            }
+            ins->dst = prog->code[i + 1].dst;
+            dead[i + 1] = 1;
+            stats->branches_inverted++;
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+static int remove_unreachable(TacProgram* prog, CfgStats* stats) {
+    if (prog->count == 0) return 0;
+
+    BlockList cfg;
+    build_cfg(prog, &cfg);
+
+    char* reached = calloc(cfg.count, 1);
+    int* worklist = checked_malloc(sizeof(int) * cfg.count);
+    if (!reached) {
+        fprintf(stderr, "Memory allocation failed for control-flow graph\n");
+        exit(1);
+    }
+    int top = 0;
+    worklist[top++] = 0;
+    reached[0] = 1;
+    while (top > 0) {
+        BasicBlock* b = &cfg.blocks[worklist[--top]];
+        for (int s = 0; s < b->succ_count; s++) {
+            if (!reached[b->succ[s]]) {
+                reached[b->succ[s]] = 1;
+                worklist[top++] = b->succ[s];
+            }
+        }
+    }
+
+    int changed = 0;
+    for (int b = 0; b < cfg.count; b++) {
+        if (reached[b]) continue;
+        for (int i = cfg.blocks[b].start; i < cfg.blocks[b].end; i++) dead[i] = 1;
+        stats->blocks_removed++;
+        changed = 1;
+    }
+    free(reached);
+    free(worklist);
+    free_blocks(&cfg);
+    return changed;
+}
+
+static int remove_unused_labels(TacProgram* prog, CfgStats* stats) {
+    char* used = calloc(prog->label_count + 1, 1);
+    if (!used) {
+        fprintf(stderr, "Memory allocation failed for control-flow graph\n");
+        exit(1);
+    }
+    for (int i = 0; i < prog->count; i++) {
+        if (tac_is_jump((TacOp)prog->code[i].op)) used[prog->code[i].dst] = 1;
+    }
+    int changed = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (prog->code[i].op == TAC_LABEL && !used[prog->code[i].dst]) {
+            dead[i] = 1;
+            stats->labels_removed++;
+            changed = 1;
+        }
+    }
+    free(used);
+    return changed;
+}
+
+void cfg_simplify(TacProgram* prog, CfgStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->before = prog->count;
+
+    label_pos = checked_malloc(sizeof(int) * (prog->label_count + 1));
+    dead = calloc(prog->count + 1, 1);
+    if (!dead) {
+        fprintf(stderr, "Memory allocation failed for control-flow graph\n");
+        exit(1);
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+
+        index_labels(prog);
+        changed |= thread_jumps(prog, stats);
+        changed |= layout_fall_through(prog, stats);
+        compact(prog);
+
+        changed |= remove_unreachable(prog, stats);
+        compact(prog);
+
+        changed |= remove_unused_labels(prog, stats);
+        compact(prog);
+    }
+
+    stats->after = prog->count;
+    free(label_pos);
+    free(dead);
+    label_pos = NULL;
+    dead = NULL;
+}
@@ -0,0 +1,41 @@
+// cfg.h
+
+#ifndef CFG_H
+#define CFG_H
+
+#include "tac.h"
+
+// Instructions [start, end) of prog->code. A block starts at the first
+// instruction, at every label and after every jump.
+typedef struct {
+    int start;
+    int end;
+    int succ[2];        // successor block indices, fall-through first
+    int succ_count;
+} BasicBlock;
+
+typedef struct {
+    BasicBlock* blocks;
+    int count;
+    int* label_block;   // label number -> block that it starts, -1 if none
+} BlockList;
+
+void split_blocks(const TacProgram* prog, BlockList* out);
+void build_cfg(const TacProgram* prog, BlockList* out);   // split_blocks + edges
+void free_blocks(BlockList* blocks);
+
+typedef struct {
+    int before;
+    int after;
+    int jumps_threaded;     // jumps retargeted past a goto
+    int jumps_removed;      // jumps to the next instruction
+    int branches_inverted;  // "if c goto L1; goto L2; L1:" -> "if !c goto L2"
+    int blocks_removed;     // unreachable blocks
+    int labels_removed;     // labels nothing jumps to
+} CfgStats;
+
+// Jump threading, fall-through layout, unreachable block removal and
+// unused label deletion, repeated until nothing changes.
+void cfg_simplify(TacProgram* prog, CfgStats* stats);
+
+#endif
@@ -3,195 +3,491 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ast.h"
+#include "codegen.h"
+#include "intern.h"
+#include "semantic.h"
+#include "walk.h"
 
-#define MAX_TAC 1000
+static _Thread_local TacProgram* prog = NULL;
 
-typedef struct {
-    char op[8];
-    char arg1[32];
-    char arg2[32];
-    char result[32];
-} TACInstruction;
+// Set by generate_code_checked: semantic analysis rides along with the
+// walk, typing each operand as it is emitted. `strict` is clear while
+// generating print values and conditions, whose operator types are not
+// checked.
+static _Thread_local int checking = 0;
+static _Thread_local int strict = 1;
 
-TACInstruction tac[MAX_TAC];
-int tac_index = 0;
-int temp_index = 0;
+// Interned name ID -> index in prog->var_names, -1 until first use
+static _Thread_local int* var_index = NULL;
+static _Thread_local int var_index_size = 0;
 
-char* new_temp() {
-    static char temp[32];
-    snprintf(temp, sizeof(temp), "t%d", temp_index++);
-    return strdup(temp);
+static TacOperand var_operand(int var_id) {
+    if (var_id >= var_index_size) {
+        int size = var_index_size ? var_index_size : 64;
+        while (size <= var_id) size *= 2;
+        var_index = realloc(var_index, sizeof(int) * size);
+        if (!var_index) {
+            fprintf(stderr, "Memory allocation failed for variable map\n");
+            exit(1);
+        }
+        for (int i = var_index_size; i < size; i++) var_index[i] = -1;
+        var_index_size = size;
+    }
+    if (var_index[var_id] < 0) {
+        var_index[var_id] = tac_add_var(prog, intern_name(var_id));
+    }
+    return tac_var(var_index[var_id]);
 }
 
-char* generate_expr(ASTNode* node);
-
-void generate_stmt(ASTNode* node) {
-    if (!node) return;
+// Both walks run on explicit stacks so that deeply nested programs cost
+// heap memory rather than C stack; the stacks are kept between calls.
+static _Thread_local WalkStack stmt_stack;
+static _Thread_local WalkStack expr_stack;
 
+// Operand of anything but a BINOP
+static TacOperand leaf_operand(ASTNode* node) {
+    if (!node) return tac_none();
     switch (node->type) {
-        case NODE_STMT_LIST:
-            for (int i = 0; i < node->stmt_list.count; i++) {
-                generate_stmt(node->stmt_list.stmts[i]);
+        case NODE_INT:
+        case NODE_BOOL:
+            return tac_imm(node->int_value);
+        case NODE_VAR:
+            return var_operand(node->var_id);
+        default:
+            return tac_none();
+    }
+}
+
+static int is_binop(ASTNode* node) {
+    return node && node->type == NODE_BINOP;
+}
+
+// A BINOP on the stack is either waiting for its left subtree, or holds
+// its left operand in data[] while its right subtree is generated.
+enum { EXPR_WANT_LEFT, EXPR_WANT_RIGHT };
+
+// Post-order with the usual left-spine descent: every BINOP whose left
+// operand is a BINOP is pushed once on the way down, and one with a
+// BINOP on the right once more. Leaves are evaluated where a recursive
+// walk would evaluate them, so variables and temps are numbered the same.
+static TacOperand generate_binop(ASTNode* node) {
+    WalkStack* stack = &expr_stack;
+    ASTNode* next = node;
+    TacOperand result = tac_none();
+
+    for (;;) {
+        TacOperand left, right;
+        int have_right = 0;
+
+        if (next) {
+            node = next;
+            while (is_binop(node->binop.left)) {
+                walk_push(stack, node, EXPR_WANT_LEFT);
+                node = node->binop.left;
             }
-            break;
+            if (checking) semantic_operand_type(node->binop.left);
+            left = leaf_operand(node->binop.left);
+        } else if (stack->count > 0) {
+            WalkFrame frame = walk_pop(stack);
+            node = frame.node;
+            if (frame.state == EXPR_WANT_RIGHT) {
+                left.kind = (uint8_t)frame.data[0];
+                left.value = frame.data[1];
+                right = result;
+                have_right = 1;
+            } else {
+                left = result;
+            }
+        } else {
+            return result;
+        }
+
+        if (!have_right) {
+            if (is_binop(node->binop.right)) {
+                WalkFrame* frame = walk_push(stack, node, EXPR_WANT_RIGHT);
+                frame->data[0] = left.kind;
+                frame->data[1] = left.value;
+                next = node->binop.right;
+                continue;
+            }
+            if (checking) semantic_operand_type(node->binop.right);
+            right = leaf_operand(node->binop.right);
+        }
+
+        if (checking) semantic_binop_type(node, strict);
+        result = tac_new_temp(prog);
+        tac_emit(prog, (TacOp)(TAC_ADD + node->binop.op), result, left, right);
+        next = NULL;
+    }
+}
 
+static TacOperand generate_expr(ASTNode* node) {
+    if (is_binop(node)) return generate_binop(node);
+    if (checking) semantic_operand_type(node);
+    return leaf_operand(node);
+}
+
+static void generate_simple_stmt(ASTNode* node) {
+    switch (node->type) {
         case NODE_DECL:
+            if (checking) semantic_declare(node);
             if (node->decl.init_value) {
-                char* val = generate_expr(node->decl.init_value);
-                snprintf(tac[tac_index].op, 8, "=");
-                strcpy(tac[tac_index].arg1, val);
-                tac[tac_index].arg2[0] = '\0';
-                strcpy(tac[tac_index].result, node->decl.var_name);
-                tac_index++;
+                TacOperand val = generate_expr(node->decl.init_value);
+                if (checking) semantic_check_init(node);
+                tac_emit(prog, TAC_COPY, var_operand(node->decl.var_id), val, tac_none());
+            } else {
+                // Variables are numbered by name, so a block-scoped `int x;`
+                // shares its slot with an `x` from a sibling block or an
+                // earlier loop iteration; it must not see that value.
+                tac_emit(prog, TAC_COPY, var_operand(node->decl.var_id), tac_imm(0), tac_none());
             }
             break;
 
         case NODE_ASSIGN: {
-            char* val = generate_expr(node->assign.expr);
-            snprintf(tac[tac_index].op, 8, "=");
-            strcpy(tac[tac_index].arg1, val);
-            tac[tac_index].arg2[0] = '\0';
-            strcpy(tac[tac_index].result, node->assign.var_name);
-            tac_index++;
+            if (checking) semantic_check_assign(node);
+            TacOperand val = generate_expr(node->assign.expr);
+            tac_emit(prog, TAC_COPY, var_operand(node->assign.var_id), val, tac_none());
             break;
         }
 
         case NODE_PRINT: {
-            char* val = generate_expr(node->print_expr);
-            snprintf(tac[tac_index].op, 8, "print");
-            strcpy(tac[tac_index].arg1, val);
-            tac[tac_index].arg2[0] = '\0';
-            tac[tac_index].result[0] = '\0';
-            tac_index++;
+            strict = 0;
+            TacOperand val = generate_expr(node->print_expr);
+            strict = 1;
+            tac_emit(prog, TAC_PRINT, tac_none(), val, tac_none());
             break;
         }
 
-        case NODE_IF: {
-            char* cond = generate_expr(node->if_stmt.condition);
-            char label_if[16], label_else[16], label_end[16];
-            static int label_index = 0;
-            snprintf(label_if, sizeof(label_if), "L%d", label_index++);
-            snprintf(label_else, sizeof(label_else), "L%d", label_index++);
-            snprintf(label_end, sizeof(label_end), "L%d", label_index++);
-
-            // if cond goto label_if
-            snprintf(tac[tac_index].op, 8, "ifgoto");
-            strcpy(tac[tac_index].arg1, cond);
-            strcpy(tac[tac_index].arg2, label_if);
-            tac[tac_index].result[0] = '\0';
-            tac_index++;
-
-            // goto label_else
-            snprintf(tac[tac_index].op, 8, "goto");
-            strcpy(tac[tac_index].arg1, label_else);
-            tac[tac_index].arg2[0] = '\0';
-            tac[tac_index].result[0] = '\0';
-            tac_index++;
-
-            // label_if:
-            snprintf(tac[tac_index].op, 8, "label");
-            strcpy(tac[tac_index].arg1, label_if);
-            tac[tac_index].arg2[0] = '\0';
-            tac[tac_index].result[0] = '\0';
-            tac_index++;
-
-            generate_stmt(node->if_stmt.if_body);
-
-            // goto label_end
-            snprintf(tac[tac_index].op, 8, "goto");
-            strcpy(tac[tac_index].arg1, label_end);
-            tac[tac_index].arg2[0] = '\0';
-            tac[tac_index].result[0] = '\0';
-            tac_index++;
-
-            // label_else:
-            snprintf(tac[tac_index].op, 8, "label");
-            strcpy(tac[tac_index].arg1, label_else);
-            tac[tac_index].arg2[0] = '\0';
-            tac[tac_index].result[0] = '\0';
-            tac_index++;
-
-            if (node->if_stmt.else_body)
-                generate_stmt(node->if_stmt.else_body);
-
-            // label_end:
-            snprintf(tac[tac_index].op, 8, "label");
-            strcpy(tac[tac_index].arg1, label_end);
-            tac[tac_index].arg2[0] = '\0';
-            tac[tac_index].result[0] = '\0';
-            tac_index++;
-
+        default:
             break;
+    }
+}
+
+// Jumps to `target` unless `cond` holds: if (a < b) becomes "if a >= b
+// goto target"; a non-comparison condition is tested against zero.
+static void generate_condition_jump(ASTNode* cond, TacOperand target) {
+    strict = 0;
+    if (cond && cond->type == NODE_BINOP && cond->binop.op >= OP_EQ) {
+        TacOperand left = generate_expr(cond->binop.left);
+        TacOperand right = generate_expr(cond->binop.right);
+        TacOp branch = (TacOp)(TAC_IF_EQ + (cond->binop.op - OP_EQ));
+        if (checking) semantic_binop_type(cond, 0);
+        tac_emit(prog, tac_negate_compare(branch), target, left, right);
+    } else {
+        TacOperand value = generate_expr(cond);
+        tac_emit(prog, TAC_IF_EQ, target, value, tac_imm(0));
+    }
+    strict = 1;
+}
+
+enum { STMT_ENTER, STMT_AFTER_THEN, STMT_AFTER_ELSE, STMT_AFTER_BODY };
+
+static int is_compound(NodeType type) {
+    return type == NODE_IF || type == NODE_WHILE || type == NODE_STMT_LIST;
+}
+
+// Statement lists resume at the index kept in `state`, so only nested
+// lists, IFs and WHILEs are pushed. An IF is revisited after each branch,
+// and a WHILE after its body, with its two label numbers in data[]. The
+// walk descends into the last child it queues through `current` rather
+// than pushing and popping it.
+static void generate_stmt(ASTNode* root) {
+    WalkStack* stack = &stmt_stack;
+    WalkFrame current = { root, STMT_ENTER, { 0, 0 } };
+
+    for (;;) {
+        if (!current.node) {
+            if (stack->count == 0) break;
+            current = walk_pop(stack);
         }
+        WalkFrame frame = current;
+        ASTNode* node = frame.node;
+        current.node = NULL;
 
-        default:
-            break;
+        switch (node->type) {
+            case NODE_STMT_LIST:
+                for (int i = frame.state; i < node->stmt_list.count; i++) {
+                    ASTNode* stmt = node->stmt_list.stmts[i];
+                    if (!stmt) continue;
+                    if (is_compound(stmt->type)) {
+                        if (i + 1 < node->stmt_list.count) walk_push(stack, node, i + 1);
+                        current.node = stmt;
+                        current.state = STMT_ENTER;
+                        break;
+                    }
+                    generate_simple_stmt(stmt);
+                }
+                break;
+
+            case NODE_IF: {
+                // The then-branch falls through from "if !cond goto else/end"
+                TacOperand label_else, label_end;
+
+                if (frame.state == STMT_ENTER) {
+                    label_else = tac_new_label(prog);
+                    label_end = node->if_stmt.else_body ? tac_new_label(prog) : label_else;
+                    generate_condition_jump(node->if_stmt.condition, label_else);
+
+                    WalkFrame* next = walk_push(stack, node, STMT_AFTER_THEN);
+                    next->data[0] = label_else.value;
+                    next->data[1] = label_end.value;
+                    if (checking) semantic_enter_scope();
+                    current.node = node->if_stmt.if_body;
+                    current.state = STMT_ENTER;
+                    break;
+                }
+
+                label_else = tac_label(frame.data[0]);
+                label_end = tac_label(frame.data[1]);
+                if (checking) semantic_leave_scope();
+                if (frame.state == STMT_AFTER_THEN && node->if_stmt.else_body) {
+                    tac_emit(prog, TAC_GOTO, label_end, tac_none(), tac_none());
+                    tac_emit(prog, TAC_LABEL, label_else, tac_none(), tac_none());
+                    WalkFrame* next = walk_push(stack, node, STMT_AFTER_ELSE);
+                    next->data[0] = frame.data[0];
+                    next->data[1] = frame.data[1];
+                    if (checking) semantic_enter_scope();
+                    current.node = node->if_stmt.else_body;
+                    current.state = STMT_ENTER;
+                    break;
+                }
+                tac_emit(prog, TAC_LABEL, label_end, tac_none(), tac_none());
+                break;
+            }
+
+            case NODE_WHILE: {
+                // head: if !cond goto end; body; goto head; end:
+                if (frame.state == STMT_ENTER) {
+                    TacOperand label_head = tac_new_label(prog);
+                    TacOperand label_end = tac_new_label(prog);
+                    tac_emit(prog, TAC_LABEL, label_head, tac_none(), tac_none());
+                    generate_condition_jump(node->while_stmt.condition, label_end);
+
+                    WalkFrame* next = walk_push(stack, node, STMT_AFTER_BODY);
+                    next->data[0] = label_head.value;
+                    next->data[1] = label_end.value;
+                    if (checking) semantic_enter_scope();
+                    current.node = node->while_stmt.body;
+                    current.state = STMT_ENTER;
+                    break;
+                }
+
+                if (checking) semantic_leave_scope();
+                tac_emit(prog, TAC_GOTO, tac_label(frame.data[0]), tac_none(), tac_none());
+                tac_emit(prog, TAC_LABEL, tac_label(frame.data[1]), tac_none(), tac_none());
+                break;
+            }
+
+            default:
+                generate_simple_stmt(node);
+                break;
+        }
     }
 }
 
-char* generate_expr(ASTNode* node) {
-    if (!node) return strdup("?");
+// Operands of the flat expression being scanned
+static _Thread_local TacOperand* flat_values = NULL;
+static _Thread_local uint32_t flat_values_size = 0;
 
-    switch (node->type) {
-        case NODE_INT: {
-            char* temp = malloc(16);
-            snprintf(temp, 16, "%d", node->int_value);
-            return temp;
+// Post-order puts every operator after its operands, so the expression is
+// one forward scan with an operand stack. Leaves and operators come in the
+// order generate_binop meets them, so the TAC is the same.
+static TacOperand generate_flat_expr(const FlatAst* flat, uint32_t root) {
+    if (root == FLAT_NONE) return tac_none();
+    uint32_t start = flat_expr_start(flat, root);
+    if (root - start + 1 > flat_values_size) {
+        flat_values_size = root - start + 1;
+        flat_values = realloc(flat_values, sizeof(TacOperand) * flat_values_size);
+        if (!flat_values) {
+            fprintf(stderr, "Memory allocation failed for operand stack\n");
+            exit(1);
         }
-        case NODE_BOOL: {
-            char* temp = malloc(16);
-            snprintf(temp, 16, "%d", node->int_value);
-            return temp;
+    }
+
+    TacOperand* values = flat_values;
+    int depth = 0;
+    for (uint32_t i = start; i <= root; i++) {
+        int32_t value = flat->value[i];
+        switch ((NodeType)flat->kind[i]) {
+            case NODE_INT:
+            case NODE_BOOL:
+                values[depth++] = tac_imm(value);
+                break;
+
+            case NODE_VAR:
+                values[depth++] = var_operand(value);
+                break;
+
+            case NODE_BINOP: {
+                TacOperand result = tac_new_temp(prog);
+                depth--;
+                tac_emit(prog, (TacOp)(TAC_ADD + value), result, values[depth - 1], values[depth]);
+                values[depth - 1] = result;
+                break;
+            }
+
+            default:
+                values[depth++] = tac_none();
+                break;
         }
-        case NODE_VAR:
-            return strdup(node->var_name);
+    }
+    return values[0];
+}
 
-        case NODE_BINOP: {
-            char* left = generate_expr(node->binop.left);
-            char* right = generate_expr(node->binop.right);
-            char* temp = new_temp();
+static void generate_flat_simple(const FlatAst* flat, uint32_t node) {
+    switch ((NodeType)flat->kind[node]) {
+        case NODE_DECL:
+            if (flat->lhs[node] != FLAT_NONE) {
+                TacOperand val = generate_flat_expr(flat, flat->lhs[node]);
+                tac_emit(prog, TAC_COPY, var_operand(flat->value[node]), val, tac_none());
+            } else {
+                tac_emit(prog, TAC_COPY, var_operand(flat->value[node]), tac_imm(0), tac_none());
+            }
+            break;
 
-            snprintf(tac[tac_index].op, 8, "%s", node->binop.op);
-            strcpy(tac[tac_index].arg1, left);
-            strcpy(tac[tac_index].arg2, right);
-            strcpy(tac[tac_index].result, temp);
-            tac_index++;
+        case NODE_ASSIGN: {
+            TacOperand val = generate_flat_expr(flat, flat->lhs[node]);
+            tac_emit(prog, TAC_COPY, var_operand(flat->value[node]), val, tac_none());
+            break;
+        }
 
-            return temp;
+        case NODE_PRINT: {
+            TacOperand val = generate_flat_expr(flat, flat->lhs[node]);
+            tac_emit(prog, TAC_PRINT, tac_none(), val, tac_none());
+            break;
         }
 
         default:
-            return strdup("?");
+            break;
+    }
+}
+
+// generate_condition_jump over a FlatAst
+static void generate_flat_condition_jump(const FlatAst* flat, uint32_t cond, TacOperand target) {
+    if (cond != FLAT_NONE && flat->kind[cond] == NODE_BINOP && flat->value[cond] >= OP_EQ) {
+        TacOperand left = generate_flat_expr(flat, flat->lhs[cond]);
+        TacOperand right = generate_flat_expr(flat, flat->rhs[cond]);
+        TacOp branch = (TacOp)(TAC_IF_EQ + (flat->value[cond] - OP_EQ));
+        tac_emit(prog, tac_negate_compare(branch), target, left, right);
+    } else {
+        TacOperand value = generate_flat_expr(flat, cond);
+        tac_emit(prog, TAC_IF_EQ, target, value, tac_imm(0));
+    }
+}
+
+// generate_stmt over a FlatAst. Frames carry the node index in data[0]; an
+// IF keeps its else label in data[1], its end label being the next one
+// when it has an else branch, and a WHILE its head label, followed by its
+// end label.
+static void generate_flat_stmt(const FlatAst* flat) {
+    WalkStack* stack = &stmt_stack;
+    walk_push(stack, NULL, STMT_ENTER)->data[0] = (int32_t)(flat->count - 1);
+
+    while (stack->count > 0) {
+        WalkFrame frame = walk_pop(stack);
+        uint32_t node = (uint32_t)frame.data[0];
+
+        switch ((NodeType)flat->kind[node]) {
+            case NODE_STMT_LIST: {
+                const uint32_t* items = flat->items + flat->lhs[node];
+                uint32_t count = flat->rhs[node];
+                for (uint32_t i = (uint32_t)frame.state; i < count; i++) {
+                    uint8_t kind = flat->kind[items[i]];
+                    if (is_compound((NodeType)kind)) {
+                        if (i + 1 < count) walk_push(stack, NULL, (int)(i + 1))->data[0] = (int32_t)node;
+                        walk_push(stack, NULL, STMT_ENTER)->data[0] = (int32_t)items[i];
+                        break;
+                    }
+                    generate_flat_simple(flat, items[i]);
+                }
+                break;
+            }
+
+            case NODE_IF: {
+                uint32_t else_body = (uint32_t)flat->value[node];
+                TacOperand label_else, label_end;
+
+                if (frame.state == STMT_ENTER) {
+                    label_else = tac_new_label(prog);
+                    label_end = else_body != FLAT_NONE ? tac_new_label(prog) : label_else;
+                    generate_flat_condition_jump(flat, flat->lhs[node], label_else);
+
+                    WalkFrame* next = walk_push(stack, NULL, STMT_AFTER_THEN);
+                    next->data[0] = (int32_t)node;
+                    next->data[1] = label_else.value;
+                    walk_push(stack, NULL, STMT_ENTER)->data[0] = (int32_t)flat->rhs[node];
+                    break;
+                }
+
+                label_else = tac_label(frame.data[1]);
+                label_end = else_body != FLAT_NONE ? tac_label(frame.data[1] + 1) : label_else;
+                if (frame.state == STMT_AFTER_THEN && else_body != FLAT_NONE) {
+                    tac_emit(prog, TAC_GOTO, label_end, tac_none(), tac_none());
+                    tac_emit(prog, TAC_LABEL, label_else, tac_none(), tac_none());
+                    WalkFrame* next = walk_push(stack, NULL, STMT_AFTER_ELSE);
+                    next->data[0] = (int32_t)node;
+                    next->data[1] = frame.data[1];
+                    walk_push(stack, NULL, STMT_ENTER)->data[0] = (int32_t)else_body;
+                    break;
+                }
+                tac_emit(prog, TAC_LABEL, label_end, tac_none(), tac_none());
+                break;
+            }
+
+            case NODE_WHILE:
+                if (frame.state == STMT_ENTER) {
+                    TacOperand label_head = tac_new_label(prog);
+                    TacOperand label_end = tac_new_label(prog);
+                    tac_emit(prog, TAC_LABEL, label_head, tac_none(), tac_none());
+                    generate_flat_condition_jump(flat, flat->lhs[node], label_end);
+
+                    WalkFrame* next = walk_push(stack, NULL, STMT_AFTER_BODY);
+                    next->data[0] = (int32_t)node;
+                    next->data[1] = label_head.value;
+                    walk_push(stack, NULL, STMT_ENTER)->data[0] = (int32_t)flat->rhs[node];
+                    break;
+                }
+                tac_emit(prog, TAC_GOTO, tac_label(frame.data[1]), tac_none(), tac_none());
+                tac_emit(prog, TAC_LABEL, tac_label(frame.data[1] + 1), tac_none(), tac_none());
+                break;
+
+            default:
+                generate_flat_simple(flat, node);
+                break;
+        }
     }
 }
 
-void emit_TAC_to_file(const char* filename) {
+void emit_TAC_to_file(const TacProgram* program, const char* filename) {
     FILE* f = fopen(filename, "w");
     if (!f) {
         perror("fopen");
         exit(1);
     }
-    for (int i = 0; i < tac_index; i++) {
-        if (strcmp(tac[i].op, "print") == 0) {
-            fprintf(f, "print %s\n", tac[i].arg1);
-        } else if (strcmp(tac[i].op, "=") == 0) {
-            fprintf(f, "%s = %s\n", tac[i].result, tac[i].arg1);
-        } else if (strcmp(tac[i].op, "ifgoto") == 0) {
-            fprintf(f, "if %s goto %s\n", tac[i].arg1, tac[i].arg2);
-        } else if (strcmp(tac[i].op, "goto") == 0) {
-            fprintf(f, "goto %s\n", tac[i].arg1);
-        } else if (strcmp(tac[i].op, "label") == 0) {
-            fprintf(f, "%s:\n", tac[i].arg1);
-        } else {
-            fprintf(f, "%s = %s %s %s\n", tac[i].result, tac[i].arg1, tac[i].op, tac[i].arg2);
-        }
-    }
+    tac_write(program, f);
     fclose(f);
 }
 
-void generate_code(ASTNode* root, const char* filename) {
-    tac_index = 0;
-    temp_index = 0;
+void generate_code(ASTNode* root, TacProgram* out) {
+    prog = out;
+    tac_clear(prog);
+    for (int i = 0; i < var_index_size; i++) var_index[i] = -1;
     generate_stmt(root);
-    emit_TAC_to_file(filename);
+    prog = NULL;
+}
+
+void generate_code_flat(const FlatAst* flat, TacProgram* out) {
+    prog = out;
+    tac_clear(prog);
+    for (int i = 0; i < var_index_size; i++) var_index[i] = -1;
+    if (flat->count > 0) generate_flat_stmt(flat);
+    prog = NULL;
+}
+
+int generate_code_checked(ASTNode* root, TacProgram* out) {
+    semantic_begin();
+    checking = 1;
+    generate_code(root, out);
+    checking = 0;
+    return semantic_end();
 }
@@ -2,7 +2,16 @@
 #define CODEGEN_H
 
 #include "ast.h"
+#include "flatast.h"
+#include "tac.h"
 
-void generate_code(ASTNode* root, const char* filename);
+void generate_code(ASTNode* root, TacProgram* prog);
+// Semantic checking and code generation in one walk, for a tree that has
+// not been through semantic_check. Returns the number of semantic errors;
+// the TAC is only meaningful when that is 0.
+int generate_code_checked(ASTNode* root, TacProgram* prog);
+// Same TAC as generate_code, from the flat layout
+void generate_code_flat(const FlatAst* flat, TacProgram* prog);
+void emit_TAC_to_file(const TacProgram* prog, const char* filename);
 
 #endif
@@ -0,0 +1,112 @@
+// context.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "context.h"
+
+// Pipes and terminals cannot be mapped; copy them into the heap instead
+static int read_stream(CompileContext* ctx, FILE* in) {
+    size_t capacity = 4096;
+    size_t length = 0;
+    char* buffer = malloc(capacity);
+    if (!buffer) {
+        fprintf(stderr, "Out of memory while reading input\n");
+        return -1;
+    }
+    size_t n;
+    while ((n = fread(buffer + length, 1, capacity - length - 2, in)) > 0) {
+        length += n;
+        if (capacity - length < 2 + 1024) {
+            capacity *= 2;
+            char* grown = realloc(buffer, capacity);
+            if (!grown) {
+                free(buffer);
+                fprintf(stderr, "Out of memory while reading input\n");
+                return -1;
+            }
+            buffer = grown;
+        }
+    }
+    buffer[length] = buffer[length + 1] = '\0';
+    ctx->buffer = buffer;
+    ctx->length = length;
+    ctx->mapped = 0;
+    return 0;
+}
+
+int context_load(CompileContext* ctx, const char* path) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->path = path;
+    if (!path) return read_stream(ctx, stdin);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat");
+        close(fd);
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        FILE* in = fdopen(fd, "r");
+        int result = in ? read_stream(ctx, in) : -1;
+        if (in) fclose(in); else close(fd);
+        return result;
+    }
+
+    // Flex scans a buffer in place if it ends in two NULs. Reserve zeroed
+    // anonymous pages for the source plus those two bytes, then map the
+    // file over the front: the tail of the file's last page reads as zero
+    // and any page past it stays anonymous. The mapping is private and
+    // writable because flex briefly NUL-terminates each token; only pages
+    // it touches get copied.
+    size_t length = (size_t)st.st_size;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapped = (length + 2 + page - 1) / page * page;
+    char* base = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return -1;
+    }
+    if (length > 0 &&
+        mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        perror("mmap");
+        munmap(base, mapped);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    madvise(base, mapped, MADV_SEQUENTIAL);
+
+    ctx->buffer = base;
+    ctx->length = length;
+    ctx->mapped = mapped;
+    return 0;
+}
+
+static _Thread_local FILE* diag_file = NULL;
+
+FILE* diag_stream() {
+    return diag_file ? diag_file : stderr;
+}
+
+void diag_redirect(FILE* stream) {
+    diag_file = stream;
+}
+
+void context_release(CompileContext* ctx) {
+    if (!ctx->buffer) return;
+    if (ctx->mapped) munmap(ctx->buffer, ctx->mapped);
+    else free(ctx->buffer);
+    ctx->buffer = NULL;
+    ctx->length = ctx->mapped = 0;
+}
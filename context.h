@@ -0,0 +1,44 @@
+// context.h
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct ASTNode;
+
+// Everything one compilation's scanner and parser need, so several inputs
+// can be compiled side by side in one process.
+typedef struct CompileContext {
+    const char* path;       // NULL when reading standard input
+    char* buffer;           // source text followed by two NUL bytes
+    size_t length;          // source bytes, not counting the NULs
+    size_t mapped;          // bytes mapped, or 0 if `buffer` is heap memory
+    struct ASTNode* root;
+    int syntax_errors;      // lexical and syntax errors reported so far
+    int print_tokens;       // echo each token as it is scanned
+    long tokens;            // tokens handed to the parser
+} CompileContext;
+
+// Maps `path` (or reads standard input when NULL) into ctx->buffer.
+// Returns 0 on success, -1 after reporting the error.
+int context_load(CompileContext* ctx, const char* path);
+
+// Releases the source buffer; ctx->root stays valid.
+void context_release(CompileContext* ctx);
+
+// Scans ctx->buffer in place and parses it into ctx->root.
+// Defined in scanner.c, which picks the scanner (scanner.h).
+int parse_context(CompileContext* ctx);
+
+// Runs only the scanner over ctx->buffer and returns the token count
+long scan_context(CompileContext* ctx);
+
+// Where this thread's compile diagnostics (lexical, syntax and semantic
+// errors, warnings) go: stderr unless redirected, e.g. by the compile
+// server to answer each request with its own. NULL restores stderr.
+FILE* diag_stream();
+void diag_redirect(FILE* stream);
+
+#endif
@@ -0,0 +1,286 @@
+// flatast.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flatast.h"
+#include "intern.h"
+#include "walk.h"
+
+static void* checked_realloc(void* ptr, size_t size) {
+    void* p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for flat AST\n");
+        exit(1);
+    }
+    return p;
+}
+
+void flat_init(FlatAst* flat) {
+    memset(flat, 0, sizeof(*flat));
+}
+
+void flat_free(FlatAst* flat) {
+    free(flat->kind);
+    free(flat->lhs);
+    free(flat->rhs);
+    free(flat->value);
+    free(flat->items);
+    memset(flat, 0, sizeof(*flat));
+}
+
+size_t flat_bytes(const FlatAst* flat) {
+    size_t per_node = sizeof(*flat->kind) + sizeof(*flat->lhs) + sizeof(*flat->rhs) +
+                      sizeof(*flat->value);
+    return flat->count * per_node + flat->item_count * sizeof(*flat->items);
+}
+
+static uint32_t add_node(FlatAst* flat, NodeType kind, uint32_t lhs, uint32_t rhs, int32_t value) {
+    if (flat->count == flat->capacity) {
+        flat->capacity = flat->capacity ? flat->capacity * 2 : 1024;
+        flat->kind = checked_realloc(flat->kind, sizeof(*flat->kind) * flat->capacity);
+        flat->lhs = checked_realloc(flat->lhs, sizeof(*flat->lhs) * flat->capacity);
+        flat->rhs = checked_realloc(flat->rhs, sizeof(*flat->rhs) * flat->capacity);
+        flat->value = checked_realloc(flat->value, sizeof(*flat->value) * flat->capacity);
+    }
+    uint32_t index = flat->count++;
+    flat->kind[index] = (uint8_t)kind;
+    flat->lhs[index] = lhs;
+    flat->rhs[index] = rhs;
+    flat->value[index] = value;
+    return index;
+}
+
+// Slots for the statements of one list, filled in as they are built
+static uint32_t reserve_items(FlatAst* flat, int count) {
+    while (flat->item_count + count > flat->item_capacity) {
+        flat->item_capacity = flat->item_capacity ? flat->item_capacity * 2 : 1024;
+        flat->items = checked_realloc(flat->items, sizeof(*flat->items) * flat->item_capacity);
+    }
+    uint32_t start = flat->item_count;
+    flat->item_count += count;
+    return start;
+}
+
+static _Thread_local WalkStack build_stack;
+
+// Post-order on an explicit stack. A frame in state 0 is on its first
+// visit; later states resume it once the child it pushed has been added,
+// which is then always the newest node. Child indices wait in data[].
+void flat_build(FlatAst* flat, ASTNode* root) {
+    WalkStack* stack = &build_stack;
+    flat->count = 0;
+    flat->item_count = 0;
+    if (!root) return;
+    walk_push(stack, root, 0);
+
+    while (stack->count > 0) {
+        WalkFrame* frame = &stack->frames[stack->count - 1];
+        ASTNode* node = frame->node;
+        uint32_t last = flat->count - 1;
+
+        switch (node->type) {
+            case NODE_INT:
+            case NODE_BOOL:
+                add_node(flat, node->type, FLAT_NONE, FLAT_NONE, node->int_value);
+                stack->count--;
+                break;
+
+            case NODE_VAR:
+                add_node(flat, NODE_VAR, FLAT_NONE, FLAT_NONE, node->var_id);
+                stack->count--;
+                break;
+
+            case NODE_BINOP:
+                if (frame->state == 0) {
+                    frame->state = 1;
+                    walk_push(stack, node->binop.left, 0);
+                } else if (frame->state == 1) {
+                    frame->state = 2;
+                    frame->data[0] = (int32_t)last;
+                    walk_push(stack, node->binop.right, 0);
+                } else {
+                    add_node(flat, NODE_BINOP, (uint32_t)frame->data[0], last, node->binop.op);
+                    stack->count--;
+                }
+                break;
+
+            case NODE_ASSIGN:
+                if (frame->state == 0) {
+                    frame->state = 1;
+                    walk_push(stack, node->assign.expr, 0);
+                } else {
+                    add_node(flat, NODE_ASSIGN, last, FLAT_NONE, node->assign.var_id);
+                    stack->count--;
+                }
+                break;
+
+            case NODE_DECL:
+                if (frame->state == 0 && node->decl.init_value) {
+                    frame->state = 1;
+                    walk_push(stack, node->decl.init_value, 0);
+                } else {
+                    add_node(flat, NODE_DECL, frame->state ? last : FLAT_NONE,
+                             node->decl.declared_type, node->decl.var_id);
+                    stack->count--;
+                }
+                break;
+
+            case NODE_PRINT:
+                if (frame->state == 0) {
+                    frame->state = 1;
+                    walk_push(stack, node->print_expr, 0);
+                } else {
+                    add_node(flat, NODE_PRINT, last, FLAT_NONE, 0);
+                    stack->count--;
+                }
+                break;
+
+            case NODE_IF:
+                if (frame->state == 0) {
+                    frame->state = 1;
+                    walk_push(stack, node->if_stmt.condition, 0);
+                } else if (frame->state == 1) {
+                    frame->state = 2;
+                    frame->data[0] = (int32_t)last;
+                    walk_push(stack, node->if_stmt.if_body, 0);
+                } else if (frame->state == 2 && node->if_stmt.else_body) {
+                    frame->state = 3;
+                    frame->data[1] = (int32_t)last;
+                    walk_push(stack, node->if_stmt.else_body, 0);
+                } else {
+                    uint32_t then_body = frame->state == 3 ? (uint32_t)frame->data[1] : last;
+                    uint32_t else_body = frame->state == 3 ? last : FLAT_NONE;
+                    add_node(flat, NODE_IF, (uint32_t)frame->data[0], then_body, (int32_t)else_body);
+                    stack->count--;
+                }
+                break;
+
+            case NODE_WHILE:
+                if (frame->state == 0) {
+                    frame->state = 1;
+                    walk_push(stack, node->while_stmt.condition, 0);
+                } else if (frame->state == 1) {
+                    frame->state = 2;
+                    frame->data[0] = (int32_t)last;
+                    walk_push(stack, node->while_stmt.body, 0);
+                } else {
+                    add_node(flat, NODE_WHILE, (uint32_t)frame->data[0], last, 0);
+                    stack->count--;
+                }
+                break;
+
+            case NODE_STMT_LIST: {
+                // state is one past the statement just built; data[0] is
+                // where the list's items start and data[1] how many are in
+                int next = 0;
+                if (frame->state == 0) {
+                    frame->data[0] = (int32_t)reserve_items(flat, node->stmt_list.count);
+                    frame->data[1] = 0;
+                } else {
+                    flat->items[frame->data[0] + frame->data[1]++] = last;
+                    next = frame->state;
+                }
+                while (next < node->stmt_list.count && !node->stmt_list.stmts[next]) next++;
+                if (next < node->stmt_list.count) {
+                    frame->state = next + 1;
+                    walk_push(stack, node->stmt_list.stmts[next], 0);
+                    break;
+                }
+                add_node(flat, NODE_STMT_LIST, (uint32_t)frame->data[0], (uint32_t)frame->data[1], 0);
+                stack->count--;
+                break;
+            }
+        }
+    }
+}
+
+enum { PRINT_NODE, PRINT_THEN, PRINT_ELSE, PRINT_DO };
+
+static void push_print(WalkStack* stack, uint32_t node, int indent) {
+    if (node == FLAT_NONE) return;
+    WalkFrame* frame = walk_push(stack, NULL, PRINT_NODE);
+    frame->data[0] = indent;
+    frame->data[1] = (int32_t)node;
+}
+
+// Pre-order like print_ast: children are pushed last to first
+void print_flat_ast(const FlatAst* flat) {
+    if (flat->count == 0) return;
+    WalkStack stack = {0};
+    push_print(&stack, flat->count - 1, 0);
+
+    while (stack.count > 0) {
+        WalkFrame frame = walk_pop(&stack);
+        if (frame.state == PRINT_THEN) {
+            printf("THEN:\n");
+            continue;
+        }
+        if (frame.state == PRINT_ELSE) {
+            printf("ELSE:\n");
+            continue;
+        }
+        if (frame.state == PRINT_DO) {
+            printf("DO:\n");
+            continue;
+        }
+
+        int indent = frame.data[0];
+        uint32_t node = (uint32_t)frame.data[1];
+        int32_t value = flat->value[node];
+        for (int i = 0; i < indent; ++i) printf("  ");
+
+        switch ((NodeType)flat->kind[node]) {
+            case NODE_INT:
+                printf("INT: %d\n", value);
+                break;
+            case NODE_BOOL:
+                printf("BOOL: %s\n", value ? "true" : "false");
+                break;
+            case NODE_VAR:
+                printf("VAR: %s\n", intern_name(value));
+                break;
+            case NODE_BINOP:
+                printf("BINOP: %s\n", binop_symbol((BinOp)value));
+                push_print(&stack, flat->rhs[node], indent + 1);
+                push_print(&stack, flat->lhs[node], indent + 1);
+                break;
+            case NODE_ASSIGN:
+                printf("ASSIGN: %s\n", intern_name(value));
+                push_print(&stack, flat->lhs[node], indent + 1);
+                break;
+            case NODE_DECL:
+                printf("DECL: %s\n", intern_name(value));
+                push_print(&stack, flat->lhs[node], indent + 1);
+                break;
+            case NODE_PRINT:
+                printf("PRINT:\n");
+                push_print(&stack, flat->lhs[node], indent + 1);
+                break;
+            case NODE_IF:
+                printf("IF:\n");
+                if ((uint32_t)value != FLAT_NONE) {
+                    push_print(&stack, (uint32_t)value, indent + 1);
+                    walk_push(&stack, NULL, PRINT_ELSE);
+                }
+                push_print(&stack, flat->rhs[node], indent + 1);
+                walk_push(&stack, NULL, PRINT_THEN);
+                push_print(&stack, flat->lhs[node], indent + 1);
+                break;
+            case NODE_WHILE:
+                printf("WHILE:\n");
+                push_print(&stack, flat->rhs[node], indent + 1);
+                walk_push(&stack, NULL, PRINT_DO);
+                push_print(&stack, flat->lhs[node], indent + 1);
+                break;
+            case NODE_STMT_LIST:
+                printf("STMT_LIST:\n");
+                for (uint32_t i = flat->rhs[node]; i > 0; i--) {
+                    push_print(&stack, flat->items[flat->lhs[node] + i - 1], indent + 1);
+                }
+                break;
+        }
+    }
+
+    walk_free(&stack);
+}
@@ -0,0 +1,63 @@
+// flatast.h
+//
+// The AST laid out flat: nodes in post-order in parallel arrays, children
+// named by 32-bit index instead of pointer. Every child comes before its
+// parent and the root is the last node. An expression fills the
+// contiguous range that ends at its root, so it can be evaluated by one
+// forward scan with an operand stack.
+//
+//   kind        lhs                rhs              value
+//   INT, BOOL   -                  -                literal
+//   VAR         -                  -                interned name ID
+//   BINOP       left               right (= i - 1)  BinOp
+//   ASSIGN      expr               -                name ID
+//   DECL        init or FLAT_NONE  declared Type    name ID
+//   PRINT       expr               -                -
+//   IF          condition          then body        else body or FLAT_NONE
+//   WHILE       condition          body             -
+//   STMT_LIST   first in `items`   statement count  -
+//
+// The statements of a list sit side by side in `items`.
+
+#ifndef FLATAST_H
+#define FLATAST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+
+#define FLAT_NONE UINT32_MAX
+
+typedef struct {
+    uint8_t* kind;          // NodeType
+    uint32_t* lhs;
+    uint32_t* rhs;
+    int32_t* value;
+    uint32_t count;
+    uint32_t capacity;
+
+    uint32_t* items;
+    uint32_t item_count;
+    uint32_t item_capacity;
+} FlatAst;
+
+void flat_init(FlatAst* flat);
+void flat_free(FlatAst* flat);
+
+// Replaces the contents of `flat` with the tree under `root`; the tree
+// is only read
+void flat_build(FlatAst* flat, ASTNode* root);
+
+// Bytes of node and item data in use
+size_t flat_bytes(const FlatAst* flat);
+
+// First node of the expression ending at `root`: its leftmost leaf
+static inline uint32_t flat_expr_start(const FlatAst* flat, uint32_t root) {
+    while (flat->kind[root] == NODE_BINOP) root = flat->lhs[root];
+    return root;
+}
+
+// Prints the same listing as print_ast(root, 0)
+void print_flat_ast(const FlatAst* flat);
+
+#endif
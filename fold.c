@@ -0,0 +1,213 @@
+// fold.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include "fold.h"
+#include "context.h"
+#include "walk.h"
+
+static _Thread_local FoldStats* stats;
+
+static int is_constant(ASTNode* node) {
+    return node && (node->type == NODE_INT || node->type == NODE_BOOL);
+}
+
+// Evaluates like the generated code does: two's-complement wrap-around and
+// truncating division. Returns 0 when the operation must be left to run time.
+static int evaluate(BinOp op, int32_t l, int32_t r, int32_t* result) {
+    switch (op) {
+        case OP_ADD: *result = (int32_t)((uint32_t)l + (uint32_t)r); return 1;
+        case OP_SUB: *result = (int32_t)((uint32_t)l - (uint32_t)r); return 1;
+        case OP_MUL: *result = (int32_t)((uint32_t)l * (uint32_t)r); return 1;
+        case OP_DIV:
+            if (r == 0) return 0;   // fold_binop has warned
+            *result = r == -1 ? (int32_t)(0u - (uint32_t)l) : l / r;
+            return 1;
+        case OP_EQ: *result = l == r; return 1;
+        case OP_NE: *result = l != r; return 1;
+        case OP_LT: *result = l < r;  return 1;
+        case OP_LE: *result = l <= r; return 1;
+        case OP_GT: *result = l > r;  return 1;
+        case OP_GE: *result = l >= r; return 1;
+    }
+    return 0;
+}
+
+// Both walks run on explicit stacks kept between calls, so nesting depth
+// costs heap memory instead of C stack.
+static _Thread_local WalkStack expr_stack;
+static _Thread_local WalkStack stmt_stack;
+
+static int is_binop(ASTNode* node) {
+    return node && node->type == NODE_BINOP;
+}
+
+static void fold_binop(ASTNode* node) {
+    BinOp op = node->binop.op;
+    ASTNode* right = node->binop.right;
+    // Whatever the left side is; the right one may have just been folded
+    if (op == OP_DIV && is_constant(right) && right->int_value == 0) {
+        fprintf(diag_stream(), "Warning: division by constant zero at line %d is left to fail at run time\n",
+                node->binop.line);
+        return;
+    }
+    if (!is_constant(node->binop.left) || !is_constant(right)) return;
+
+    int32_t value;
+    if (!evaluate(op, node->binop.left->int_value, right->int_value, &value)) return;
+
+    // Comparisons produce a boolean, arithmetic an int
+    node->type = op >= OP_EQ ? NODE_BOOL : NODE_INT;
+    node->int_value = value;
+    stats->folded_nodes++;
+}
+
+// A BINOP on the stack waits for its left subtree, or for its right one
+// once the left has been folded.
+enum { FOLD_WANT_LEFT, FOLD_WANT_RIGHT };
+
+// Post-order with a left-spine descent, as in generate_expr: each BINOP
+// folds once its operands have had their chance to.
+static void fold_expr(ASTNode* node) {
+    if (!is_binop(node)) return;
+
+    WalkStack* stack = &expr_stack;
+    ASTNode* next = node;
+
+    for (;;) {
+        int right_done = 0;
+
+        if (next) {
+            node = next;
+            while (is_binop(node->binop.left)) {
+                walk_push(stack, node, FOLD_WANT_LEFT);
+                node = node->binop.left;
+            }
+        } else if (stack->count > 0) {
+            WalkFrame frame = walk_pop(stack);
+            node = frame.node;
+            right_done = frame.state == FOLD_WANT_RIGHT;
+        } else {
+            return;
+        }
+
+        if (!right_done && is_binop(node->binop.right)) {
+            walk_push(stack, node, FOLD_WANT_RIGHT);
+            next = node->binop.right;
+            continue;
+        }
+
+        fold_binop(node);
+        next = NULL;
+    }
+}
+
+static void fold_simple_stmt(ASTNode* node) {
+    switch (node->type) {
+        case NODE_DECL:
+            fold_expr(node->decl.init_value);
+            break;
+
+        case NODE_ASSIGN:
+            fold_expr(node->assign.expr);
+            break;
+
+        case NODE_PRINT:
+            fold_expr(node->print_expr);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Statement lists resume at the index kept in `state`, so straight-line
+// statements are folded without touching the stack. An IF is revisited
+// in state 1 after both branches are folded, when it can be replaced by
+// the branch a constant condition selects; a WHILE whose condition folds
+// to false goes at once. The walk descends into the last child it queues
+// through `current` rather than pushing it.
+static void fold_stmt(ASTNode* root) {
+    WalkStack* stack = &stmt_stack;
+    WalkFrame current = { root, 0, { 0, 0 } };
+
+    for (;;) {
+        if (!current.node) {
+            if (stack->count == 0) break;
+            current = walk_pop(stack);
+        }
+        WalkFrame frame = current;
+        ASTNode* node = frame.node;
+        current.node = NULL;
+
+        switch (node->type) {
+            case NODE_STMT_LIST:
+                for (int i = frame.state; i < node->stmt_list.count; i++) {
+                    ASTNode* stmt = node->stmt_list.stmts[i];
+                    if (!stmt) continue;
+                    if (stmt->type == NODE_IF || stmt->type == NODE_WHILE ||
+                        stmt->type == NODE_STMT_LIST) {
+                        if (i + 1 < node->stmt_list.count) walk_push(stack, node, i + 1);
+                        current.node = stmt;
+                        current.state = 0;
+                        break;
+                    }
+                    fold_simple_stmt(stmt);
+                }
+                break;
+
+            case NODE_IF: {
+                if (frame.state == 0) {
+                    fold_expr(node->if_stmt.condition);
+                    walk_push(stack, node, 1);
+                    if (node->if_stmt.else_body)
+                        walk_push(stack, node->if_stmt.else_body, 0);
+                    current.node = node->if_stmt.if_body;
+                    current.state = 0;
+                    break;
+                }
+                if (!is_constant(node->if_stmt.condition)) break;
+
+                ASTNode* taken = node->if_stmt.condition->int_value
+                    ? node->if_stmt.if_body
+                    : node->if_stmt.else_body;
+                if (taken) {
+                    *node = *taken;     // both are statement lists from here on
+                } else {
+                    node->type = NODE_STMT_LIST;
+                    node->stmt_list.stmts = NULL;
+                    node->stmt_list.count = 0;
+                    node->stmt_list.capacity = 0;
+                }
+                stats->removed_branches++;
+                break;
+            }
+
+            case NODE_WHILE:
+                fold_expr(node->while_stmt.condition);
+                if (is_constant(node->while_stmt.condition) && !node->while_stmt.condition->int_value) {
+                    node->type = NODE_STMT_LIST;
+                    node->stmt_list.stmts = NULL;
+                    node->stmt_list.count = 0;
+                    node->stmt_list.capacity = 0;
+                    stats->removed_branches++;
+                    break;
+                }
+                current.node = node->while_stmt.body;
+                current.state = 0;
+                break;
+
+            default:
+                fold_simple_stmt(node);
+                break;
+        }
+    }
+}
+
+void fold_constants(ASTNode* root, FoldStats* out) {
+    out->folded_nodes = 0;
+    out->removed_branches = 0;
+    stats = out;
+    fold_stmt(root);
+    stats = NULL;
+}
@@ -0,0 +1,17 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "ast.h"
+
+typedef struct {
+    int folded_nodes;       // binops replaced by a literal
+    int removed_branches;   // if statements resolved, while loops that never run
+} FoldStats;
+
+// Folds constant int/bool subtrees in place, replaces an if whose
+// condition is constant with the branch that is taken and drops a while
+// whose condition is constant false. Run after semantic_check, so the
+// tree is known to be well typed.
+void fold_constants(ASTNode* root, FoldStats* stats);
+
+#endif
@@ -0,0 +1,153 @@
+// generator.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include "generator.h"
+
+typedef struct {
+    FILE* out;
+    size_t written;
+    uint64_t state;
+    const GeneratorOptions* options;
+    int int_count;          // variables i0..i{n-1}
+    int bool_count;         // variables b0..b{n-1}
+    int loop_count;         // loop counters l0..l{n-1}, one per nesting level
+} Generator;
+
+void generator_defaults(GeneratorOptions* options) {
+    options->size = 64 * 1024;
+    options->identifiers = 100;
+    options->expr_depth = 3;
+    options->if_depth = 3;
+    options->bool_percent = 20;
+    options->loop_percent = 0;
+    options->seed = 1;
+}
+
+// xorshift64*: fast and reproducible for a given seed
+static uint32_t next_random(Generator* g) {
+    g->state ^= g->state >> 12;
+    g->state ^= g->state << 25;
+    g->state ^= g->state >> 27;
+    return (uint32_t)((g->state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+static int below(Generator* g, int n) {
+    return n > 0 ? (int)(next_random(g) % (uint32_t)n) : 0;
+}
+
+static void emit(Generator* g, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vfprintf(g->out, fmt, args);
+    va_end(args);
+    if (n > 0) g->written += n;
+}
+
+static void indent(Generator* g, int level) {
+    for (int i = 0; i < level; i++) emit(g, "    ");
+}
+
+static void int_expr(Generator* g, int depth) {
+    if (depth <= 0 || below(g, 3) == 0) {
+        if (g->int_count > 0 && below(g, 3) != 0) emit(g, "i%d", below(g, g->int_count));
+        else emit(g, "%d", below(g, 1000));
+        return;
+    }
+    static const char* ops = "+-*/";
+    int op = below(g, 4);
+    int parens = below(g, 4) == 0;
+    if (parens) emit(g, "(");
+    int_expr(g, depth - 1);
+    if (ops[op] == '/') {
+        emit(g, " / %d", 1 + below(g, 9));     // never divides by zero
+    } else {
+        emit(g, " %c ", ops[op]);
+        int_expr(g, depth - 1);
+    }
+    if (parens) emit(g, ")");
+}
+
+static void statement(Generator* g, int level, int if_depth);
+
+static void body(Generator* g, int level, int if_depth) {
+    int count = 1 + below(g, 3);
+    for (int i = 0; i < count; i++) statement(g, level, if_depth);
+}
+
+static void statement(Generator* g, int level, int if_depth) {
+    const GeneratorOptions* o = g->options;
+    int kind = below(g, 10);
+    indent(g, level);
+    if (kind < 2 && if_depth < o->if_depth && g->loop_count > 0 && below(g, 100) < o->loop_percent) {
+        // nothing else assigns l<n>, so the loop runs 1 to 4 times
+        emit(g, "l%d = 0;\n", if_depth);
+        indent(g, level);
+        emit(g, "while (l%d < %d) {\n", if_depth, 1 + below(g, 4));
+        body(g, level + 1, if_depth + 1);
+        indent(g, level + 1);
+        emit(g, "l%d = l%d + 1;\n", if_depth, if_depth);
+        indent(g, level);
+        emit(g, "}\n");
+    } else if (kind < 2 && if_depth < o->if_depth) {
+        static const char* comparisons[] = { "==", "!=", "<", "<=", ">", ">=" };
+        emit(g, "if (");
+        int_expr(g, o->expr_depth - 1);
+        emit(g, " %s ", comparisons[below(g, 6)]);
+        int_expr(g, o->expr_depth - 1);
+        emit(g, ") {\n");
+        body(g, level + 1, if_depth + 1);
+        indent(g, level);
+        if (below(g, 2)) {
+            emit(g, "} else {\n");
+            body(g, level + 1, if_depth + 1);
+            indent(g, level);
+        }
+        emit(g, "}\n");
+    } else if (kind < 4) {
+        if (g->bool_count > 0 && below(g, 4) == 0) emit(g, "print b%d;\n", below(g, g->bool_count));
+        else {
+            emit(g, "print ");
+            int_expr(g, o->expr_depth);
+            emit(g, ";\n");
+        }
+    } else if (g->bool_count > 0 && below(g, 100) < o->bool_percent) {
+        int target = below(g, g->bool_count);
+        if (below(g, 2)) emit(g, "b%d = %s;\n", target, below(g, 2) ? "true" : "false");
+        else emit(g, "b%d = b%d;\n", target, below(g, g->bool_count));
+    } else if (g->int_count > 0) {
+        emit(g, "i%d = ", below(g, g->int_count));
+        int_expr(g, o->expr_depth);
+        emit(g, ";\n");
+    } else {
+        emit(g, "print %d;\n", below(g, 1000));
+    }
+}
+
+size_t generate_program(FILE* out, const GeneratorOptions* options) {
+    Generator g;
+    g.out = out;
+    g.written = 0;
+    g.state = 0x9e3779b97f4a7c15ULL ^ ((uint64_t)options->seed << 1 | 1);
+    g.options = options;
+    g.bool_count = options->identifiers * options->bool_percent / 100;
+    g.int_count = options->identifiers - g.bool_count;
+    g.loop_count = options->loop_percent > 0 ? options->if_depth : 0;
+
+    emit(&g, "// generated: seed %u, %d identifiers\n", options->seed, options->identifiers);
+    for (int i = 0; i < g.int_count; i++) {
+        emit(&g, "int i%d = %d;\n", i, below(&g, 100));
+    }
+    for (int i = 0; i < g.bool_count; i++) {
+        emit(&g, "bool b%d = %s;\n", i, below(&g, 2) ? "true" : "false");
+    }
+    for (int i = 0; i < g.loop_count; i++) {
+        emit(&g, "int l%d = 0;\n", i);
+    }
+    while (g.written < options->size) {
+        statement(&g, 0, 0);
+    }
+    return g.written;
+}
@@ -0,0 +1,27 @@
+// generator.h
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef struct {
+    size_t size;            // stop once roughly this many bytes are written
+    int identifiers;        // variables declared up front
+    int expr_depth;         // maximum depth of arithmetic expressions
+    int if_depth;           // maximum nesting of if and while statements
+    int loop_percent;       // share of those that are while loops, 0-100
+    int bool_percent;       // share of bool variables, 0-100
+    unsigned seed;
+} GeneratorOptions;
+
+void generator_defaults(GeneratorOptions* options);
+
+// Writes a valid program: every name is declared before use, types always
+// match, division is only by non-zero constants and every loop counts a
+// counter of its own up to a small bound, so it also runs.
+// Returns the number of bytes written.
+size_t generate_program(FILE* out, const GeneratorOptions* options);
+
+#endif
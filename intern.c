@@ -0,0 +1,122 @@
+// intern.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "arena.h"
+
+#define INTERN_INITIAL_SLOTS 256
+
+typedef struct {
+    const char* name;
+    uint32_t hash;
+    uint32_t len;
+} InternEntry;
+
+static _Thread_local Arena strings;
+static _Thread_local InternEntry* entries = NULL;
+static _Thread_local int entry_count = 0;
+static _Thread_local int entry_capacity = 0;
+static _Thread_local int* slots = NULL;        // entry index + 1, 0 = empty
+static _Thread_local uint32_t slot_mask = 0;
+
+static void* checked_realloc(void* ptr, size_t size) {
+    void* p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for intern table\n");
+        exit(1);
+    }
+    return p;
+}
+
+// FNV-1a
+static uint32_t hash_bytes(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void alloc_slots(uint32_t size) {
+    free(slots);
+    slots = checked_realloc(NULL, sizeof(int) * size);
+    memset(slots, 0, sizeof(int) * size);
+    slot_mask = size - 1;
+    for (int i = 0; i < entry_count; i++) {
+        uint32_t s = entries[i].hash & slot_mask;
+        while (slots[s]) s = (s + 1) & slot_mask;
+        slots[s] = i + 1;
+    }
+}
+
+int intern(const char* s, size_t len) {
+    if (!slots) {
+        arena_init(&strings, 64 * 1024);
+        alloc_slots(INTERN_INITIAL_SLOTS);
+    }
+
+    uint32_t h = hash_bytes(s, len);
+    uint32_t i = h & slot_mask;
+    while (slots[i]) {
+        InternEntry* e = &entries[slots[i] - 1];
+        if (e->hash == h && e->len == len && memcmp(e->name, s, len) == 0) {
+            return slots[i] - 1;
+        }
+        i = (i + 1) & slot_mask;
+    }
+
+    if (entry_count == entry_capacity) {
+        entry_capacity = entry_capacity ? entry_capacity * 2 : 256;
+        entries = checked_realloc(entries, sizeof(InternEntry) * entry_capacity);
+    }
+    char* copy = arena_alloc(&strings, len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+
+    int id = entry_count++;
+    entries[id].name = copy;
+    entries[id].hash = h;
+    entries[id].len = (uint32_t)len;
+    slots[i] = id + 1;
+
+    // Keep the load factor at or below 1/2
+    if ((uint32_t)entry_count * 2 > slot_mask + 1) {
+        alloc_slots((slot_mask + 1) * 2);
+    }
+    return id;
+}
+
+const char* intern_name(int id) {
+    if (id < 0 || id >= entry_count) return "?";
+    return entries[id].name;
+}
+
+uint32_t intern_hash(int id) {
+    return entries[id].hash;
+}
+
+int intern_count() {
+    return entry_count;
+}
+
+void intern_reset() {
+    if (!slots) return;
+    entry_count = 0;
+    memset(slots, 0, sizeof(int) * (slot_mask + 1));
+    arena_reset(&strings);
+}
+
+void intern_destroy() {
+    if (!slots) return;
+    arena_destroy(&strings);
+    free(entries);
+    free(slots);
+    entries = NULL;
+    slots = NULL;
+    entry_count = 0;
+    entry_capacity = 0;
+    slot_mask = 0;
+}
@@ -0,0 +1,19 @@
+// intern.h
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Maps each distinct identifier to a small, stable integer ID (0, 1, 2, ...)
+// so later phases compare and index names as ints instead of strings.
+int         intern(const char* s, size_t len);
+const char* intern_name(int id);
+uint32_t    intern_hash(int id);
+int         intern_count();
+
+void intern_reset();    // forget every name, keep the memory
+void intern_destroy();  // release the table and its strings
+
+#endif
@@ -0,0 +1,387 @@
+// jit.c
+//
+// Encodes TAC directly as x86-64 machine code. Every variable, temp and
+// spill lives in a 32-bit slot addressed off rbx; eax/ecx/edx/edi are scratch.
+// The generated function is
+//
+//     int code(int32_t* slots, void (*print)(int32_t, FILE*), FILE* out)
+//
+// with `print` kept in r12 and `out` in r13 across calls. It returns 0, or
+// 1 after a division by zero. Jumps are emitted with 32-bit displacements
+// and backpatched once every label's offset is known.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "jit.h"
+
+enum { EAX = 0, ECX = 1, EDI = 7 };
+
+// Condition codes for jcc/setcc
+enum { CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+typedef struct {
+    int offset;             // position of the rel32 field
+    int label;
+} Fixup;
+
+typedef struct {
+    uint8_t* code;
+    size_t size;
+    size_t capacity;
+    int* label_offsets;
+    Fixup* fixups;
+    int fixup_count;
+    int fixup_capacity;
+    int exit_offset;        // epilogue that returns eax
+    int var_count;
+    int temp_count;
+} Assembler;
+
+typedef int (*JitFunction)(int32_t* slots, void (*print)(int32_t, FILE*), FILE* out);
+
+static void emit_bytes(Assembler* as, const void* bytes, size_t n) {
+    if (as->size + n > as->capacity) {
+        while (as->size + n > as->capacity) as->capacity *= 2;
+        as->code = realloc(as->code, as->capacity);
+        if (!as->code) {
+            fprintf(stderr, "Out of memory while encoding JIT code\n");
+            exit(1);
+        }
+    }
+    memcpy(as->code + as->size, bytes, n);
+    as->size += n;
+}
+
+static void emit_byte(Assembler* as, uint8_t b) {
+    emit_bytes(as, &b, 1);
+}
+
+static void emit_int32(Assembler* as, int32_t v) {
+    emit_bytes(as, &v, 4);
+}
+
+static int32_t slot_offset(const Assembler* as, TacOperand o) {
+    switch (o.kind) {
+        case OPND_VAR:   return 4 * o.value;
+        case OPND_TEMP:  return 4 * (as->var_count + o.value);
+        case OPND_SPILL: return 4 * (as->var_count + as->temp_count + o.value);
+        default:         return 0;
+    }
+}
+
+// modrm for [rbx + disp32] with `reg` in the reg field
+static void emit_slot(Assembler* as, int reg, TacOperand o) {
+    emit_byte(as, 0x80 | (reg << 3) | 3);
+    emit_int32(as, slot_offset(as, o));
+}
+
+// mov reg, operand
+static void emit_load(Assembler* as, int reg, TacOperand o) {
+    if (o.kind == OPND_IMM) {
+        emit_byte(as, 0xB8 + reg);
+        emit_int32(as, o.value);
+    } else {
+        emit_byte(as, 0x8B);
+        emit_slot(as, reg, o);
+    }
+}
+
+// mov operand, eax
+static void emit_store(Assembler* as, TacOperand o) {
+    emit_byte(as, 0x89);
+    emit_slot(as, EAX, o);
+}
+
+// Arithmetic/compare of eax with an operand: opcode for the immediate form
+// and for the `reg, r/m32` form
+static void emit_alu(Assembler* as, uint8_t imm_op, uint8_t mem_op, TacOperand b) {
+    if (b.kind == OPND_IMM) {
+        emit_byte(as, imm_op);
+        emit_int32(as, b.value);
+    } else {
+        emit_byte(as, mem_op);
+        emit_slot(as, EAX, b);
+    }
+}
+
+static void emit_jump(Assembler* as, int cc, int label) {
+    if (cc < 0) {
+        emit_byte(as, 0xE9);                    // jmp rel32
+    } else {
+        emit_byte(as, 0x0F);
+        emit_byte(as, 0x80 + cc);               // jcc rel32
+    }
+    if (as->fixup_count == as->fixup_capacity) {
+        as->fixup_capacity = as->fixup_capacity ? as->fixup_capacity * 2 : 64;
+        as->fixups = realloc(as->fixups, as->fixup_capacity * sizeof(Fixup));
+        if (!as->fixups) {
+            fprintf(stderr, "Out of memory while encoding JIT code\n");
+            exit(1);
+        }
+    }
+    as->fixups[as->fixup_count].offset = (int)as->size;
+    as->fixups[as->fixup_count].label = label;
+    as->fixup_count++;
+    emit_int32(as, 0);
+}
+
+static void patch(Assembler* as, int at, int target) {
+    int32_t rel = target - (at + 4);
+    memcpy(as->code + at, &rel, 4);
+}
+
+static int condition(TacOp op) {
+    switch (op) {
+        case TAC_EQ: case TAC_IF_EQ: return CC_E;
+        case TAC_NE: case TAC_IF_NE: return CC_NE;
+        case TAC_LT: case TAC_IF_LT: return CC_L;
+        case TAC_LE: case TAC_IF_LE: return CC_LE;
+        case TAC_GT: case TAC_IF_GT: return CC_G;
+        case TAC_GE: case TAC_IF_GE: return CC_GE;
+        default:                     return CC_E;
+    }
+}
+
+static void encode_instruction(Assembler* as, const TACInstruction* ins, int* div_zero_fixups, int* div_zero_count) {
+    TacOperand dst = tac_dst(ins), a = tac_a(ins), b = tac_b(ins);
+
+    switch ((TacOp)ins->op) {
+        case TAC_COPY:
+            emit_load(as, EAX, a);
+            emit_store(as, dst);
+            break;
+
+        case TAC_ADD:
+            emit_load(as, EAX, a);
+            emit_alu(as, 0x05, 0x03, b);        // add eax, imm32 / r/m32
+            emit_store(as, dst);
+            break;
+
+        case TAC_SUB:
+            emit_load(as, EAX, a);
+            emit_alu(as, 0x2D, 0x2B, b);        // sub eax, imm32 / r/m32
+            emit_store(as, dst);
+            break;
+
+        case TAC_MUL:
+            emit_load(as, EAX, a);
+            if (b.kind == OPND_IMM) {
+                emit_bytes(as, "\x69\xC0", 2);  // imul eax, eax, imm32
+                emit_int32(as, b.value);
+            } else {
+                emit_bytes(as, "\x0F\xAF", 2);  // imul eax, r/m32
+                emit_slot(as, EAX, b);
+            }
+            emit_store(as, dst);
+            break;
+
+        case TAC_DIV:
+            emit_load(as, EAX, a);
+            emit_load(as, ECX, b);
+            emit_bytes(as, "\x85\xC9", 2);      // test ecx, ecx
+            emit_bytes(as, "\x0F\x84", 2);      // je <division by zero>
+            div_zero_fixups[(*div_zero_count)++] = (int)as->size;
+            emit_int32(as, 0);
+            // INT_MIN / -1 traps in idiv; wrap it like the VM does
+            emit_bytes(as, "\x83\xF9\xFF", 3);  // cmp ecx, -1
+            emit_bytes(as, "\x75\x04", 2);      // jne +4
+            emit_bytes(as, "\xF7\xD8", 2);      // neg eax
+            emit_bytes(as, "\xEB\x03", 2);      // jmp +3
+            emit_byte(as, 0x99);                // cdq
+            emit_bytes(as, "\xF7\xF9", 2);      // idiv ecx
+            emit_store(as, dst);
+            break;
+
+        case TAC_EQ:
+        case TAC_NE:
+        case TAC_LT:
+        case TAC_LE:
+        case TAC_GT:
+        case TAC_GE:
+            emit_load(as, EAX, a);
+            emit_alu(as, 0x3D, 0x3B, b);        // cmp eax, imm32 / r/m32
+            emit_byte(as, 0x0F);
+            emit_byte(as, 0x90 + condition((TacOp)ins->op));
+            emit_byte(as, 0xC0);                // setcc al
+            emit_bytes(as, "\x0F\xB6\xC0", 3);  // movzx eax, al
+            emit_store(as, dst);
+            break;
+
+        case TAC_IF_EQ:
+        case TAC_IF_NE:
+        case TAC_IF_LT:
+        case TAC_IF_LE:
+        case TAC_IF_GT:
+        case TAC_IF_GE:
+            emit_load(as, EAX, a);
+            emit_alu(as, 0x3D, 0x3B, b);
+            emit_jump(as, condition((TacOp)ins->op), ins->dst);
+            break;
+
+        case TAC_IFGOTO:
+            emit_load(as, EAX, a);
+            emit_bytes(as, "\x85\xC0", 2);      // test eax, eax
+            emit_jump(as, CC_NE, ins->dst);
+            break;
+
+        case TAC_GOTO:
+            emit_jump(as, -1, ins->dst);
+            break;
+
+        case TAC_LABEL:
+            as->label_offsets[ins->dst] = (int)as->size;
+            break;
+
+        case TAC_PRINT:
+            emit_load(as, EDI, a);
+            emit_bytes(as, "\x4C\x89\xEE", 3);  // mov rsi, r13
+            emit_bytes(as, "\x41\xFF\xD4", 3);  // call r12
+            break;
+
+        case TAC_SHL:
+            emit_load(as, EAX, a);
+            if (b.kind == OPND_IMM) {
+                emit_bytes(as, "\xC1\xE0", 2);  // shl eax, imm8
+                emit_byte(as, (uint8_t)(b.value & 31));
+            } else {
+                emit_load(as, ECX, b);
+                emit_bytes(as, "\xD3\xE0", 2);  // shl eax, cl
+            }
+            emit_store(as, dst);
+            break;
+
+        case TAC_SHR:
+            // Adds 2^n - 1 to a negative value first, so sar truncates
+            // toward zero like the division it replaces
+            emit_load(as, EAX, a);
+            emit_byte(as, 0x99);                // cdq
+            if (b.kind == OPND_IMM) {
+                int shift = b.value & 31;
+                emit_bytes(as, "\x81\xE2", 2);  // and edx, imm32
+                emit_int32(as, shift ? (int32_t)((1u << shift) - 1) : 0);
+                emit_bytes(as, "\x01\xD0", 2);  // add eax, edx
+                emit_bytes(as, "\xC1\xF8", 2);  // sar eax, imm8
+                emit_byte(as, (uint8_t)shift);
+            } else {
+                emit_load(as, ECX, b);
+                emit_load(as, EDI, tac_imm(-1));
+                emit_bytes(as, "\xD3\xE7", 2);  // shl edi, cl
+                emit_bytes(as, "\xF7\xD7", 2);  // not edi
+                emit_bytes(as, "\x21\xFA", 2);  // and edx, edi
+                emit_bytes(as, "\x01\xD0", 2);  // add eax, edx
+                emit_bytes(as, "\xD3\xF8", 2);  // sar eax, cl
+            }
+            emit_store(as, dst);
+            break;
+    }
+}
+
+static void encode(const TacProgram* prog, Assembler* as) {
+    as->capacity = 4096;
+    as->size = 0;
+    as->code = malloc(as->capacity);
+    as->label_offsets = calloc(prog->label_count > 0 ? prog->label_count : 1, sizeof(int));
+    as->fixups = NULL;
+    as->fixup_count = as->fixup_capacity = 0;
+    as->var_count = prog->var_count;
+    as->temp_count = prog->temp_count;
+
+    int div_count = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (prog->code[i].op == TAC_DIV) div_count++;
+    }
+    int* div_zero_fixups = malloc((div_count > 0 ? div_count : 1) * sizeof(int));
+    if (!as->code || !as->label_offsets || !div_zero_fixups) {
+        fprintf(stderr, "Out of memory while encoding JIT code\n");
+        exit(1);
+    }
+    div_count = 0;
+
+    // push rbx; push r12; push r13 (leaves rsp 16-byte aligned for calls)
+    emit_bytes(as, "\x53\x41\x54\x41\x55", 5);
+    emit_bytes(as, "\x48\x89\xFB", 3);          // mov rbx, rdi
+    emit_bytes(as, "\x49\x89\xF4", 3);          // mov r12, rsi
+    emit_bytes(as, "\x49\x89\xD5", 3);          // mov r13, rdx
+
+    for (int i = 0; i < prog->count; i++) {
+        encode_instruction(as, &prog->code[i], div_zero_fixups, &div_count);
+    }
+
+    emit_bytes(as, "\x31\xC0", 2);              // xor eax, eax
+    emit_bytes(as, "\xEB\x05", 2);              // jmp exit
+    int div_zero = (int)as->size;
+    emit_byte(as, 0xB8);                        // mov eax, 1
+    emit_int32(as, 1);
+    as->exit_offset = (int)as->size;
+    emit_bytes(as, "\x41\x5D\x41\x5C\x5B\xC3", 6);  // pop r13; pop r12; pop rbx; ret
+
+    for (int i = 0; i < as->fixup_count; i++) {
+        patch(as, as->fixups[i].offset, as->label_offsets[as->fixups[i].label]);
+    }
+    for (int i = 0; i < div_count; i++) {
+        patch(as, div_zero_fixups[i], div_zero);
+    }
+    free(div_zero_fixups);
+}
+
+static void jit_print(int32_t value, FILE* out) {
+    if (out) fprintf(out, "%d\n", value);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int jit_run(const TacProgram* prog, FILE* out, JitStats* stats) {
+    double start = now_seconds();
+
+    Assembler as;
+    encode(prog, &as);
+
+    // Written while read/write, then flipped to read/execute before running
+    void* code = mmap(NULL, as.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    memcpy(code, as.code, as.size);
+    if (mprotect(code, as.size, PROT_READ | PROT_EXEC) != 0) {
+        perror("mprotect");
+        exit(1);
+    }
+
+    size_t slot_count = (size_t)prog->var_count + prog->temp_count + prog->spill_count;
+    int32_t* slots = calloc(slot_count > 0 ? slot_count : 1, sizeof(int32_t));
+    if (!slots) {
+        fprintf(stderr, "Out of memory while allocating JIT slots\n");
+        exit(1);
+    }
+    double compiled = now_seconds();
+
+    JitFunction function = (JitFunction)code;
+    int result = function(slots, jit_print, out);
+    double finished = now_seconds();
+
+    if (result != 0) {
+        if (out) fflush(out);
+        fprintf(stderr, "Runtime error: division by zero\n");
+    }
+    if (stats) {
+        stats->code_bytes = as.size;
+        stats->compile_seconds = compiled - start;
+        stats->run_seconds = finished - compiled;
+    }
+
+    munmap(code, as.size);
+    free(slots);
+    free(as.code);
+    free(as.label_offsets);
+    free(as.fixups);
+    return result;
+}
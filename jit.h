@@ -0,0 +1,21 @@
+// jit.h
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "tac.h"
+
+typedef struct {
+    size_t code_bytes;      // machine code generated
+    double compile_seconds; // encoding, mapping and protecting the code
+    double run_seconds;     // time spent inside the generated code
+} JitStats;
+
+// Encodes the TAC as x86-64 machine code in a W^X mapping and calls it.
+// `print` output goes to `out` (NULL discards it). Returns 0 on success,
+// 1 on a runtime error.
+int jit_run(const TacProgram* prog, FILE* out, JitStats* stats);
+
+#endif
@@ -0,0 +1,629 @@
+// loop.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "loop.h"
+#include "ssa.h"
+
+static void* checked_calloc(size_t count, size_t size) {
+    void* ptr = calloc(count ? count : 1, size);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed for loop optimization\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static void* checked_realloc(void* ptr, size_t size) {
+    void* p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for loop optimization\n");
+        exit(1);
+    }
+    return p;
+}
+
+// A node of the loop forest. Loops are numbered in the order find_loops
+// discovers them, inner before outer; `first` and `last` number the forest
+// in preorder, so loop m is inside loop l exactly when
+// l.first <= m.first <= l.last.
+typedef struct {
+    int header;
+    int parent;             // innermost enclosing loop, -1 at the top level
+    int depth;              // 1 for a loop no other loop contains
+    int first;
+    int last;
+    int size;               // blocks, counting those of the loops inside
+    int has_preheader;
+} Loop;
+
+// An instruction to place at `key`: 2 * i is before instruction i,
+// 2 * i + 1 after it; `seq` keeps insertions at one key in order.
+typedef struct {
+    int key;
+    int seq;
+    TACInstruction ins;
+} Insertion;
+
+// A temp kept equal to induction variable * factor
+typedef struct {
+    int phi_value;
+    int32_t factor;
+    TacOperand temp;
+} Reduction;
+
+typedef struct {
+    TacProgram* prog;
+    SsaForm ssa;
+    int* pre;               // preorder and postorder numbers in the dominator tree
+    int* post;
+
+    Loop* loops;
+    int loop_count;
+    int* inner;             // block -> innermost loop containing it, or -1
+
+    int* hoisted;           // instruction -> 1 + loop it was hoisted out of, or 0
+    int* reduced;           // instruction replaced by a copy of a reduction temp
+    int* temp_defs;
+    int* def_start;         // in-loop definitions of variable v, as the `first`
+    int* def_keys;          // of their innermost loop: def_keys[def_start[v] .. def_start[v + 1]), ascending
+
+    Insertion* inserts;
+    int insert_count;
+    int insert_capacity;
+} LoopState;
+
+static void insert(LoopState* s, int key, TACInstruction ins) {
+    if (s->insert_count == s->insert_capacity) {
+        s->insert_capacity = s->insert_capacity ? s->insert_capacity * 2 : 64;
+        s->inserts = checked_realloc(s->inserts, sizeof(Insertion) * s->insert_capacity);
+    }
+    Insertion* at = &s->inserts[s->insert_count];
+    at->key = key;
+    at->seq = s->insert_count++;
+    at->ins = ins;
+}
+
+static int compare_insertions(const void* x, const void* y) {
+    const Insertion* a = x;
+    const Insertion* b = y;
+    if (a->key != b->key) return a->key < b->key ? -1 : 1;
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+// Numbers the dominator tree so that a dominates b exactly when b's
+// numbers fall inside a's
+static void number_dominator_tree(LoopState* s) {
+    SsaForm* ssa = &s->ssa;
+    int n = ssa->cfg.count;
+    int* child_start = checked_calloc(n + 1, sizeof(int));
+    for (int b = 0; b < n; b++) {
+        if (ssa->idom[b] >= 0) child_start[ssa->idom[b] + 1]++;
+    }
+    for (int b = 0; b < n; b++) child_start[b + 1] += child_start[b];
+    int* children = checked_calloc(child_start[n], sizeof(int));
+    int* fill = checked_calloc(n, sizeof(int));
+    for (int b = 0; b < n; b++) {
+        int parent = ssa->idom[b];
+        if (parent >= 0) children[child_start[parent] + fill[parent]++] = b;
+    }
+
+    s->pre = checked_calloc(n, sizeof(int));
+    s->post = checked_calloc(n, sizeof(int));
+    for (int b = 0; b < n; b++) s->pre[b] = s->post[b] = -1;
+    int* stack = checked_calloc(n, sizeof(int));
+    int top = 0, clock = 0;
+    if (ssa->rpo_count > 0) {
+        stack[top++] = 0;
+        s->pre[0] = clock++;
+    }
+    for (int b = 0; b < n; b++) fill[b] = child_start[b];
+    while (top > 0) {
+        int b = stack[top - 1];
+        if (fill[b] < child_start[b + 1]) {
+            int c = children[fill[b]++];
+            s->pre[c] = clock++;
+            stack[top++] = c;
+        } else {
+            s->post[b] = clock++;
+            top--;
+        }
+    }
+    free(stack);
+    free(fill);
+    free(children);
+    free(child_start);
+}
+
+static int dominates(const LoopState* s, int a, int b) {
+    return s->pre[a] >= 0 && s->pre[b] >= 0 && s->pre[a] <= s->pre[b] && s->post[b] <= s->post[a];
+}
+
+// Whether loop m is l or inside it
+static int contains(const LoopState* s, int l, int m) {
+    return s->loops[l].first <= s->loops[m].first && s->loops[m].first <= s->loops[l].last;
+}
+
+static int in_loop(const LoopState* s, int block, int l) {
+    return s->inner[block] >= 0 && contains(s, l, s->inner[block]);
+}
+
+// Header of the outermost loop found so far that contains b, or b itself
+static int outermost(int* rep, int b) {
+    int root = b;
+    while (rep[root] != root) root = rep[root];
+    while (rep[b] != root) {
+        int next = rep[b];
+        rep[b] = root;
+        b = next;
+    }
+    return root;
+}
+
+// One loop per header: the header plus every block that reaches one of
+// its back edges without passing through it. Headers are taken innermost
+// first (a header inside a loop comes after its header in the dominator
+// tree), and a walk that meets a loop found earlier steps from its header
+// straight to the edges into it, so every block is walked once in all.
+static void find_loops(LoopState* s) {
+    SsaForm* ssa = &s->ssa;
+    int n = ssa->cfg.count;
+    // Preorder numbers share one clock with postorder ones, so they stay below 2n + 2
+    int* at_pre = checked_calloc(2 * n + 2, sizeof(int));
+    for (int i = 0; i < 2 * n + 2; i++) at_pre[i] = -1;
+    for (int b = 0; b < n; b++) {
+        if (s->pre[b] >= 0) at_pre[s->pre[b]] = b;
+    }
+    int* headers = checked_calloc(n, sizeof(int));
+    int header_count = 0;
+    for (int i = 2 * n + 1; i >= 0; i--) {
+        int h = at_pre[i];
+        if (h < 0) continue;
+        for (int k = ssa->pred_start[h]; k < ssa->pred_start[h + 1]; k++) {
+            if (dominates(s, h, ssa->preds[k])) {
+                headers[header_count++] = h;
+                break;
+            }
+        }
+    }
+    free(at_pre);
+
+    s->loops = checked_calloc(header_count, sizeof(Loop));
+    s->inner = checked_calloc(n, sizeof(int));
+    int* rep = checked_calloc(n, sizeof(int));
+    int* loop_at = checked_calloc(n, sizeof(int));      // header -> its loop
+    int* stamp = checked_calloc(n, sizeof(int));
+    int* work = checked_calloc(n, sizeof(int));
+    for (int b = 0; b < n; b++) {
+        s->inner[b] = loop_at[b] = -1;
+        rep[b] = b;
+    }
+
+    for (int l = 0; l < header_count; l++) {
+        int h = headers[l];
+        Loop* loop = &s->loops[l];
+        loop->header = h;
+        loop->parent = -1;
+        s->inner[h] = l;
+        loop_at[h] = l;
+        stamp[h] = l + 1;
+        int top = 0;
+        for (int k = ssa->pred_start[h]; k < ssa->pred_start[h + 1]; k++) {
+            if (dominates(s, h, ssa->preds[k])) work[top++] = ssa->preds[k];
+        }
+        while (top > 0) {
+            int b = outermost(rep, work[--top]);
+            if (stamp[b] == l + 1) continue;
+            stamp[b] = l + 1;
+            rep[b] = h;
+            int inside = loop_at[b];
+            if (inside >= 0) s->loops[inside].parent = l;
+            else s->inner[b] = l;
+            for (int k = ssa->pred_start[b]; k < ssa->pred_start[b + 1]; k++) {
+                int p = ssa->preds[k];
+                if (ssa->idom[p] == SSA_NONE) continue;
+                // A nested loop is entered only through its header
+                if (inside >= 0 && dominates(s, b, p)) continue;
+                work[top++] = p;
+            }
+        }
+    }
+    s->loop_count = header_count;
+
+    // Sizes and descendant counts bottom up: loops were found inner before outer
+    int* descendants = checked_calloc(s->loop_count, sizeof(int));
+    for (int b = 0; b < n; b++) {
+        if (s->inner[b] >= 0) s->loops[s->inner[b]].size++;
+    }
+    for (int l = 0; l < s->loop_count; l++) {
+        int parent = s->loops[l].parent;
+        if (parent < 0) continue;
+        s->loops[parent].size += s->loops[l].size;
+        descendants[parent] += descendants[l] + 1;
+    }
+
+    // Depths and preorder numbers: parents were found after their children
+    int* child_start = checked_calloc(s->loop_count + 2, sizeof(int));
+    for (int l = 0; l < s->loop_count; l++) child_start[s->loops[l].parent + 2]++;
+    for (int l = 0; l <= s->loop_count; l++) child_start[l + 1] += child_start[l];
+    int* children = checked_calloc(s->loop_count, sizeof(int));
+    int* fill = checked_calloc(s->loop_count + 1, sizeof(int));
+    for (int l = 0; l <= s->loop_count; l++) fill[l] = child_start[l];
+    for (int l = 0; l < s->loop_count; l++) children[fill[s->loops[l].parent + 1]++] = l;
+    int clock = 0, top = 0;
+    for (int c = child_start[0]; c < child_start[1]; c++) {
+        work[top++] = children[c];
+        s->loops[children[c]].depth = 1;
+    }
+    while (top > 0) {
+        int l = work[--top];
+        s->loops[l].first = clock++;
+        for (int c = child_start[l + 1]; c < child_start[l + 2]; c++) {
+            work[top++] = children[c];
+            s->loops[children[c]].depth = s->loops[l].depth + 1;
+        }
+    }
+    for (int l = 0; l < s->loop_count; l++) s->loops[l].last = s->loops[l].first + descendants[l];
+
+    free(descendants);
+    free(children);
+    free(fill);
+    free(child_start);
+    free(work);
+    free(stamp);
+    free(loop_at);
+    free(rep);
+    free(headers);
+}
+
+// Hoisted code goes just before the header's label, which only works when
+// the code above the label is the one way into the loop and falls into it.
+static int has_preheader(const LoopState* s, int l) {
+    const SsaForm* ssa = &s->ssa;
+    int h = s->loops[l].header;
+    int outside = -1, outside_count = 0;
+    for (int k = ssa->pred_start[h]; k < ssa->pred_start[h + 1]; k++) {
+        if (in_loop(s, ssa->preds[k], l)) continue;
+        outside = ssa->preds[k];
+        outside_count++;
+    }
+    if (outside_count == 0) return h == 0;
+    if (outside_count > 1 || outside != h - 1) return 0;
+
+    const BasicBlock* above = &ssa->cfg.blocks[h - 1];
+    if (above->end == above->start) return 1;
+    const TACInstruction* last = &s->prog->code[above->end - 1];
+    if (last->op == TAC_GOTO) return 0;
+    return !tac_is_cond_jump((TacOp)last->op) || ssa->cfg.label_block[last->dst] != h;
+}
+
+// Depth of the deepest loop around `l` that an operand may change in: 0
+// when it holds the same value throughout every one of them, INT_MAX when
+// it is not known to hold still anywhere
+static int variant_depth(const LoopState* s, uint8_t kind, int use, int l) {
+    if (kind == OPND_IMM) return 0;
+    if (use < 0) return INT_MAX;
+    int site = s->ssa.value_site[use];
+    if (site == SSA_ENTRY) return 0;
+    int where;
+    if (site < 0) where = s->inner[s->ssa.phi_block[-site - 1]];
+    else if (s->hoisted[site]) where = s->loops[s->hoisted[site] - 1].parent;
+    else where = s->inner[s->ssa.instr_block[site]];
+    // A value from a loop `l` is not in, such as a nested loop's header
+    while (where >= 0 && !contains(s, where, l)) where = s->loops[where].parent;
+    return where < 0 ? 0 : s->loops[where].depth;
+}
+
+// One pass over the code. Each candidate binop leaves for the preheader of
+// the outermost loop around it that it does not change in, which is the
+// loop below the deepest one either operand may change in. `chain` holds
+// the loops around the current block by depth, and `exits` the depths in
+// it whose loops have a preheader.
+static void hoist_invariants(LoopState* s, LoopStats* stats) {
+    const SsaForm* ssa = &s->ssa;
+    int* chain = checked_calloc(s->loop_count + 1, sizeof(int));
+    int* exits = checked_calloc(s->loop_count + 1, sizeof(int));
+    int* path = checked_calloc(s->loop_count + 1, sizeof(int));
+    int depth = 0, exit_count = 0;
+
+    for (int b = 0; b < ssa->cfg.count; b++) {
+        int l = s->inner[b];
+        if (l < 0) continue;
+        while (depth > 0 && !contains(s, chain[depth], l)) {
+            if (exit_count > 0 && exits[exit_count - 1] == depth) exit_count--;
+            depth--;
+        }
+        int steps = 0;
+        for (int m = l; m >= 0 && (depth == 0 || m != chain[depth]); m = s->loops[m].parent) path[steps++] = m;
+        while (steps > 0) {
+            int m = path[--steps];
+            chain[++depth] = m;
+            if (s->loops[m].has_preheader) exits[exit_count++] = depth;
+        }
+
+        const BasicBlock* block = &ssa->cfg.blocks[b];
+        for (int i = block->start; i < block->end; i++) {
+            const TACInstruction* ins = &s->prog->code[i];
+            if (s->reduced[i]) continue;
+            if (!tac_is_binop((TacOp)ins->op) || ins->dst_kind != OPND_TEMP) continue;
+            if (s->temp_defs[ins->dst] != 1) continue;
+            // Hoisted code also runs when the loop does not, so it must not trap
+            if (ins->op == TAC_DIV && (ins->b_kind != OPND_IMM || ins->b == 0 || ins->b == -1)) continue;
+            int below = variant_depth(s, ins->a_kind, ssa->use_a[i], l);
+            int b_depth = variant_depth(s, ins->b_kind, ssa->use_b[i], l);
+            if (b_depth > below) below = b_depth;
+            if (below >= depth) continue;
+
+            // The shallowest loop with a preheader at a depth past `below`
+            int lo = 0, hi = exit_count;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (exits[mid] <= below) lo = mid + 1;
+                else hi = mid;
+            }
+            if (lo == exit_count) continue;
+            int target = chain[exits[lo]];
+            s->hoisted[i] = target + 1;
+            insert(s, 2 * ssa->cfg.blocks[s->loops[target].header].start, *ins);
+            stats->hoisted++;
+        }
+    }
+    free(path);
+    free(exits);
+    free(chain);
+}
+
+// Step of "i = i + c", "i = i - c" or "i = c + i", directly or through a
+// temp, where i reads `phi_value`. Returns 0 if `site` is no such update.
+static int step_of(const LoopState* s, int site, int phi_value, int l, int32_t* step) {
+    const SsaForm* ssa = &s->ssa;
+    const TACInstruction* ins = &s->prog->code[site];
+    if (ins->op == TAC_COPY && ins->a_kind == OPND_TEMP) {
+        int value = ssa->use_a[site];
+        if (value < 0 || ssa->value_site[value] < 0) return 0;
+        site = ssa->value_site[value];
+        if (!in_loop(s, ssa->instr_block[site], l)) return 0;
+        ins = &s->prog->code[site];
+    }
+    if (ins->op == TAC_ADD && ssa->use_a[site] == phi_value && ins->b_kind == OPND_IMM) {
+        *step = ins->b;
+    } else if (ins->op == TAC_ADD && ssa->use_b[site] == phi_value && ins->a_kind == OPND_IMM) {
+        *step = ins->a;
+    } else if (ins->op == TAC_SUB && ssa->use_a[site] == phi_value && ins->b_kind == OPND_IMM) {
+        *step = (int32_t)(0u - (uint32_t)ins->b);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// Definitions of each variable inside some loop, sorted by the preorder
+// number of their innermost loop, so those inside a loop are one range
+static void index_definitions(LoopState* s) {
+    const SsaForm* ssa = &s->ssa;
+    TacProgram* prog = s->prog;
+    int vars = prog->var_count;
+    int* key_start = checked_calloc(s->loop_count + 1, sizeof(int));
+    int count = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (ssa->def[i] < 0 || s->inner[ssa->instr_block[i]] < 0) continue;
+        int name = ssa_name(prog, tac_dst(&prog->code[i]));
+        if (name < 0 || name >= vars) continue;
+        key_start[s->loops[s->inner[ssa->instr_block[i]]].first + 1]++;
+        count++;
+    }
+    for (int k = 0; k < s->loop_count; k++) key_start[k + 1] += key_start[k];
+
+    // Counting sort by key, then a stable one by variable
+    int* by_key = checked_calloc(count, sizeof(int));
+    for (int i = 0; i < prog->count; i++) {
+        if (ssa->def[i] < 0 || s->inner[ssa->instr_block[i]] < 0) continue;
+        int name = ssa_name(prog, tac_dst(&prog->code[i]));
+        if (name < 0 || name >= vars) continue;
+        by_key[key_start[s->loops[s->inner[ssa->instr_block[i]]].first]++] = i;
+    }
+    s->def_start = checked_calloc(vars + 1, sizeof(int));
+    s->def_keys = checked_calloc(count, sizeof(int));
+    for (int k = 0; k < count; k++) s->def_start[ssa_name(prog, tac_dst(&prog->code[by_key[k]])) + 1]++;
+    for (int v = 0; v < vars; v++) s->def_start[v + 1] += s->def_start[v];
+    int* fill = checked_calloc(vars + 1, sizeof(int));
+    for (int v = 0; v < vars; v++) fill[v] = s->def_start[v];
+    for (int k = 0; k < count; k++) {
+        int i = by_key[k];
+        s->def_keys[fill[ssa_name(prog, tac_dst(&prog->code[i]))]++] =
+            s->loops[s->inner[ssa->instr_block[i]]].first;
+    }
+    free(fill);
+    free(by_key);
+    free(key_start);
+}
+
+// Definitions of variable `name` in loop l
+static int definitions_in(const LoopState* s, int name, int l) {
+    const int* keys = s->def_keys;
+    int lo = s->def_start[name], hi = s->def_start[name + 1];
+    int from = lo, to = hi;
+    while (from < to) {
+        int mid = (from + to) / 2;
+        if (keys[mid] < s->loops[l].first) from = mid + 1;
+        else to = mid;
+    }
+    int end = from;
+    to = hi;
+    while (end < to) {
+        int mid = (end + to) / 2;
+        if (keys[mid] <= s->loops[l].last) end = mid + 1;
+        else to = mid;
+    }
+    return end - from;
+}
+
+static void reduce_strength(LoopState* s, int l, LoopStats* stats) {
+    const SsaForm* ssa = &s->ssa;
+    TacProgram* prog = s->prog;
+    int h = s->loops[l].header;
+    int preheader_key = 2 * ssa->cfg.blocks[h].start;
+    Reduction* reductions = NULL;
+    int reduction_count = 0;
+
+    for (int p = ssa->block_phi_start[h]; p < ssa->block_phi_start[h + 1]; p++) {
+        int name = ssa->phi_name[p];
+        if (name >= prog->var_count) continue;
+
+        // Every back edge must bring the same value, set once in the loop
+        int update = SSA_NONE;
+        for (int k = 0; k < ssa->phi_arg_start[p + 1] - ssa->phi_arg_start[p]; k++) {
+            if (!in_loop(s, ssa->preds[ssa->pred_start[h] + k], l)) continue;
+            int arg = ssa->phi_args[ssa->phi_arg_start[p] + k];
+            if (update == SSA_NONE) update = arg;
+            else if (arg != update) update = -2;
+        }
+        if (update < 0 || ssa->value_site[update] < 0) continue;
+        int site = ssa->value_site[update];
+        if (!in_loop(s, ssa->instr_block[site], l)) continue;
+        int32_t step;
+        if (definitions_in(s, name, l) != 1 || !step_of(s, site, ssa->phi_value[p], l, &step)) continue;
+
+        // Only instructions that read the induction variable can use it
+        int value = ssa->phi_value[p];
+        for (int u = ssa->use_start[value]; u < ssa->use_start[value + 1]; u++) {
+            int i = ssa->users[u];
+            if (i < 0 || (u > ssa->use_start[value] && ssa->users[u - 1] == i)) continue;
+            if (!in_loop(s, ssa->instr_block[i], l)) continue;
+            TACInstruction* ins = &prog->code[i];
+            if (s->hoisted[i] || s->reduced[i]) continue;
+            int32_t factor;
+            if (ins->op == TAC_MUL && ssa->use_a[i] == value && ins->b_kind == OPND_IMM) {
+                factor = ins->b;
+            } else if (ins->op == TAC_MUL && ssa->use_b[i] == value && ins->a_kind == OPND_IMM) {
+                factor = ins->a;
+            } else if (ins->op == TAC_SHL && ssa->use_a[i] == value && ins->b_kind == OPND_IMM) {
+                factor = (int32_t)(1u << (ins->b & 31));
+            } else {
+                continue;
+            }
+
+            Reduction* r = NULL;
+            for (int j = 0; j < reduction_count; j++) {
+                if (reductions[j].phi_value == value && reductions[j].factor == factor) {
+                    r = &reductions[j];
+                }
+            }
+            if (!r) {
+                reductions = checked_realloc(reductions, sizeof(Reduction) * (reduction_count + 1));
+                r = &reductions[reduction_count++];
+                r->phi_value = value;
+                r->factor = factor;
+                r->temp = tac_new_temp(prog);
+
+                // temp = i * factor on the way in, temp += step * factor after each step
+                TACInstruction init = { TAC_MUL, OPND_TEMP, OPND_VAR, OPND_IMM, r->temp.value, name, factor };
+                insert(s, preheader_key, init);
+                int32_t delta = (int32_t)((uint32_t)step * (uint32_t)factor);
+                TACInstruction add = { TAC_ADD, OPND_TEMP, OPND_TEMP, OPND_IMM,
+                                       r->temp.value, r->temp.value, delta };
+                insert(s, 2 * site + 1, add);
+            }
+            s->reduced[i] = 1;
+            ins->op = TAC_COPY;
+            ins->a_kind = OPND_TEMP;
+            ins->a = r->temp.value;
+            ins->b_kind = OPND_NONE;
+            ins->b = 0;
+            stats->reduced++;
+        }
+    }
+    free(reductions);
+}
+
+// Reductions run outer loops first
+typedef struct {
+    int size;
+    int header;
+    int loop;
+} LoopOrder;
+
+static int compare_loops_by_size(const void* x, const void* y) {
+    const LoopOrder* a = x;
+    const LoopOrder* b = y;
+    if (a->size != b->size) return a->size > b->size ? -1 : 1;
+    return a->header < b->header ? -1 : a->header > b->header;
+}
+
+void loop_optimize(TacProgram* prog, LoopStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->before = prog->count;
+
+    LoopState s;
+    memset(&s, 0, sizeof(s));
+    s.prog = prog;
+    ssa_build(prog, &s.ssa);
+    number_dominator_tree(&s);
+    find_loops(&s);
+    stats->loops = s.loop_count;
+
+    if (s.loop_count > 0) {
+        s.hoisted = checked_calloc(prog->count, sizeof(int));
+        s.reduced = checked_calloc(prog->count, sizeof(int));
+        s.temp_defs = checked_calloc(prog->temp_count, sizeof(int));
+        for (int i = 0; i < prog->count; i++) {
+            TacOp op = (TacOp)prog->code[i].op;
+            if ((op == TAC_COPY || tac_is_binop(op)) && prog->code[i].dst_kind == OPND_TEMP) {
+                s.temp_defs[prog->code[i].dst]++;
+            }
+        }
+        for (int l = 0; l < s.loop_count; l++) s.loops[l].has_preheader = has_preheader(&s, l);
+        index_definitions(&s);
+
+        // A multiplication by a loop's induction variable reads it, so no
+        // loop it could be hoisted out of is around that one: reducing
+        // first leaves hoisting the instructions that are left
+        LoopOrder* order = checked_calloc(s.loop_count, sizeof(LoopOrder));
+        for (int l = 0; l < s.loop_count; l++) {
+            order[l] = (LoopOrder){ s.loops[l].size, s.loops[l].header, l };
+        }
+        qsort(order, s.loop_count, sizeof(LoopOrder), compare_loops_by_size);
+        for (int k = 0; k < s.loop_count; k++) {
+            if (s.loops[order[k].loop].has_preheader) reduce_strength(&s, order[k].loop, stats);
+        }
+        free(order);
+        int reduction_inserts = s.insert_count;
+        hoist_invariants(&s, stats);
+        // At a preheader, hoisted code still comes before the reduction temps
+        for (int k = 0; k < reduction_inserts; k++) s.inserts[k].seq += s.insert_count;
+
+        if (s.insert_count > 0) {
+            qsort(s.inserts, s.insert_count, sizeof(Insertion), compare_insertions);
+            int kept = 0;
+            for (int i = 0; i < prog->count; i++) kept += !s.hoisted[i];
+            TACInstruction* code = checked_calloc(kept + s.insert_count, sizeof(TACInstruction));
+            int out = 0, next = 0;
+            for (int i = 0; i < prog->count; i++) {
+                while (next < s.insert_count && s.inserts[next].key == 2 * i) code[out++] = s.inserts[next++].ins;
+                if (!s.hoisted[i]) code[out++] = prog->code[i];
+                while (next < s.insert_count && s.inserts[next].key == 2 * i + 1) code[out++] = s.inserts[next++].ins;
+            }
+            free(prog->code);
+            prog->code = code;
+            prog->count = out;
+            prog->capacity = kept + s.insert_count;
+        }
+
+        free(s.hoisted);
+        free(s.reduced);
+        free(s.temp_defs);
+        free(s.def_start);
+        free(s.def_keys);
+        free(s.inserts);
+    }
+
+    free(s.pre);
+    free(s.post);
+    free(s.loops);
+    free(s.inner);
+    ssa_free(&s.ssa);
+    stats->after = prog->count;
+}
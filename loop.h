@@ -0,0 +1,24 @@
+// loop.h
+
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "tac.h"
+
+typedef struct {
+    int before;     // instruction count going in
+    int after;      // instruction count coming out
+    int loops;      // natural loops found
+    int hoisted;    // binops moved out to a loop's preheader
+    int reduced;    // multiplications by an induction variable turned into additions
+} LoopStats;
+
+// Natural loops are found from back edges in the SSA form's dominator
+// tree. A binop whose operands do not change inside a loop is computed
+// once before it instead, and "t = i * k", where the variable i only
+// changes by a constant step in the loop, reads a temp kept equal to
+// i * k by an addition next to the step. Runs after value numbering, on
+// temps that are still defined once.
+void loop_optimize(TacProgram* prog, LoopStats* stats);
+
+#endif
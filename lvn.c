@@ -0,0 +1,245 @@
+// lvn.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "lvn.h"
+#include "cfg.h"
+
+// A value is either a value number (1, 2, ...) or a constant tagged with
+// the top bit, so equal constants are equal values without a lookup.
+typedef uint64_t Value;
+#define CONST_VALUE(v) ((1ull << 63) | (uint32_t)(v))
+
+typedef struct {
+    int stamp;      // block that wrote this entry
+    Value value;
+} Binding;
+
+typedef struct {
+    int stamp;
+    uint8_t op;
+    Value left;
+    Value right;
+    Value result;
+} ExprSlot;
+
+static _Thread_local Binding* var_binding;
+static _Thread_local Binding* temp_binding;
+static _Thread_local TacOperand* temp_alias;  // OPND_NONE unless the temp was eliminated
+static _Thread_local int* temp_alias_stamp;
+static _Thread_local int* temp_block;         // block defining the temp, -1 if used elsewhere
+
+static _Thread_local TacOperand* home;        // value number -> an operand holding it
+static _Thread_local Value home_capacity;
+static _Thread_local Value next_value;
+
+static _Thread_local ExprSlot* exprs;
+static _Thread_local uint32_t expr_mask;
+static _Thread_local int stamp;
+
+static void* checked_calloc(size_t count, size_t size) {
+    void* ptr = calloc(count ? count : 1, size);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed for value numbering\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static Value fresh_value(TacOperand holder) {
+    Value v = next_value++;
+    if (v >= home_capacity) {
+        home_capacity *= 2;
+        home = realloc(home, sizeof(TacOperand) * home_capacity);
+        if (!home) {
+            fprintf(stderr, "Memory allocation failed for value numbering\n");
+            exit(1);
+        }
+    }
+    home[v] = holder;
+    return v;
+}
+
+static Binding* binding_of(TacOperand o) {
+    if (o.kind == OPND_VAR) return &var_binding[o.value];
+    if (o.kind == OPND_TEMP) return &temp_binding[o.value];
+    return NULL;
+}
+
+// Value currently held by an operand; a variable first read in this block
+// gets a new value number.
+static Value value_of(TacOperand o) {
+    if (o.kind == OPND_IMM) return CONST_VALUE(o.value);
+    Binding* b = binding_of(o);
+    if (!b) return 0;
+    if (b->stamp != stamp) {
+        b->stamp = stamp;
+        b->value = fresh_value(o);
+    }
+    return b->value;
+}
+
+static void bind(TacOperand o, Value v) {
+    Binding* b = binding_of(o);
+    if (!b) return;
+    b->stamp = stamp;
+    b->value = v;
+}
+
+// An operand that holds `v` right now, preferring its recorded home
+static int holder_of(Value v, TacOperand* out) {
+    if (v & (1ull << 63)) {
+        *out = tac_imm((int32_t)(uint32_t)v);
+        return 1;
+    }
+    TacOperand h = home[v];
+    Binding* b = binding_of(h);
+    if (b && b->stamp == stamp && b->value == v) {
+        *out = h;
+        return 1;
+    }
+    return 0;
+}
+
+static TacOperand resolve(TacOperand o) {
+    if (o.kind == OPND_TEMP && temp_alias_stamp[o.value] == stamp) return temp_alias[o.value];
+    return o;
+}
+
+static int is_commutative(uint8_t op) {
+    return op == TAC_ADD || op == TAC_MUL || op == TAC_EQ || op == TAC_NE;
+}
+
+// a < b is b > a, a <= b is b >= a
+static uint8_t mirrored(uint8_t op) {
+    switch (op) {
+        case TAC_LT: return TAC_GT;
+        case TAC_GT: return TAC_LT;
+        case TAC_LE: return TAC_GE;
+        case TAC_GE: return TAC_LE;
+    }
+    return op;
+}
+
+static ExprSlot* find_expr(uint8_t op, Value left, Value right) {
+    uint64_t h = (left * 0x9E3779B97F4A7C15ull) ^ (right * 0xC2B2AE3D27D4EB4Full) ^ op;
+    uint32_t i = (uint32_t)(h ^ (h >> 32)) & expr_mask;
+    while (exprs[i].stamp == stamp) {
+        ExprSlot* e = &exprs[i];
+        if (e->op == op && e->left == left && e->right == right) return e;
+        i = (i + 1) & expr_mask;
+    }
+    exprs[i].op = op;
+    exprs[i].left = left;
+    exprs[i].right = right;
+    exprs[i].result = 0;
+    exprs[i].stamp = stamp;
+    return &exprs[i];
+}
+
+// Marks temps that are used outside their defining block; those are never
+// eliminated because uses in other blocks would not be rewritten.
+static void find_local_temps(const TacProgram* prog, const BlockList* blocks) {
+    for (int t = 0; t < prog->temp_count; t++) temp_block[t] = -2;
+    for (int b = 0; b < blocks->count; b++) {
+        for (int i = blocks->blocks[b].start; i < blocks->blocks[b].end; i++) {
+            const TACInstruction* ins = &prog->code[i];
+            if (ins->dst_kind == OPND_TEMP && temp_block[ins->dst] == -2) temp_block[ins->dst] = b;
+            if (ins->a_kind == OPND_TEMP && temp_block[ins->a] != b) temp_block[ins->a] = -1;
+            if (ins->b_kind == OPND_TEMP && temp_block[ins->b] != b) temp_block[ins->b] = -1;
+        }
+    }
+}
+
+void lvn_optimize(TacProgram* prog, LvnStats* stats) {
+    stats->before = prog->count;
+    stats->reused = 0;
+
+    BlockList blocks;
+    split_blocks(prog, &blocks);
+
+    int longest = 1;
+    for (int b = 0; b < blocks.count; b++) {
+        int len = blocks.blocks[b].end - blocks.blocks[b].start;
+        if (len > longest) longest = len;
+    }
+    uint32_t size = 16;
+    while (size < (uint32_t)longest * 2) size *= 2;
+    exprs = checked_calloc(size, sizeof(ExprSlot));
+    expr_mask = size - 1;
+
+    var_binding = checked_calloc(prog->var_count, sizeof(Binding));
+    temp_binding = checked_calloc(prog->temp_count, sizeof(Binding));
+    temp_alias = checked_calloc(prog->temp_count, sizeof(TacOperand));
+    temp_alias_stamp = checked_calloc(prog->temp_count, sizeof(int));
+    temp_block = checked_calloc(prog->temp_count, sizeof(int));
+    home_capacity = 1024;
+    home = checked_calloc(home_capacity, sizeof(TacOperand));
+    next_value = 1;
+    find_local_temps(prog, &blocks);
+
+    int out = 0;
+    for (int b = 0; b < blocks.count; b++) {
+        stamp = b + 1;
+        for (int i = blocks.blocks[b].start; i < blocks.blocks[b].end; i++) {
+            TACInstruction ins = prog->code[i];
+            TacOperand a = resolve(tac_a(&ins));
+            TacOperand bo = resolve(tac_b(&ins));
+            TacOperand dst = tac_dst(&ins);
+            ins.a_kind = a.kind;
+            ins.a = a.value;
+            ins.b_kind = bo.kind;
+            ins.b = bo.value;
+
+            if (ins.op == TAC_COPY) {
+                bind(dst, value_of(a));
+            } else if (tac_is_binop((TacOp)ins.op)) {
+                uint8_t op = ins.op;
+                Value left = value_of(a);
+                Value right = value_of(bo);
+                if (is_commutative(op) && left > right) {
+                    Value tmp = left; left = right; right = tmp;
+                } else if (mirrored(op) != op && left > right) {
+                    Value tmp = left; left = right; right = tmp;
+                    op = mirrored(op);
+                }
+
+                ExprSlot* e = find_expr(op, left, right);
+                TacOperand holder;
+                if (e->result && holder_of(e->result, &holder)) {
+                    stats->reused++;
+                    bind(dst, e->result);
+                    if (dst.kind == OPND_TEMP && temp_block[dst.value] == b && holder.kind != OPND_VAR) {
+                        // Later uses in this block read the earlier result directly
+                        temp_alias[dst.value] = holder;
+                        temp_alias_stamp[dst.value] = stamp;
+                        continue;
+                    }
+                    ins.op = TAC_COPY;
+                    ins.a_kind = holder.kind;
+                    ins.a = holder.value;
+                    ins.b_kind = OPND_NONE;
+                    ins.b = 0;
+                } else {
+                    Value v = fresh_value(dst);
+                    e->result = v;
+                    bind(dst, v);
+                }
+            }
+            prog->code[out++] = ins;
+        }
+    }
+    prog->count = out;
+    stats->after = out;
+
+    free(exprs);
+    free(var_binding);
+    free(temp_binding);
+    free(temp_alias);
+    free(temp_alias_stamp);
+    free(temp_block);
+    free(home);
+    free_blocks(&blocks);
+}
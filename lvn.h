@@ -0,0 +1,16 @@
+#ifndef LVN_H
+#define LVN_H
+
+#include "tac.h"
+
+typedef struct {
+    int before;     // instruction count going in
+    int after;      // instruction count coming out
+    int reused;     // binops replaced by an earlier result
+} LvnStats;
+
+// Local value numbering: inside each basic block, a binop whose operands
+// still hold the same values as an earlier binop reuses that result.
+void lvn_optimize(TacProgram* prog, LvnStats* stats);
+
+#endif
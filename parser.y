@@ -3,27 +3,61 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "ast.h"
 #include "semantic.h"
 #include "codegen.h"
-ASTNode* root = NULL;
-int yylex(void);
-void yyerror(const char *s);
-extern FILE *yyin;
-extern int yylineno;
-extern int print_tokens; // Add reference to print_tokens flag
-int syntax_errors = 0;  // Add a counter for syntax errors
+#include "intern.h"
+#include "vm.h"
+#include "fold.h"
+#include "peephole.h"
+#include "sccp.h"
+#include "lvn.h"
+#include "loop.h"
+#include "cfg.h"
+#include "regalloc.h"
+#include "x86.h"
+#include "jit.h"
+#include "context.h"
+#include "batch.h"
+#include "cache.h"
+#include "trace.h"
+#include "stats.h"
+#include "tacbin.h"
+#include "server.h"
+#include "scanner.h"
+
+// Every AST walk runs on a heap stack, so let the parser stack grow far
+// past bison's default 10000 entries for deeply nested programs.
+#define YYMAXDEPTH 10000000
 %}
 
+%code requires {
+#include "ast.h"
+#include "context.h"
+}
+
+%define api.pure full
+%param {void* scanner}
+%parse-param {CompileContext* ctx}
+
 %union {
-    char* sval;
+    int id;     // interned identifier
+    BinOp op;
     int ival;
     struct ASTNode* node;
 }
 
-%token <sval> IDENTIFIER COMPARISON_OPERATOR ASSIGNMENT_OPERATOR
-%token <sval> PLUS MINUS TIMES DIVIDE
-%token IF ELSE PRINT INT_KEYWORD
+%code {
+int yylex(YYSTYPE* lvalp, void* scanner);
+void yyerror(void* scanner, CompileContext* ctx, const char *s);
+}
+
+%token <id> IDENTIFIER
+%token <op> COMPARISON_OPERATOR
+%token ASSIGNMENT_OPERATOR
+%token PLUS MINUS TIMES DIVIDE
+%token IF ELSE WHILE PRINT INT_KEYWORD
 %token <ival> BOOLEAN_LITERAL
 %token BOOL_KEYWORD
 %token LEFT_PAREN RIGHT_PAREN LEFT_BRACE RIGHT_BRACE SEMICOLON
@@ -36,8 +70,7 @@ int syntax_errors = 0;  // Add a counter for syntax errors
 
 %%
 program:
-    statement_list                     { extern ASTNode* root;
-        root = $1; }
+    statement_list                     { ctx->root = $1; }
 ;
 
 statement_list:
@@ -53,6 +86,8 @@ statement:
                                       { $$ = make_if_node($3, $6, $10); }
     | IF LEFT_PAREN comparison RIGHT_PAREN LEFT_BRACE statement_list RIGHT_BRACE
                                       { $$ = make_if_node($3, $6, NULL); }
+    | WHILE LEFT_PAREN comparison RIGHT_PAREN LEFT_BRACE statement_list RIGHT_BRACE
+                                      { $$ = make_while_node($3, $6); }
 ;
 
 declaration:
@@ -76,44 +111,355 @@ expression:
       CONSTANT                        { $$ = make_int_node($1); }
     | BOOLEAN_LITERAL                 { $$ = make_bool_node($1); }
     | IDENTIFIER                      { $$ = make_var_node($1); }
-    | expression PLUS expression      { $$ = make_binop_node("+", $1, $3); }
-    | expression MINUS expression     { $$ = make_binop_node("-", $1, $3); }
-    | expression TIMES expression     { $$ = make_binop_node("*", $1, $3); }
-    | expression DIVIDE expression    { $$ = make_binop_node("/", $1, $3); }
+    | expression PLUS expression      { $$ = make_binop_node(OP_ADD, $1, $3); }
+    | expression MINUS expression     { $$ = make_binop_node(OP_SUB, $1, $3); }
+    | expression TIMES expression     { $$ = make_binop_node(OP_MUL, $1, $3); }
+    | expression DIVIDE expression    { $$ = make_binop_node(OP_DIV, $1, $3);
+                                        $$->binop.line = scanner_line(scanner); }
     | LEFT_PAREN expression RIGHT_PAREN
                                       { $$ = $2; }
 ;
 %%
 
-void yyerror(const char *s) {
-    fprintf(stderr, "Syntax Error: %s at line %d\n", s, yylineno);
-    syntax_errors++; // Increment the error counter
+void yyerror(void* scanner, CompileContext* ctx, const char *s) {
+    fprintf(diag_stream(), "Syntax Error: %s at line %d\n", s, scanner_line(scanner));
+    ctx->syntax_errors++; // Increment the error counter
+}
+
+// Tools that link the compiler as a library (bench.c) build with -DNO_COMPILER_MAIN
+#ifndef NO_COMPILER_MAIN
+static void print_cache_stats(const char* label, const CacheStats* stats) {
+    printf("%s: %lld hits, %lld misses, %lld stores, %lld evictions\n", label,
+           stats->hits, stats->misses, stats->stores, stats->evictions);
+}
+
+static void print_peephole_stats(const char* label, const PeepholeStats* stats) {
+    printf("%s: %d -> %d instructions in %d passes (", label, stats->before, stats->after, stats->passes);
+    for (int r = 0; r < PEEP_RULE_COUNT; r++) {
+        printf("%s%s %d", r ? ", " : "", peephole_rule_name((PeepholeRule)r), stats->hits[r]);
+    }
+    printf(")\n");
+}
+
+// How main narrates batch_compile_tree: section headers as phases start,
+// dumps and fold counts as they end, and --stats timing for each
+typedef struct {
+    const char* phase;          // the one running, NULL before the first
+    int dump_ast;
+    int dump_symbols;
+    const FlatAst* flat;        // NULL unless --flat
+    const PassStats* stats;
+} Narration;
+
+static void finish_phase(Narration* n) {
+    const char* done = n->phase;
+    if (!done) return;
+    stats_phase_end();
+    if (strcmp(done, "fold") == 0) {
+        printf("Constant folding: %d nodes folded, %d branches removed\n",
+               n->stats->fold.folded_nodes, n->stats->fold.removed_branches);
+    } else if (n->dump_symbols && (strcmp(done, "semantic") == 0 || strcmp(done, "check+gen") == 0)) {
+        print_symbol_table();
+    }
+    n->phase = NULL;
+}
+
+static void narrate_phase(const char* name, void* arg) {
+    Narration* n = arg;
+    finish_phase(n);
+    if (strcmp(name, "semantic") == 0) {
+        if (n->dump_ast && n->flat) print_flat_ast(n->flat);
+        printf("\n----------------------SEMANTIC ANALYSIS----------------\n");
+    } else if (strcmp(name, "check+gen") == 0) {
+        printf("\n----------------------SEMANTIC ANALYSIS----------------\n");
+        printf("Checked during code generation (--one-pass)\n");
+    } else if (strcmp(name, "fold") == 0) {
+        printf("\n----------------------OPTIMIZATION----------------\n");
+    }
+    if (strcmp(name, "codegen") == 0 || strcmp(name, "check+gen") == 0) {
+        printf("\n----------------------CODE GENERATION----------------\n");
+        printf("Generating code...\n");
+    }
+    n->phase = name;
+    stats_phase_begin(name);
+}
+
+static void print_pass_stats(const PassStats* stats, int sccp) {
+    print_peephole_stats("Peephole", &stats->peephole);
+    if (sccp) {
+        const SccpStats* s = &stats->sccp;
+        printf("SCCP: %d constants propagated, %d definitions removed, %d branches resolved, "
+               "%d blocks removed (%d phis), %d -> %d instructions, %d -> %d branches\n",
+               s->constants, s->defs_removed, s->branches_resolved, s->blocks_removed, s->phis,
+               s->before, s->after, s->branches_before, s->branches_after);
+    }
+    printf("Value numbering: %d binops reused, %d -> %d instructions\n",
+           stats->lvn.reused, stats->lvn.before, stats->lvn.after);
+    printf("Loops: %d found, %d binops hoisted, %d multiplications reduced, %d -> %d instructions\n",
+           stats->loop.loops, stats->loop.hoisted, stats->loop.reduced,
+           stats->loop.before, stats->loop.after);
+    print_peephole_stats("Peephole after loops", &stats->peephole_after_loops);
+    const CfgStats* c = &stats->cfg;
+    printf("CFG cleanup: %d jumps threaded, %d jumps removed, %d branches inverted, "
+           "%d blocks and %d labels removed, %d -> %d instructions\n",
+           c->jumps_threaded, c->jumps_removed, c->branches_inverted, c->blocks_removed,
+           c->labels_removed, c->before, c->after);
+    printf("Temp allocation: %d temps -> %d slots (peak live %d, %d spilled)\n",
+           stats->regalloc.temps_before, stats->regalloc.slots, stats->regalloc.peak_live,
+           stats->regalloc.spilled);
+}
+
+// What to do with the finished TAC, whether just compiled or loaded
+typedef struct {
+    int run;            // --run: execute the TAC after compiling
+    int bench_runs;     // --bench-vm N: time N silent executions
+    int jit;            // --jit: compile the TAC to machine code and run it
+    int bench_jit_runs; // --bench-jit N: time N silent JIT compiles and runs
+    int emit_asm;       // -S: also write x86-64 assembly to out.s
+} Backends;
+
+static int run_backends(TacProgram* tac, const Backends* options) {
+    if (options->emit_asm) {
+        emit_x86_to_file(tac, "out.s");
+        printf("Assembly written to out.s\n");
+    }
+
+    if (options->run) {
+        printf("\n----------------------EXECUTION----------------\n");
+        VMStats vm_stats;
+        if (vm_run(tac, stdout, &vm_stats) != 0) return 1;
+    }
+
+    if (options->bench_runs > 0) {
+        long long executed = 0;
+        double seconds = 0;
+        for (int i = 0; i < options->bench_runs; i++) {
+            VMStats vm_stats;
+            if (vm_run(tac, NULL, &vm_stats) != 0) return 1;
+            executed += vm_stats.executed;
+            seconds += vm_stats.seconds;
+        }
+        printf("VM: %lld instructions in %.6f s (%.1f M instructions/s)\n",
+               executed, seconds, seconds > 0 ? executed / seconds / 1e6 : 0.0);
+    }
+
+    if (options->jit) {
+        printf("\n----------------------JIT EXECUTION----------------\n");
+        JitStats jit_stats;
+        if (jit_run(tac, stdout, &jit_stats) != 0) return 1;
+        printf("JIT: %zu bytes of code, compiled in %.6f s, ran in %.6f s\n",
+               jit_stats.code_bytes, jit_stats.compile_seconds, jit_stats.run_seconds);
+    }
+
+    if (options->bench_jit_runs > 0) {
+        double compile_seconds = 0, run_seconds = 0;
+        for (int i = 0; i < options->bench_jit_runs; i++) {
+            JitStats jit_stats;
+            if (jit_run(tac, NULL, &jit_stats) != 0) return 1;
+            compile_seconds += jit_stats.compile_seconds;
+            run_seconds += jit_stats.run_seconds;
+        }
+        printf("JIT: %d runs, %.6f s compiling, %.6f s executing\n",
+               options->bench_jit_runs, compile_seconds, run_seconds);
+    }
+    return 0;
 }
 
 int main(int argc, char** argv) {
-    if (argc > 1) {
-        FILE* file = fopen(argv[1], "r");
-        if (!file) {
-            perror("fopen");
+    const char* input = NULL;
+    char** inputs = malloc(sizeof(char*) * argc);
+    int input_count = 0;
+    int jobs = 0;           // -j N: compile every input on N threads
+    Backends backends = { 0, 0, 0, 0, 0 };
+    int optimize = 1;       // -O0 turns the optimization passes off
+    int one_pass = 0;       // --one-pass: check while generating, no AST folding
+    int sccp = 1;           // --no-sccp: skip constant propagation on SSA
+    int flat = 0;           // --flat: check and generate from the flat AST layout
+    const char* serve_path = NULL;  // --serve SOCKET|-: run as a compile server
+    int max_temps = 0;      // --max-temps N: cap the temp pool, spill the rest
+    int emit_binary = 0;    // --binary: also write binary TAC to out.tacb
+    const char* load_path = NULL;   // --load FILE: use a .tacb instead of compiling
+    const char* cache_dir = NULL;   // --cache DIR: reuse TAC for unchanged sources
+    long cache_mb = 64;             // --cache-size MB: evict beyond this
+    int cache_stats_only = 0;       // --cache-stats: print the cache's totals
+    int dump_tokens = 0;    // --dump-tokens: echo tokens as they are scanned
+    int lex_diff = 0;       // --lex-diff: compare the scanners token by token
+    int dump_ast = 0;       // --dump-ast: print the syntax tree
+    int dump_symbols = 0;   // --dump-symbols: print the symbol table
+    int stats = 0;          // --stats: per-phase time and memory report
+    int stats_hw = 0;       // --stats-hw: --stats plus hardware counters
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--run") == 0) {
+            backends.run = 1;
+        } else if (strcmp(argv[i], "--bench-vm") == 0 && i + 1 < argc) {
+            backends.bench_runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            backends.jit = 1;
+        } else if (strcmp(argv[i], "--bench-jit") == 0 && i + 1 < argc) {
+            backends.bench_jit_runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            optimize = 0;
+        } else if (strcmp(argv[i], "--one-pass") == 0) {
+            one_pass = 1;
+        } else if (strcmp(argv[i], "--no-sccp") == 0) {
+            sccp = 0;
+        } else if (strcmp(argv[i], "--flat") == 0) {
+            flat = 1;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (strcmp(argv[i], "--max-temps") == 0 && i + 1 < argc) {
+            max_temps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-S") == 0) {
+            backends.emit_asm = 1;
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            emit_binary = 1;
+        } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            load_path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+            cache_mb = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            cache_stats_only = 1;
+        } else if (strcmp(argv[i], "--dump-tokens") == 0) {
+            dump_tokens = 1;
+        } else if (strcmp(argv[i], "--lexer") == 0 && i + 1 < argc) {
+            ScannerKind kind;
+            if (scanner_parse_kind(argv[++i], &kind) != 0) {
+                fprintf(stderr, "Unknown or unsupported scanner '%s' (flex, scalar, sse2, avx2, auto)\n",
+                        argv[i]);
+                return 1;
+            }
+            scanner_use(kind);
+        } else if (strcmp(argv[i], "--lex-diff") == 0) {
+            lex_diff = 1;
+        } else if (strcmp(argv[i], "--dump-ast") == 0) {
+            dump_ast = 1;
+        } else if (strcmp(argv[i], "--dump-symbols") == 0) {
+            dump_symbols = 1;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_mask = trace_parse_categories(argv[++i]);
+            if (trace_mask < 0) {
+                fprintf(stderr, "Unknown trace category in '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = 1;
+        } else if (strcmp(argv[i], "--stats-hw") == 0) {
+            stats = stats_hw = 1;
+        } else {
+            input = argv[i];
+            inputs[input_count++] = argv[i];
+        }
+    }
+
+    if (cache_stats_only) {
+        CacheStats totals;
+        if (!cache_dir || cache_read_totals(cache_dir, &totals) != 0) {
+            fprintf(stderr, "No cache statistics found\n");
             return 1;
         }
-        yyin = file;
+        print_cache_stats("Cache totals", &totals);
+        return 0;
+    }
+
+    // Without an explicit cap, size the temp pool to the backend's registers
+    if (backends.emit_asm && max_temps == 0) max_temps = X86_TEMP_REGISTERS;
+
+    // A binary TAC file runs as it lies in the mapping, nothing is parsed
+    if (load_path) {
+        TacImage image;
+        if (tac_image_open(&image, load_path) != 0) return 1;
+        printf("Loaded %s: %d instructions, %d variables, %d labels\n", load_path,
+               image.prog.count, image.prog.var_count, image.prog.label_count);
+        int result = run_backends(&image.prog, &backends);
+        tac_image_close(&image);
+        return result;
+    }
+
+    // Everything that changes the TAC goes into the cache key
+    char cache_flags[64];
+    snprintf(cache_flags, sizeof(cache_flags), "O%d T%d%s%s", optimize, max_temps,
+             flat ? " F" : one_pass ? " P" : "", sccp ? "" : " N");
+    if (cache_dir) cache_open(cache_dir, (size_t)cache_mb * 1024 * 1024);
+
+    // The server pool defaults to one worker per CPU
+    if (serve_path) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        BatchOptions server = { jobs > 0 ? jobs : (cpus > 0 ? (int)cpus : 1), optimize, max_temps,
+                                NULL, one_pass, sccp, flat };
+        free(inputs);
+        return serve(strcmp(serve_path, "-") == 0 ? NULL : serve_path, &server);
+    }
+
+    if (jobs > 0) {
+        BatchOptions batch = { jobs, optimize, max_temps, cache_flags, one_pass, sccp, flat };
+        int failed = batch_compile(inputs, input_count, &batch);
+        free(inputs);
+        if (cache_enabled()) {
+            CacheStats cache_stats;
+            cache_close(&cache_stats);
+            print_cache_stats("Cache", &cache_stats);
+        }
+        return failed > 0 ? 1 : 0;
+    }
+    free(inputs);
+
+    if (stats) stats_start(stats_hw);
+
+    // Map the source (standard input when no file is given)
+    CompileContext ctx;
+    stats_phase_begin("load");
+    if (context_load(&ctx, input) != 0) return 1;
+    stats_phase_end();
+
+    // Flex against every hand-written scanner this CPU runs, then stop
+    if (lex_diff) {
+        int differs = 0;
+        for (int k = SCANNER_SCALAR; k < SCANNER_KIND_COUNT; k++) {
+            if (scanner_supported((ScannerKind)k)) differs |= scanner_diff(&ctx, (ScannerKind)k);
+        }
+        context_release(&ctx);
+        return differs;
+    }
+
+    // A cache hit restores out.tac without parsing; modes that need the
+    // program in memory always compile
+    int use_cache = cache_enabled() && !backends.run && !backends.bench_runs && !backends.jit &&
+                    !backends.bench_jit_runs && !backends.emit_asm && !emit_binary;
+    uint64_t cache_key_value = 0;
+    if (use_cache) {
+        cache_key_value = cache_key(ctx.buffer, ctx.length, cache_flags);
+        if (cache_fetch(cache_key_value, "out.tac")) {
+            context_release(&ctx);
+            printf("Cache hit: out.tac restored\n");
+            CacheStats cache_stats;
+            cache_close(&cache_stats);
+            print_cache_stats("Cache", &cache_stats);
+            return 0;
+        }
     }
     
-    // Enable token printing
-    print_tokens = 1;
+    // Token printing is opt-in; on large inputs it dwarfs the compile
+    ctx.print_tokens = dump_tokens;
     
     // Print the lexical analysis header
     printf("\n-----------------------------LEXICAL ANALYSIS-----------------------\n");
     
     // Parse the input which will also print tokens as they're scanned
-    int parse_result = yyparse();
+    stats_phase_begin("parse");
+    parse_context(&ctx);
+    stats_phase_end();
+    context_release(&ctx);
     
     // Disable token printing after first pass (in case we need to parse again)
-    print_tokens = 0;
+    ctx.print_tokens = 0;
     
     // Check if parsing was successful
-    if (syntax_errors > 0) {
+    if (ctx.syntax_errors > 0) {
         printf("Compilation aborted due to syntax errors.\n");
         return 1;
     }
@@ -122,18 +468,50 @@ int main(int argc, char** argv) {
     printf("\n--------------------------SYNTAX ANALYSIS---------------------\n");
     
     // Only proceed if we have a valid AST
+    ASTNode* root = ctx.root;
     if (root) {
-        print_ast(root, 0);
-        
-        // Print the semantic analysis header
-        printf("\n----------------------SEMANTIC ANALYSIS----------------\n");
-        semantic_check(root);
-        print_symbol_table();
-        
-        // Print the code generation header
-        printf("\n----------------------CODE GENERATION----------------\n");
-        printf("Generating code...\n");
-        generate_code(root, "out.tac");
+        if (dump_ast && !flat) print_ast(root, 0);
+
+        FlatAst flat_ast;
+        flat_init(&flat_ast);
+        BatchOptions pipeline = { 1, optimize, max_temps, NULL, one_pass, sccp, flat };
+        Narration narration = { NULL, dump_ast, dump_symbols, flat ? &flat_ast : NULL, NULL };
+        PipelineObserver observer = { .phase = narrate_phase, .arg = &narration, .flat = &flat_ast };
+        narration.stats = &observer.stats;
+        TacProgram tac;
+        tac_init(&tac);
+        if (batch_compile_tree(root, &tac, &pipeline, &observer) != 0) return 1;
+        finish_phase(&narration);
+        if (optimize) print_pass_stats(&observer.stats, sccp);
+        stats_phase_begin("emit");
+        emit_TAC_to_file(&tac, "out.tac");
+        stats_phase_end();
+        if (use_cache) cache_store(cache_key_value, "out.tac");
+        printf("TAC: %d instructions, %zu bytes\n",
+               tac.count, tac.count * sizeof(TACInstruction));
+        if (emit_binary) {
+            emit_TAC_binary(&tac, "out.tacb");
+            printf("Binary TAC written to out.tacb\n");
+        }
+        if (run_backends(&tac, &backends) != 0) return 1;
+
+        AstArenaStats ast_stats = ast_arena_stats();
+        printf("AST: %zu nodes, %zu bytes used, %zu bytes reserved\n",
+               ast_stats.nodes, ast_stats.bytes_used, ast_stats.bytes_reserved);
+        if (flat) {
+            printf("Flat AST: %u nodes, %zu bytes\n", flat_ast.count, flat_bytes(&flat_ast));
+        }
+        flat_free(&flat_ast);
+        stats_report(ctx.tokens, ast_stats.nodes, tac.count);
+        ctx.root = NULL;
+        ast_arena_destroy();
+        tac_free(&tac);
+        intern_destroy();
+        if (use_cache) {
+            CacheStats cache_stats;
+            cache_close(&cache_stats);
+            print_cache_stats("Cache", &cache_stats);
+        }
     } else {
         printf("No valid AST was produced.\n");
         return 1;
@@ -141,3 +519,4 @@ int main(int argc, char** argv) {
     
     return 0;
 }
+#endif
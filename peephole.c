@@ -0,0 +1,388 @@
+// peephole.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "peephole.h"
+
+typedef struct {
+    TacOperand source;      // what the name was last copied from
+    int source_version;     // version of the source's name at the copy
+    int stamp;              // block the copy was made in
+} Copy;
+
+typedef struct {
+    TacProgram* prog;
+    PeepholeStats* stats;
+    char* removed;          // per instruction, until the sweep compacts the code
+    int removed_count;
+    int* uses;              // per temp: operands reading it
+    int* defs;              // per temp: instructions writing it
+    int* def_at;            // per temp: where its definition is, if it has one
+    int* dead;              // temps whose last read went away, to check
+    int dead_count;
+    char* queued;           // per temp: already on the dead list
+    Copy* copies;           // per name: variables first, then temps
+    int* version;           // per name: bumped on every write
+    int stamp;
+} Peephole;
+
+typedef int (*RuleFunction)(Peephole* p, int i);
+
+static void* checked_calloc(size_t count, size_t size) {
+    void* ptr = calloc(count ? count : 1, size);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed for peephole optimization\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static int name_of(const TacProgram* prog, uint8_t kind, int32_t value) {
+    if (kind == OPND_VAR) return value;
+    if (kind == OPND_TEMP) return prog->var_count + value;
+    return -1;
+}
+
+static int defines(const TACInstruction* ins) {
+    return ins->op == TAC_COPY || tac_is_binop((TacOp)ins->op);
+}
+
+static int is_imm(uint8_t kind, int32_t value, int32_t imm) {
+    return kind == OPND_IMM && value == imm;
+}
+
+// Same variable or temp; two immediates are left to folding
+static int same_name(uint8_t kind_a, int32_t a, uint8_t kind_b, int32_t b) {
+    return kind_a == kind_b && a == b && (kind_a == OPND_VAR || kind_a == OPND_TEMP);
+}
+
+// k when v is 2^k for 1 <= k <= 30, else -1
+static int exact_log2(int32_t v) {
+    if (v < 2 || (v & (v - 1)) != 0) return -1;
+    int k = 0;
+    while ((1 << k) != v) k++;
+    return k;
+}
+
+static void count_read(Peephole* p, uint8_t kind, int32_t value, int delta) {
+    if (kind != OPND_TEMP) return;
+    p->uses[value] += delta;
+    if (p->uses[value] == 0 && p->defs[value] == 1 && !p->queued[value]) {
+        p->queued[value] = 1;
+        p->dead[p->dead_count++] = value;
+    }
+}
+
+static void make_copy(Peephole* p, TACInstruction* ins, TacOperand source) {
+    count_read(p, ins->a_kind, ins->a, -1);
+    count_read(p, ins->b_kind, ins->b, -1);
+    count_read(p, source.kind, source.value, 1);
+    ins->op = TAC_COPY;
+    ins->a_kind = source.kind;
+    ins->a = source.value;
+    ins->b_kind = OPND_NONE;
+    ins->b = 0;
+}
+
+static void remove_instruction(Peephole* p, int i) {
+    TACInstruction* ins = &p->prog->code[i];
+    count_read(p, ins->a_kind, ins->a, -1);
+    count_read(p, ins->b_kind, ins->b, -1);
+    if (defines(ins) && ins->dst_kind == OPND_TEMP) p->defs[ins->dst]--;
+    p->removed[i] = 1;
+    p->removed_count++;
+}
+
+// Reads go to the operand a name was copied from, while neither has been
+// written since and control has not left the block
+static int rule_copy(Peephole* p, int i) {
+    TACInstruction* ins = &p->prog->code[i];
+    if (ins->op == TAC_LABEL || ins->op == TAC_GOTO) return 0;
+    uint8_t* kinds[2] = { &ins->a_kind, &ins->b_kind };
+    int32_t* values[2] = { &ins->a, &ins->b };
+    int hit = 0;
+    for (int k = 0; k < 2; k++) {
+        int name = name_of(p->prog, *kinds[k], *values[k]);
+        if (name < 0 || p->copies[name].stamp != p->stamp) continue;
+        const Copy* c = &p->copies[name];
+        if (c->source.kind == *kinds[k] && c->source.value == *values[k]) continue;
+        int source = name_of(p->prog, c->source.kind, c->source.value);
+        if (source >= 0 && p->version[source] != c->source_version) continue;
+        count_read(p, *kinds[k], *values[k], -1);
+        count_read(p, c->source.kind, c->source.value, 1);
+        *kinds[k] = c->source.kind;
+        *values[k] = c->source.value;
+        hit = 1;
+    }
+    return hit;
+}
+
+static int rule_fold(Peephole* p, int i) {
+    TACInstruction* ins = &p->prog->code[i];
+    int32_t result;
+    if (tac_is_binop((TacOp)ins->op)) {
+        if (ins->a_kind != OPND_IMM || ins->b_kind != OPND_IMM) return 0;
+        if (!tac_evaluate((TacOp)ins->op, ins->a, ins->b, &result)) return 0;
+        make_copy(p, ins, tac_imm(result));
+        return 1;
+    }
+    if (ins->op == TAC_IFGOTO) {
+        if (ins->a_kind != OPND_IMM) return 0;
+        result = ins->a != 0;
+    } else if (ins->op >= TAC_IF_EQ && ins->op <= TAC_IF_GE) {
+        if (ins->a_kind != OPND_IMM || ins->b_kind != OPND_IMM) return 0;
+        tac_evaluate((TacOp)ins->op, ins->a, ins->b, &result);
+    } else {
+        return 0;
+    }
+    if (!result) {
+        remove_instruction(p, i);
+        return 1;
+    }
+    ins->op = TAC_GOTO;
+    ins->a_kind = ins->b_kind = OPND_NONE;
+    ins->a = ins->b = 0;
+    return 1;
+}
+
+static int rule_identity(Peephole* p, int i) {
+    TACInstruction* ins = &p->prog->code[i];
+    TacOperand a = tac_a(ins), b = tac_b(ins);
+    if (ins->op == TAC_COPY) {
+        if (!same_name(ins->dst_kind, ins->dst, a.kind, a.value)) return 0;
+        remove_instruction(p, i);
+        return 1;
+    }
+
+    TacOperand result;
+    switch ((TacOp)ins->op) {
+        case TAC_ADD:
+            if (is_imm(b.kind, b.value, 0)) result = a;
+            else if (is_imm(a.kind, a.value, 0)) result = b;
+            else return 0;
+            break;
+        case TAC_SUB:
+            if (is_imm(b.kind, b.value, 0)) result = a;
+            else if (same_name(a.kind, a.value, b.kind, b.value)) result = tac_imm(0);
+            else return 0;
+            break;
+        case TAC_MUL:
+            if (is_imm(a.kind, a.value, 0) || is_imm(b.kind, b.value, 0)) result = tac_imm(0);
+            else if (is_imm(b.kind, b.value, 1)) result = a;
+            else if (is_imm(a.kind, a.value, 1)) result = b;
+            else return 0;
+            break;
+        case TAC_DIV:
+            // x / x and 0 / x still have to fail when x is 0
+            if (is_imm(b.kind, b.value, 1)) result = a;
+            else return 0;
+            break;
+        case TAC_SHL:
+        case TAC_SHR:
+            if (b.kind == OPND_IMM && (b.value & 31) == 0) result = a;
+            else if (is_imm(a.kind, a.value, 0)) result = tac_imm(0);
+            else return 0;
+            break;
+        case TAC_EQ:
+        case TAC_LE:
+        case TAC_GE:
+        case TAC_NE:
+        case TAC_LT:
+        case TAC_GT:
+            if (!same_name(a.kind, a.value, b.kind, b.value)) return 0;
+            result = tac_imm(ins->op == TAC_EQ || ins->op == TAC_LE || ins->op == TAC_GE);
+            break;
+        default:
+            return 0;
+    }
+    make_copy(p, ins, result);
+    return 1;
+}
+
+// x * 2^k -> x << k and x / 2^k -> x >> k, the shift rounding toward
+// zero like the division does
+static int rule_shift(Peephole* p, int i) {
+    TACInstruction* ins = &p->prog->code[i];
+    int k;
+    if (ins->op == TAC_MUL && ins->b_kind == OPND_IMM && (k = exact_log2(ins->b)) > 0) {
+        ins->op = TAC_SHL;
+    } else if (ins->op == TAC_MUL && ins->a_kind == OPND_IMM && (k = exact_log2(ins->a)) > 0) {
+        ins->op = TAC_SHL;
+        ins->a_kind = ins->b_kind;
+        ins->a = ins->b;
+        ins->b_kind = OPND_IMM;
+    } else if (ins->op == TAC_DIV && ins->b_kind == OPND_IMM && (k = exact_log2(ins->b)) > 0) {
+        ins->op = TAC_SHR;
+    } else {
+        return 0;
+    }
+    ins->b = k;
+    return 1;
+}
+
+// "t = a op b; x = t" -> "x = a op b" when that copy is the only read of t.
+// Matched from the copy, so anything already removed in between is skipped.
+static int rule_temp_dst(Peephole* p, int i) {
+    TacProgram* prog = p->prog;
+    TACInstruction* ins = &prog->code[i];
+    if (ins->op != TAC_COPY || ins->a_kind != OPND_TEMP) return 0;
+    int t = ins->a;
+    if (p->defs[t] != 1 || p->uses[t] != 1) return 0;
+    int j = i - 1;
+    while (j >= 0 && p->removed[j]) j--;
+    if (j < 0) return 0;
+    const TACInstruction* def = &prog->code[j];
+    if (!defines(def) || def->dst_kind != OPND_TEMP || def->dst != t) return 0;
+
+    TACInstruction moved = *def;
+    moved.dst_kind = ins->dst_kind;
+    moved.dst = ins->dst;
+    *ins = moved;
+    p->uses[t] = 0;
+    p->defs[t] = 0;
+    p->removed[j] = 1;
+    p->removed_count++;
+    return 1;
+}
+
+static int rule_dead(Peephole* p, int i) {
+    TACInstruction* ins = &p->prog->code[i];
+    if (!defines(ins) || ins->dst_kind != OPND_TEMP || p->uses[ins->dst] != 0) return 0;
+    // A division that may fail has to stay for its error
+    if (ins->op == TAC_DIV && (ins->b_kind != OPND_IMM || ins->b == 0)) return 0;
+    remove_instruction(p, i);
+    return 1;
+}
+
+// Tried in this order on each instruction; copies first, so the others see
+// the operands the instruction really reads
+static const struct {
+    const char* name;
+    RuleFunction apply;
+} rules[PEEP_RULE_COUNT] = {
+    [PEEP_COPY]     = { "copy",     rule_copy },
+    [PEEP_FOLD]     = { "fold",     rule_fold },
+    [PEEP_IDENTITY] = { "identity", rule_identity },
+    [PEEP_SHIFT]    = { "shift",    rule_shift },
+    [PEEP_TEMP_DST] = { "temp-dst", rule_temp_dst },
+    [PEEP_DEAD]     = { "dead",     rule_dead },
+};
+
+const char* peephole_rule_name(PeepholeRule rule) {
+    return rule >= 0 && rule < PEEP_RULE_COUNT ? rules[rule].name : "?";
+}
+
+// A rewrite that drops the last read of a temp defined further up makes
+// that definition dead; take it out now rather than a sweep later. Removing
+// it can drop the last read of another temp in turn.
+static int remove_dead_above(Peephole* p, int i) {
+    int hits = 0;
+    while (p->dead_count > 0) {
+        int t = p->dead[--p->dead_count];
+        p->queued[t] = 0;
+        int at = p->def_at[t];
+        if (p->uses[t] != 0 || p->defs[t] != 1 || at >= i || p->removed[at]) continue;
+        const TACInstruction* def = &p->prog->code[at];
+        if (!defines(def) || def->dst_kind != OPND_TEMP || def->dst != t) continue;
+        if (rule_dead(p, at)) {
+            p->stats->hits[PEEP_DEAD]++;
+            hits++;
+        }
+    }
+    return hits;
+}
+
+// One pass over the code; returns the number of rewrites
+static int sweep(Peephole* p) {
+    TacProgram* prog = p->prog;
+    int hits = 0;
+    p->stamp++;
+    for (int i = 0; i < prog->count; i++) {
+        TACInstruction* ins = &prog->code[i];
+        if (ins->op == TAC_LABEL) {
+            p->stamp++;
+            continue;
+        }
+        for (int r = 0; r < PEEP_RULE_COUNT && !p->removed[i]; r++) {
+            if (rules[r].apply(p, i)) {
+                p->stats->hits[r]++;
+                hits++;
+            }
+        }
+        hits += remove_dead_above(p, i);
+        if (p->removed[i]) continue;
+        if (defines(ins) && ins->dst_kind == OPND_TEMP) p->def_at[ins->dst] = i;
+
+        if (defines(ins)) {
+            int name = name_of(prog, ins->dst_kind, ins->dst);
+            p->version[name]++;
+            Copy* c = &p->copies[name];
+            c->stamp = 0;
+            if (ins->op == TAC_COPY) {
+                int source = name_of(prog, ins->a_kind, ins->a);
+                c->source = tac_a(ins);
+                c->source_version = source >= 0 ? p->version[source] : 0;
+                c->stamp = p->stamp;
+            }
+        }
+        if (tac_is_jump((TacOp)ins->op)) p->stamp++;
+    }
+
+    if (p->removed_count == 0) return hits;
+    int out = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (p->removed[i]) {
+            p->removed[i] = 0;
+            continue;
+        }
+        prog->code[out++] = prog->code[i];
+    }
+    prog->count = out;
+    p->removed_count = 0;
+    return hits;
+}
+
+void peephole_optimize(TacProgram* prog, PeepholeStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->before = prog->count;
+
+    Peephole p;
+    int names = prog->var_count + prog->temp_count;
+    p.prog = prog;
+    p.stats = stats;
+    p.removed = checked_calloc(prog->count, sizeof(char));
+    p.removed_count = 0;
+    p.uses = checked_calloc(prog->temp_count, sizeof(int));
+    p.defs = checked_calloc(prog->temp_count, sizeof(int));
+    p.def_at = checked_calloc(prog->temp_count, sizeof(int));
+    p.dead = checked_calloc(prog->temp_count, sizeof(int));
+    p.dead_count = 0;
+    p.queued = checked_calloc(prog->temp_count, sizeof(char));
+    p.copies = checked_calloc(names, sizeof(Copy));
+    p.version = checked_calloc(names, sizeof(int));
+    p.stamp = 0;
+
+    // The rules keep these counts up to date from here on
+    for (int i = 0; i < prog->count; i++) {
+        const TACInstruction* ins = &prog->code[i];
+        if (ins->a_kind == OPND_TEMP) p.uses[ins->a]++;
+        if (ins->b_kind == OPND_TEMP) p.uses[ins->b]++;
+        if (defines(ins) && ins->dst_kind == OPND_TEMP) p.defs[ins->dst]++;
+    }
+
+    do {
+        stats->passes++;
+    } while (sweep(&p) > 0);
+    stats->after = prog->count;
+
+    free(p.removed);
+    free(p.uses);
+    free(p.defs);
+    free(p.def_at);
+    free(p.dead);
+    free(p.queued);
+    free(p.copies);
+    free(p.version);
+}
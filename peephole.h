@@ -0,0 +1,34 @@
+// peephole.h
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "tac.h"
+
+typedef enum {
+    PEEP_COPY,          // operands read through a copy made earlier in the block
+    PEEP_FOLD,          // binops and compare-and-branches on two constants
+    PEEP_IDENTITY,      // x + 0, x * 1, x * 0, x - x, x == x, x = x, ...
+    PEEP_SHIFT,         // multiplication or division by a power of two
+    PEEP_TEMP_DST,      // "t = a op b; x = t" -> "x = a op b" when t is read once
+    PEEP_DEAD,          // temps nothing reads
+    PEEP_RULE_COUNT
+} PeepholeRule;
+
+typedef struct {
+    int before;                     // instruction count going in
+    int after;                      // instruction count coming out
+    int passes;                     // sweeps until no rule applied
+    int hits[PEEP_RULE_COUNT];      // rewrites per rule
+} PeepholeStats;
+
+// Short name of a rule, for reports
+const char* peephole_rule_name(PeepholeRule rule);
+
+// Sweeps the code trying every rule on every instruction, over and over
+// until a sweep changes nothing. Copies are only followed inside a basic
+// block. Runs straight after code generation and again once the loop
+// passes have added their copies.
+void peephole_optimize(TacProgram* prog, PeepholeStats* stats);
+
+#endif
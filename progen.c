@@ -0,0 +1,53 @@
+// progen.c
+//
+// Writes a synthetic program to stdout, for load tests and bench:
+//
+//     progen [--size BYTES[K|M|G]] [--idents N] [--expr-depth N]
+//            [--if-depth N] [--bool-percent P] [--loop-percent P]
+//            [--seed S]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "generator.h"
+
+// 64K, 16M, 1G and so on
+static size_t parse_size(const char* s) {
+    char* end;
+    double value = strtod(s, &end);
+    switch (*end) {
+        case 'k': case 'K': value *= 1024; break;
+        case 'm': case 'M': value *= 1024 * 1024; break;
+        case 'g': case 'G': value *= 1024.0 * 1024 * 1024; break;
+    }
+    return (size_t)value;
+}
+
+int main(int argc, char** argv) {
+    GeneratorOptions options;
+    generator_defaults(&options);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            options.size = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--idents") == 0 && i + 1 < argc) {
+            options.identifiers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--expr-depth") == 0 && i + 1 < argc) {
+            options.expr_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--if-depth") == 0 && i + 1 < argc) {
+            options.if_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bool-percent") == 0 && i + 1 < argc) {
+            options.bool_percent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loop-percent") == 0 && i + 1 < argc) {
+            options.loop_percent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+
+    generate_program(stdout, &options);
+    return 0;
+}
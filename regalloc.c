@@ -0,0 +1,362 @@
+// regalloc.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "regalloc.h"
+#include "cfg.h"
+
+static void* checked_calloc(size_t count, size_t size) {
+    void* ptr = calloc(count ? count : 1, size);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed for temp allocation\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static void* checked_realloc(void* ptr, size_t size) {
+    void* p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for temp allocation\n");
+        exit(1);
+    }
+    return p;
+}
+
+// Live interval of each temp, as instruction indices [start, end]
+static _Thread_local int* start;
+static _Thread_local int* end;
+
+// ---------------------------------------------------------------------------
+// Liveness
+//
+// Codegen keeps almost every temp inside one basic block, where its interval
+// is simply first-to-last occurrence. A temp that crosses a block boundary
+// is followed backwards from its reads through the blocks it is live in, so
+// the work is proportional to how far temps live rather than to the number
+// of blocks times the number of such temps.
+
+// A block that writes a global temp, or reads it before writing it
+typedef struct {
+    int global;
+    int block;      // the block for a write, -(block + 1) for a read
+} Site;
+
+static void compute_intervals(const TacProgram* prog, const BlockList* cfg) {
+    int n = prog->temp_count;
+    int* home_block = checked_calloc(n, sizeof(int));
+    int* global_index = checked_calloc(n, sizeof(int));
+    for (int t = 0; t < n; t++) {
+        start[t] = INT_MAX;
+        end[t] = -1;
+        home_block[t] = -1;
+        global_index[t] = -1;
+    }
+
+    int globals = 0;
+    for (int b = 0; b < cfg->count; b++) {
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            const TACInstruction* ins = &prog->code[i];
+            TacOperand ops[3] = { tac_a(ins), tac_b(ins), tac_dst(ins) };
+            for (int k = 0; k < 3; k++) {
+                if (ops[k].kind != OPND_TEMP) continue;
+                int t = ops[k].value;
+                if (i < start[t]) start[t] = i;
+                if (i > end[t]) end[t] = i;
+                if (home_block[t] < 0) home_block[t] = b;
+                else if (home_block[t] != b && global_index[t] < 0) global_index[t] = globals++;
+            }
+        }
+    }
+
+    if (globals > 0) {
+        int blocks = cfg->count;
+
+        // Predecessors, as offsets into one array
+        int* pred_start = checked_calloc(blocks + 1, sizeof(int));
+        for (int b = 0; b < blocks; b++) {
+            for (int s = 0; s < cfg->blocks[b].succ_count; s++) pred_start[cfg->blocks[b].succ[s] + 1]++;
+        }
+        for (int b = 0; b < blocks; b++) pred_start[b + 1] += pred_start[b];
+        int* preds = checked_calloc(pred_start[blocks], sizeof(int));
+        int* fill = checked_calloc(blocks, sizeof(int));
+        for (int b = 0; b < blocks; b++) {
+            for (int s = 0; s < cfg->blocks[b].succ_count; s++) {
+                int succ = cfg->blocks[b].succ[s];
+                preds[pred_start[succ] + fill[succ]++] = b;
+            }
+        }
+
+        // Sites of each global temp, grouped by a counting sort
+        int site_count = 0, site_capacity = 1024;
+        Site* sites = checked_calloc(site_capacity, sizeof(Site));
+        int* written = checked_calloc(globals, sizeof(int));     // block + 1 that last wrote it
+        int* exposed = checked_calloc(globals, sizeof(int));     // block + 1 that last recorded a read
+        for (int b = 0; b < blocks; b++) {
+            for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+                const TACInstruction* ins = &prog->code[i];
+                TacOperand ops[3] = { tac_a(ins), tac_b(ins), tac_dst(ins) };
+                for (int k = 0; k < 3; k++) {
+                    if (ops[k].kind != OPND_TEMP) continue;
+                    int g = global_index[ops[k].value];
+                    if (g < 0) continue;
+                    int* mark = k < 2 ? &exposed[g] : &written[g];
+                    if (*mark == b + 1 || (k < 2 && written[g] == b + 1)) continue;
+                    *mark = b + 1;
+                    if (site_count == site_capacity) {
+                        site_capacity *= 2;
+                        sites = checked_realloc(sites, sizeof(Site) * site_capacity);
+                    }
+                    sites[site_count].global = g;
+                    sites[site_count].block = k < 2 ? -(b + 1) : b;
+                    site_count++;
+                }
+            }
+        }
+        int* site_start = checked_calloc(globals + 1, sizeof(int));
+        for (int k = 0; k < site_count; k++) site_start[sites[k].global + 1]++;
+        for (int g = 0; g < globals; g++) site_start[g + 1] += site_start[g];
+        int* site_block = checked_calloc(site_count, sizeof(int));
+        int* site_fill = checked_calloc(globals, sizeof(int));
+        for (int k = 0; k < site_count; k++) {
+            int g = sites[k].global;
+            site_block[site_start[g] + site_fill[g]++] = sites[k].block;
+        }
+        free(sites);
+        free(site_fill);
+
+        // Walk backwards from each read not preceded by a write in its
+        // block until reaching blocks that write the temp. A block the temp
+        // is live into stretches the interval to its first instruction, a
+        // block it is live out of to its last.
+        int* global_temp = checked_calloc(globals, sizeof(int));
+        for (int t = 0; t < n; t++) {
+            if (global_index[t] >= 0) global_temp[global_index[t]] = t;
+        }
+        int* live_in = checked_calloc(blocks, sizeof(int));       // global + 1 that was last found live
+        int* live_out = checked_calloc(blocks, sizeof(int));
+        int* defines = checked_calloc(blocks, sizeof(int));
+        int* work = checked_calloc(blocks, sizeof(int));
+        for (int g = 0; g < globals; g++) {
+            int t = global_temp[g];
+            int mark = g + 1;
+            int top = 0;
+            for (int k = site_start[g]; k < site_start[g + 1]; k++) {
+                int b = site_block[k];
+                if (b >= 0) defines[b] = mark;
+            }
+            for (int k = site_start[g]; k < site_start[g + 1]; k++) {
+                int b = -site_block[k] - 1;
+                if (b < 0 || live_in[b] == mark) continue;
+                live_in[b] = mark;
+                work[top++] = b;
+            }
+            while (top > 0) {
+                int b = work[--top];
+                if (cfg->blocks[b].start < start[t]) start[t] = cfg->blocks[b].start;
+                if (cfg->blocks[b].start > end[t]) end[t] = cfg->blocks[b].start;
+                for (int k = pred_start[b]; k < pred_start[b + 1]; k++) {
+                    int p = preds[k];
+                    if (live_out[p] != mark) {
+                        live_out[p] = mark;
+                        int last = cfg->blocks[p].end - 1;
+                        if (last < start[t]) start[t] = last;
+                        if (last > end[t]) end[t] = last;
+                    }
+                    if (defines[p] != mark && live_in[p] != mark) {
+                        live_in[p] = mark;
+                        work[top++] = p;
+                    }
+                }
+            }
+        }
+
+        free(pred_start);
+        free(preds);
+        free(fill);
+        free(written);
+        free(exposed);
+        free(site_start);
+        free(site_block);
+        free(global_temp);
+        free(live_in);
+        free(live_out);
+        free(defines);
+        free(work);
+    }
+
+    free(home_block);
+    free(global_index);
+}
+
+// ---------------------------------------------------------------------------
+// Linear scan
+
+// Min-heap of temps ordered by interval end
+typedef struct {
+    int* items;
+    int size;
+} Heap;
+
+static void heap_push(Heap* h, int t) {
+    int i = h->size++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (end[h->items[parent]] <= end[t]) break;
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i] = t;
+}
+
+static void heap_remove_at(Heap* h, int i) {
+    int t = h->items[--h->size];
+    if (i == h->size) return;
+    // Sift up, then down
+    while (i > 0 && end[h->items[(i - 1) / 2]] > end[t]) {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && end[h->items[child + 1]] < end[h->items[child]]) child++;
+        if (end[h->items[child]] >= end[t]) break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    h->items[i] = t;
+}
+
+// Assigns slot[t] for every temp in `order` (sorted by start). With cap > 0
+// at most cap slots are used and the temps left over get slot -1.
+// Returns the number of slots used and stores the peak number of
+// simultaneously live intervals in *peak.
+static int linear_scan(const int* order, int count, int cap, int* slot, int* peak) {
+    Heap active = { checked_calloc(count, sizeof(int)), 0 };
+    int* free_slots = checked_calloc(count, sizeof(int));
+    int free_count = 0;
+    int slots_used = 0;
+    *peak = 0;
+
+    for (int k = 0; k < count; k++) {
+        int t = order[k];
+
+        // A temp read for the last time at this instruction can hand its
+        // slot to the one written here: operands are read before the write.
+        while (active.size > 0 && end[active.items[0]] <= start[t]) {
+            int done = active.items[0];
+            heap_remove_at(&active, 0);
+            free_slots[free_count++] = slot[done];
+        }
+        if (active.size + 1 > *peak) *peak = active.size + 1;
+
+        if (free_count > 0) {
+            slot[t] = free_slots[--free_count];
+        } else if (cap <= 0 || slots_used < cap) {
+            slot[t] = slots_used++;
+        } else {
+            // Pool is full: spill whichever interval ends last
+            int victim_index = -1;
+            for (int i = 0; i < active.size; i++) {
+                if (victim_index < 0 || end[active.items[i]] > end[active.items[victim_index]]) {
+                    victim_index = i;
+                }
+            }
+            int victim = active.items[victim_index];
+            if (end[victim] > end[t]) {
+                slot[t] = slot[victim];
+                slot[victim] = -1;
+                heap_remove_at(&active, victim_index);
+            } else {
+                slot[t] = -1;
+                continue;
+            }
+        }
+        heap_push(&active, t);
+    }
+
+    free(active.items);
+    free(free_slots);
+    return slots_used;
+}
+
+void allocate_temps(TacProgram* prog, int max_slots, RegAllocStats* stats) {
+    int n = prog->temp_count;
+    memset(stats, 0, sizeof(*stats));
+    stats->temps_before = n;
+    if (n == 0) return;
+
+    BlockList cfg;
+    build_cfg(prog, &cfg);
+
+    start = checked_calloc(n, sizeof(int));
+    end = checked_calloc(n, sizeof(int));
+    compute_intervals(prog, &cfg);
+
+    // Counting sort of the temps that occur at all, by interval start
+    int* bucket = checked_calloc(prog->count + 1, sizeof(int));
+    int* order = checked_calloc(n, sizeof(int));
+    int used = 0;
+    for (int t = 0; t < n; t++) {
+        if (end[t] >= 0) bucket[start[t] + 1]++;
+    }
+    for (int i = 0; i < prog->count; i++) bucket[i + 1] += bucket[i];
+    for (int t = 0; t < n; t++) {
+        if (end[t] >= 0) order[bucket[start[t]]++] = t;
+    }
+    used = bucket[prog->count];
+
+    int* slot = checked_calloc(n, sizeof(int));
+    int capped_peak;
+    stats->slots = linear_scan(order, used, max_slots, slot, &capped_peak);
+    stats->peak_live = capped_peak;
+    if (max_slots > 0 && stats->slots == max_slots) {
+        // Spilling hides pressure from the capped scan; measure it uncapped
+        int* scratch = checked_calloc(n, sizeof(int));
+        stats->peak_live = linear_scan(order, used, 0, scratch, &capped_peak);
+        free(scratch);
+    }
+
+    // Spilled temps share memory slots the same way, without a cap
+    int* spill_order = checked_calloc(n, sizeof(int));
+    int* spill_slot = checked_calloc(n, sizeof(int));
+    int spilled = 0;
+    for (int k = 0; k < used; k++) {
+        if (slot[order[k]] < 0) spill_order[spilled++] = order[k];
+    }
+    int spill_peak;
+    prog->spill_count = linear_scan(spill_order, spilled, 0, spill_slot, &spill_peak);
+    stats->spilled = spilled;
+
+    for (int i = 0; i < prog->count; i++) {
+        TACInstruction* ins = &prog->code[i];
+        uint8_t* kinds[3] = { &ins->dst_kind, &ins->a_kind, &ins->b_kind };
+        int32_t* values[3] = { &ins->dst, &ins->a, &ins->b };
+        for (int k = 0; k < 3; k++) {
+            if (*kinds[k] != OPND_TEMP) continue;
+            int t = *values[k];
+            if (slot[t] >= 0) {
+                *values[k] = slot[t];
+            } else {
+                *kinds[k] = OPND_SPILL;
+                *values[k] = spill_slot[t];
+            }
+        }
+    }
+    prog->temp_count = stats->slots;
+
+    free(start);
+    free(end);
+    free(bucket);
+    free(order);
+    free(slot);
+    free(spill_order);
+    free(spill_slot);
+    free_blocks(&cfg);
+    start = NULL;
+    end = NULL;
+}
@@ -0,0 +1,19 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "tac.h"
+
+typedef struct {
+    int temps_before;   // distinct temps handed out by codegen
+    int peak_live;      // most temps live at one instruction
+    int slots;          // temp pool size after allocation
+    int spilled;        // temps moved to memory because of the cap
+} RegAllocStats;
+
+// Backward liveness over the CFG, then linear-scan assignment of temps onto
+// a reusable pool sized by the peak pressure. With max_slots > 0 the pool is
+// capped and the temps that do not fit become OPND_SPILL memory slots.
+// Temps may be defined more than once afterwards, so this runs last.
+void allocate_temps(TacProgram* prog, int max_slots, RegAllocStats* stats);
+
+#endif
@@ -0,0 +1,605 @@
+// scanner.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include "scanner.h"
+#include "parser.tab.h"
+#include "intern.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCANNER_X86 1
+#else
+#define SCANNER_X86 0
+#endif
+
+// The flex side, in lexer.l; flex_lex is flex's yylex renamed by YY_DECL
+int flex_lex(YYSTYPE* value, void* scanner);
+void* flex_open(CompileContext* ctx);
+void flex_close(void* scanner);
+int flex_line(void* scanner);
+const char* flex_text(void* scanner, int* length);
+
+// How the hand-written scanner steps over runs of one character class.
+// Each returns the first byte at or after p that is not in the run; none
+// reads past end[0], the first of the NULs after the source.
+typedef struct {
+    const char* (*skip_blanks)(const char* p, const char* end, int* line); // spaces, tabs, newlines
+    const char* (*word_end)(const char* p, const char* end);    // [a-zA-Z0-9_]
+    const char* (*digits_end)(const char* p, const char* end);  // [0-9]
+    const char* (*line_end)(const char* p, const char* end);    // next '\n', or end
+} ScanOps;
+
+typedef struct {
+    CompileContext* ctx;
+    const char* cursor;
+    const char* end;        // ctx->buffer + ctx->length; two NULs follow
+    int line;
+    const char* text;       // the last token, for dumps and --lex-diff
+    int length;
+    const ScanOps* ops;     // NULL when flex does the scanning
+    void* flex;
+} Scanner;
+
+// The default is picked once, whichever thread asks first
+static ScannerKind kind_in_use;
+static pthread_once_t kind_chosen = PTHREAD_ONCE_INIT;
+
+enum {
+    CLASS_BLANK = 1,        // ' ', '\t', '\n'
+    CLASS_START = 2,        // starts an identifier
+    CLASS_WORD = 4,         // continues one
+    CLASS_DIGIT = 8
+};
+
+static const uint8_t char_class[256] = {
+    [' '] = CLASS_BLANK, ['\t'] = CLASS_BLANK, ['\n'] = CLASS_BLANK,
+    ['a' ... 'z'] = CLASS_START | CLASS_WORD,
+    ['A' ... 'Z'] = CLASS_START | CLASS_WORD,
+    ['_'] = CLASS_START | CLASS_WORD,
+    ['0' ... '9'] = CLASS_WORD | CLASS_DIGIT,
+};
+
+typedef struct {
+    const char* text;
+    int length;
+    int token;
+    int value;              // for true and false
+    const char* name;
+} Keyword;
+
+// Perfect hash: each keyword sits at (first byte * 4 + length) % 16,
+// which no two of them share
+static const Keyword keywords[16] = {
+    [1]  = { "while", 5, WHILE,           0, "WHILE" },
+    [4]  = { "true",  4, BOOLEAN_LITERAL, 1, "BOOLEAN_LITERAL" },
+    [5]  = { "print", 5, PRINT,           0, "PRINT" },
+    [6]  = { "if",    2, IF,              0, "IF" },
+    [7]  = { "int",   3, INT_KEYWORD,     0, "INT_KEYWORD" },
+    [8]  = { "else",  4, ELSE,            0, "ELSE" },
+    [12] = { "bool",  4, BOOL_KEYWORD,    0, "BOOL_KEYWORD" },
+    [13] = { "false", 5, BOOLEAN_LITERAL, 0, "BOOLEAN_LITERAL" },
+};
+
+static const Keyword* find_keyword(const char* p, int length) {
+    if (length < 2 || length > 5) return NULL;
+    const Keyword* k = &keywords[(((unsigned char)p[0] << 2) + length) & 15];
+    return k->length == length && memcmp(k->text, p, length) == 0 ? k : NULL;
+}
+
+// ---- a byte at a time ----
+
+// The NUL at end stops these
+static const char* skip_blanks_scalar(const char* p, const char* end, int* line) {
+    while (char_class[(unsigned char)*p] & CLASS_BLANK) {
+        if (*p == '\n') (*line)++;
+        p++;
+    }
+    return p;
+}
+
+static const char* word_end_scalar(const char* p, const char* end) {
+    while (char_class[(unsigned char)*p] & CLASS_WORD) p++;
+    return p;
+}
+
+static const char* digits_end_scalar(const char* p, const char* end) {
+    while (char_class[(unsigned char)*p] & CLASS_DIGIT) p++;
+    return p;
+}
+
+static const char* line_end_scalar(const char* p, const char* end) {
+    const char* q = memchr(p, '\n', end - p);
+    return q ? q : end;
+}
+
+static const ScanOps scalar_ops = {
+    skip_blanks_scalar, word_end_scalar, digits_end_scalar, line_end_scalar
+};
+
+// ---- SIMD ----
+//
+// Blocks are loaded unaligned from p and only while a whole one fits
+// before end, so nothing outside the source is read; the scalar versions
+// finish the last partial block.
+
+#if SCANNER_X86
+
+static uint32_t blank_bits_sse2(__m128i v, uint32_t* newlines) {
+    __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    *newlines = (uint32_t)_mm_movemask_epi8(nl);
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(space, nl));
+}
+
+// Bytes >= 0x80 compare as negative, so they fall outside every range
+static __m128i in_range_sse2(__m128i v, char low, char high) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(low - 1)),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(high + 1)));
+}
+
+static uint32_t digit_bits_sse2(__m128i v) {
+    return (uint32_t)_mm_movemask_epi8(in_range_sse2(v, '0', '9'));
+}
+
+static uint32_t word_bits_sse2(__m128i v) {
+    __m128i letter = in_range_sse2(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i digit = in_range_sse2(v, '0', '9');
+    __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), underscore));
+}
+
+static const char* skip_blanks_sse2(const char* p, const char* end, int* line) {
+    for (; end - p >= 16; p += 16) {
+        uint32_t newlines;
+        uint32_t stop = ~blank_bits_sse2(_mm_loadu_si128((const __m128i*)p), &newlines) & 0xFFFFu;
+        if (stop) {
+            int at = __builtin_ctz(stop);
+            *line += __builtin_popcount(newlines & ((1u << at) - 1));
+            return p + at;
+        }
+        *line += __builtin_popcount(newlines);
+    }
+    return skip_blanks_scalar(p, end, line);
+}
+
+static const char* word_end_sse2(const char* p, const char* end) {
+    for (; end - p >= 16; p += 16) {
+        uint32_t stop = ~word_bits_sse2(_mm_loadu_si128((const __m128i*)p)) & 0xFFFFu;
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return word_end_scalar(p, end);
+}
+
+static const char* digits_end_sse2(const char* p, const char* end) {
+    for (; end - p >= 16; p += 16) {
+        uint32_t stop = ~digit_bits_sse2(_mm_loadu_si128((const __m128i*)p)) & 0xFFFFu;
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return digits_end_scalar(p, end);
+}
+
+static const char* line_end_sse2(const char* p, const char* end) {
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        uint32_t hits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        if (hits) return p + __builtin_ctz(hits);
+    }
+    return line_end_scalar(p, end);
+}
+
+static const ScanOps sse2_ops = {
+    skip_blanks_sse2, word_end_sse2, digits_end_sse2, line_end_sse2
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static uint32_t blank_bits_avx2(__m256i v, uint32_t* newlines) {
+    __m256i nl = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+    __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    *newlines = (uint32_t)_mm256_movemask_epi8(nl);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(space, nl));
+}
+
+AVX2 static __m256i in_range_avx2(__m256i v, char low, char high) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(low - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), v));
+}
+
+AVX2 static uint32_t digit_bits_avx2(__m256i v) {
+    return (uint32_t)_mm256_movemask_epi8(in_range_avx2(v, '0', '9'));
+}
+
+AVX2 static uint32_t word_bits_avx2(__m256i v) {
+    __m256i letter = in_range_avx2(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+    __m256i digit = in_range_avx2(v, '0', '9');
+    __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letter, digit), underscore));
+}
+
+AVX2 static const char* skip_blanks_avx2(const char* p, const char* end, int* line) {
+    for (; end - p >= 32; p += 32) {
+        uint32_t newlines;
+        uint32_t stop = ~blank_bits_avx2(_mm256_loadu_si256((const __m256i*)p), &newlines);
+        if (stop) {
+            int at = __builtin_ctz(stop);
+            *line += __builtin_popcount(newlines & ((1u << at) - 1));
+            return p + at;
+        }
+        *line += __builtin_popcount(newlines);
+    }
+    return skip_blanks_scalar(p, end, line);
+}
+
+AVX2 static const char* word_end_avx2(const char* p, const char* end) {
+    for (; end - p >= 32; p += 32) {
+        uint32_t stop = ~word_bits_avx2(_mm256_loadu_si256((const __m256i*)p));
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return word_end_scalar(p, end);
+}
+
+AVX2 static const char* digits_end_avx2(const char* p, const char* end) {
+    for (; end - p >= 32; p += 32) {
+        uint32_t stop = ~digit_bits_avx2(_mm256_loadu_si256((const __m256i*)p));
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return digits_end_scalar(p, end);
+}
+
+AVX2 static const char* line_end_avx2(const char* p, const char* end) {
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        uint32_t hits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        if (hits) return p + __builtin_ctz(hits);
+    }
+    return line_end_scalar(p, end);
+}
+
+static const ScanOps avx2_ops = {
+    skip_blanks_avx2, word_end_avx2, digits_end_avx2, line_end_avx2
+};
+
+#endif
+
+// ---- tokens ----
+
+// Most runs are a few bytes long, and for those a byte at a time beats
+// setting up a vector compare. The ops take over once a run gets longer.
+#define SHORT_RUN 4
+
+static const char* words_end(const ScanOps* ops, const char* p, const char* end) {
+    for (int i = 0; i < SHORT_RUN; i++, p++) {
+        if (!(char_class[(unsigned char)*p] & CLASS_WORD)) return p;
+    }
+    return ops->word_end(p, end);
+}
+
+static const char* digits_end(const ScanOps* ops, const char* p, const char* end) {
+    for (int i = 0; i < SHORT_RUN; i++, p++) {
+        if (!(char_class[(unsigned char)*p] & CLASS_DIGIT)) return p;
+    }
+    return ops->digits_end(p, end);
+}
+
+static const char* blanks_end(const ScanOps* ops, const char* p, const char* end, int* line) {
+    for (int i = 0; i < SHORT_RUN; i++, p++) {
+        if (!(char_class[(unsigned char)*p] & CLASS_BLANK)) return p;
+        if (*p == '\n') (*line)++;
+    }
+    return ops->skip_blanks(p, end, line);
+}
+
+// atoi() as lexer.l calls it: strtol, saturating at LONG_MAX, cut to int
+static int constant_value(const char* p, const char* end) {
+    unsigned long value = 0;
+    for (; p < end; p++) {
+        unsigned digit = (unsigned)(*p - '0');
+        if (value > ((unsigned long)LONG_MAX - digit) / 10) return (int)LONG_MAX;
+        value = value * 10 + digit;
+    }
+    return (int)value;
+}
+
+// Returns a token, echoing it first when the context asks for a token dump
+#define TOKEN(t) return token(s, start, p, t, #t)
+
+static int token(Scanner* s, const char* start, const char* p, int t, const char* name) {
+    s->cursor = p;
+    s->text = start;
+    s->length = (int)(p - start);
+    s->ctx->tokens++;
+    if (s->ctx->print_tokens) printf("%-20s %.*s\n", name, s->length, start);
+    return t;
+}
+
+static int next_token(Scanner* s, YYSTYPE* value) {
+    const ScanOps* ops = s->ops;
+    const char* p = s->cursor;
+    for (;;) {
+        p = blanks_end(ops, p, s->end, &s->line);
+        if (p[0] == '/' && p[1] == '/') {
+            p = ops->line_end(p + 2, s->end);
+            continue;
+        }
+        if (p >= s->end) {
+            s->cursor = p;
+            return 0;
+        }
+
+        const char* start = p;
+        unsigned char c = (unsigned char)*p++;
+        if (char_class[c] & CLASS_START) {
+            p = words_end(ops, p, s->end);
+            const Keyword* k = find_keyword(start, (int)(p - start));
+            if (k) {
+                if (k->token == BOOLEAN_LITERAL) value->ival = k->value;
+                return token(s, start, p, k->token, k->name);
+            }
+            value->id = intern(start, p - start);
+            TOKEN(IDENTIFIER);
+        }
+        if (char_class[c] & CLASS_DIGIT) {
+            p = digits_end(ops, p, s->end);
+            value->ival = constant_value(start, p);
+            TOKEN(CONSTANT);
+        }
+
+        switch (c) {
+            case '=':
+                if (*p != '=') TOKEN(ASSIGNMENT_OPERATOR);
+                p++;
+                value->op = OP_EQ;
+                TOKEN(COMPARISON_OPERATOR);
+            case '!':
+                if (*p != '=') break;
+                p++;
+                value->op = OP_NE;
+                TOKEN(COMPARISON_OPERATOR);
+            case '<':
+                value->op = *p == '=' ? (p++, OP_LE) : OP_LT;
+                TOKEN(COMPARISON_OPERATOR);
+            case '>':
+                value->op = *p == '=' ? (p++, OP_GE) : OP_GT;
+                TOKEN(COMPARISON_OPERATOR);
+            case '+': TOKEN(PLUS);
+            case '-': TOKEN(MINUS);
+            case '*': TOKEN(TIMES);
+            case '/': TOKEN(DIVIDE);
+            case '(': TOKEN(LEFT_PAREN);
+            case ')': TOKEN(RIGHT_PAREN);
+            case '{': TOKEN(LEFT_BRACE);
+            case '}': TOKEN(RIGHT_BRACE);
+            case ';': TOKEN(SEMICOLON);
+        }
+
+        // Same report as lexer.l's catch-all rule, then carry on after the byte
+        char text[2] = { (char)c, '\0' };
+        fprintf(diag_stream(), "Lexical Error: Unknown character '%s' at line %d\n", text, s->line);
+        s->ctx->syntax_errors++;
+    }
+}
+
+#undef TOKEN
+
+// ---- choosing a scanner ----
+
+static const char* kind_names[SCANNER_KIND_COUNT] = { "flex", "scalar", "sse2", "avx2" };
+
+const char* scanner_kind_name(ScannerKind kind) {
+    return kind >= 0 && kind < SCANNER_KIND_COUNT ? kind_names[kind] : "?";
+}
+
+int scanner_supported(ScannerKind kind) {
+    switch (kind) {
+        case SCANNER_FLEX:
+        case SCANNER_SCALAR:
+            return 1;
+#if SCANNER_X86
+        case SCANNER_SSE2:
+            return 1;
+        case SCANNER_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return 0;
+    }
+}
+
+ScannerKind scanner_best() {
+    if (scanner_supported(SCANNER_AVX2)) return SCANNER_AVX2;
+    if (scanner_supported(SCANNER_SSE2)) return SCANNER_SSE2;
+    return SCANNER_SCALAR;
+}
+
+int scanner_parse_kind(const char* name, ScannerKind* kind) {
+    if (strcmp(name, "auto") == 0) {
+        *kind = scanner_best();
+        return 0;
+    }
+    for (int k = 0; k < SCANNER_KIND_COUNT; k++) {
+        if (strcmp(name, kind_names[k]) == 0 && scanner_supported((ScannerKind)k)) {
+            *kind = (ScannerKind)k;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void choose_default_kind() {
+    kind_in_use = scanner_best();
+}
+
+void scanner_use(ScannerKind kind) {
+    pthread_once(&kind_chosen, choose_default_kind);
+    kind_in_use = kind;
+}
+
+ScannerKind scanner_in_use() {
+    pthread_once(&kind_chosen, choose_default_kind);
+    return kind_in_use;
+}
+
+static void scanner_open(Scanner* s, CompileContext* ctx, ScannerKind kind) {
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->cursor = ctx->buffer;
+    s->end = ctx->buffer + ctx->length;
+    s->line = 1;
+    switch (kind) {
+        case SCANNER_FLEX:
+            s->flex = flex_open(ctx);
+            break;
+#if SCANNER_X86
+        case SCANNER_SSE2:
+            s->ops = &sse2_ops;
+            break;
+        case SCANNER_AVX2:
+            s->ops = &avx2_ops;
+            break;
+#endif
+        default:
+            s->ops = &scalar_ops;
+            break;
+    }
+}
+
+static void scanner_close(Scanner* s) {
+    if (s->flex) flex_close(s->flex);
+    s->flex = NULL;
+}
+
+int yylex(YYSTYPE* value, void* scanner) {
+    Scanner* s = scanner;
+    if (s->flex) return flex_lex(value, s->flex);
+    return next_token(s, value);
+}
+
+int scanner_line(void* scanner) {
+    Scanner* s = scanner;
+    return s->flex ? flex_line(s->flex) : s->line;
+}
+
+int parse_context(CompileContext* ctx) {
+    Scanner s;
+    scanner_open(&s, ctx, scanner_in_use());
+    int result = yyparse(&s, ctx);
+    scanner_close(&s);
+    return result;
+}
+
+long scan_context(CompileContext* ctx) {
+    Scanner s;
+    scanner_open(&s, ctx, scanner_in_use());
+    YYSTYPE value;
+    long tokens = 0;
+    while (yylex(&value, &s) != 0) tokens++;
+    scanner_close(&s);
+    return tokens;
+}
+
+// ---- --lex-diff ----
+
+static const char* token_text(Scanner* s, int* length) {
+    if (s->flex) return flex_text(s->flex, length);
+    *length = s->length;
+    return s->text;
+}
+
+static int same_value(int token, const YYSTYPE* a, const YYSTYPE* b) {
+    switch (token) {
+        case IDENTIFIER:          return a->id == b->id;
+        case CONSTANT:
+        case BOOLEAN_LITERAL:     return a->ival == b->ival;
+        case COMPARISON_OPERATOR: return a->op == b->op;
+        default:                  return 1;
+    }
+}
+
+static int same_contents(FILE* a, FILE* b) {
+    rewind(a);
+    rewind(b);
+    int ca, cb;
+    do {
+        ca = getc(a);
+        cb = getc(b);
+    } while (ca == cb && ca != EOF);
+    return ca == cb;
+}
+
+int scanner_diff(CompileContext* ctx, ScannerKind kind) {
+    // Each side counts into its own copy of the context and reports its
+    // lexical errors into its own file. Flex writes a NUL after each token
+    // it returns, so the hand-written scanner reads its own copy of the text.
+    CompileContext flex_ctx = *ctx, hand_ctx = *ctx;
+    hand_ctx.buffer = malloc(ctx->length + 2);
+    if (!hand_ctx.buffer) {
+        fprintf(stderr, "Out of memory while comparing scanners\n");
+        exit(1);
+    }
+    memcpy(hand_ctx.buffer, ctx->buffer, ctx->length + 2);
+    flex_ctx.print_tokens = hand_ctx.print_tokens = 0;
+    flex_ctx.syntax_errors = hand_ctx.syntax_errors = 0;
+    FILE* flex_diag = tmpfile();
+    FILE* hand_diag = tmpfile();
+    if (!flex_diag || !hand_diag) {
+        perror("tmpfile");
+        exit(1);
+    }
+
+    Scanner flex, hand;
+    scanner_open(&flex, &flex_ctx, SCANNER_FLEX);
+    scanner_open(&hand, &hand_ctx, kind);
+    const char* name = scanner_kind_name(kind);
+    long tokens = 0;
+    int differs = 0;
+    for (;;) {
+        YYSTYPE a, b;
+        memset(&a, 0, sizeof(a));
+        memset(&b, 0, sizeof(b));
+        diag_redirect(flex_diag);
+        int ta = yylex(&a, &flex);
+        diag_redirect(hand_diag);
+        int tb = yylex(&b, &hand);
+        diag_redirect(NULL);
+
+        int la = 0, lb = 0;
+        const char* xa = ta ? token_text(&flex, &la) : "";
+        const char* xb = tb ? token_text(&hand, &lb) : "";
+        if (ta != tb || la != lb || memcmp(xa, xb, la) != 0 || !same_value(ta, &a, &b) ||
+            scanner_line(&flex) != scanner_line(&hand) ||
+            flex_ctx.syntax_errors != hand_ctx.syntax_errors) {
+            printf("Lex diff: flex and %s disagree at token %ld\n", name, tokens + 1);
+            printf("  flex: token %d '%.*s' at line %d, %d errors\n",
+                   ta, la, xa, scanner_line(&flex), flex_ctx.syntax_errors);
+            printf("  %s: token %d '%.*s' at line %d, %d errors\n",
+                   name, tb, lb, xb, scanner_line(&hand), hand_ctx.syntax_errors);
+            differs = 1;
+            break;
+        }
+        if (ta == 0) break;
+        tokens++;
+    }
+    if (!differs && !same_contents(flex_diag, hand_diag)) {
+        printf("Lex diff: flex and %s report lexical errors differently\n", name);
+        differs = 1;
+    }
+    if (!differs) {
+        printf("Lex diff: flex and %s agree on %ld tokens and %d lexical errors\n",
+               name, tokens, flex_ctx.syntax_errors);
+    }
+
+    scanner_close(&flex);
+    scanner_close(&hand);
+    fclose(flex_diag);
+    fclose(hand_diag);
+    free(hand_ctx.buffer);
+    return differs;
+}
@@ -0,0 +1,47 @@
+// scanner.h
+//
+// Picks the scanner parse_context and scan_context run on: the flex tables
+// from lexer.l, or the hand-written scanner in scanner.c. The hand-written
+// one produces the same tokens, values, line numbers and lexical errors.
+// It classifies 16 (SSE2) or 32 (AVX2) bytes at a time to skip blanks and
+// comments and to find where identifiers and constants end.
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include "context.h"
+
+typedef enum {
+    SCANNER_FLEX,       // lexer.l
+    SCANNER_SCALAR,     // hand-written, a byte at a time
+    SCANNER_SSE2,       // hand-written, 16 bytes at a time
+    SCANNER_AVX2,       // hand-written, 32 bytes at a time
+    SCANNER_KIND_COUNT
+} ScannerKind;
+
+const char* scanner_kind_name(ScannerKind kind);
+
+// Whether this CPU can run `kind`
+int scanner_supported(ScannerKind kind);
+
+// The widest hand-written scanner this CPU can run
+ScannerKind scanner_best();
+
+// Parses "flex", "scalar", "sse2", "avx2" or "auto" (scanner_best()).
+// Returns -1 for an unknown name or a scanner this CPU cannot run.
+int scanner_parse_kind(const char* name, ScannerKind* kind);
+
+// Scanner every later parse_context and scan_context uses; defaults to
+// scanner_best(). Set it before starting any compile threads.
+void scanner_use(ScannerKind kind);
+ScannerKind scanner_in_use();
+
+// Line the scanner handed to yyparse is on, for syntax errors
+int scanner_line(void* scanner);
+
+// Runs flex and `kind` over ctx->buffer in lockstep and compares every
+// token, its text, value and line, and the lexical errors. Prints the
+// first disagreement or a summary. Returns 0 when they agree.
+int scanner_diff(CompileContext* ctx, ScannerKind kind);
+
+#endif
@@ -0,0 +1,293 @@
+// sccp.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "sccp.h"
+#include "ssa.h"
+
+enum { TOP, CONSTANT, BOTTOM };    // lattice, highest first; values only move down
+
+typedef struct {
+    uint8_t state;
+    int32_t value;
+} Cell;
+
+static void* checked_calloc(size_t count, size_t size) {
+    void* ptr = calloc(count ? count : 1, size);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed for constant propagation\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+typedef struct {
+    const TacProgram* prog;
+    SsaForm ssa;
+    Cell* cells;            // one per SSA value
+    char* edge_live;        // block * 2 + successor slot
+    char* block_live;
+    int* edge_work;
+    int edge_top;
+    int* value_work;
+    int value_top;
+} Solver;
+
+static Cell operand_cell(const Solver* s, int use, uint8_t kind, int32_t value) {
+    if (kind == OPND_IMM) return (Cell){ CONSTANT, value };
+    if (use >= 0) return s->cells[use];
+    return (Cell){ BOTTOM, 0 };
+}
+
+static void lower(Solver* s, int v, Cell to) {
+    Cell* cell = &s->cells[v];
+    if (to.state <= cell->state) return;
+    *cell = to;
+    s->value_work[s->value_top++] = v;
+}
+
+static void mark_edge(Solver* s, int block, int target) {
+    BasicBlock* b = &s->ssa.cfg.blocks[block];
+    for (int slot = 0; slot < b->succ_count; slot++) {
+        if (b->succ[slot] != target) continue;
+        int edge = block * 2 + slot;
+        if (!s->edge_live[edge]) {
+            s->edge_live[edge] = 1;
+            s->edge_work[s->edge_top++] = edge;
+        }
+        return;
+    }
+}
+
+// Which way a conditional jump goes: 1 taken, 0 not taken, -1 either
+// (BOTTOM) and -2 not known yet (TOP)
+static int branch_outcome(const Solver* s, int i) {
+    const TACInstruction* ins = &s->prog->code[i];
+    Cell a = operand_cell(s, s->ssa.use_a[i], ins->a_kind, ins->a);
+    if (ins->op == TAC_IFGOTO) {
+        if (a.state != CONSTANT) return a.state == TOP ? -2 : -1;
+        return a.value != 0;
+    }
+    Cell b = operand_cell(s, s->ssa.use_b[i], ins->b_kind, ins->b);
+    if (a.state == BOTTOM || b.state == BOTTOM) return -1;
+    if (a.state == TOP || b.state == TOP) return -2;
+    int32_t taken;
+    tac_evaluate((TacOp)ins->op, a.value, b.value, &taken);
+    return taken;
+}
+
+static void visit_instruction(Solver* s, int i) {
+    const TACInstruction* ins = &s->prog->code[i];
+    int def = s->ssa.def[i];
+    if (def >= 0) {
+        Cell a = operand_cell(s, s->ssa.use_a[i], ins->a_kind, ins->a);
+        if (ins->op == TAC_COPY) {
+            lower(s, def, a);
+            return;
+        }
+        Cell b = operand_cell(s, s->ssa.use_b[i], ins->b_kind, ins->b);
+        int32_t result;
+        if (a.state == BOTTOM || b.state == BOTTOM) {
+            lower(s, def, (Cell){ BOTTOM, 0 });
+        } else if (a.state == CONSTANT && b.state == CONSTANT) {
+            if (tac_evaluate((TacOp)ins->op, a.value, b.value, &result)) {
+                lower(s, def, (Cell){ CONSTANT, result });
+            } else {
+                lower(s, def, (Cell){ BOTTOM, 0 });
+            }
+        }
+        return;
+    }
+    if (!tac_is_cond_jump((TacOp)ins->op)) return;
+
+    int block = s->ssa.instr_block[i];
+    int outcome = branch_outcome(s, i);
+    int taken = s->ssa.cfg.label_block[ins->dst];
+    if (outcome == 1 || outcome == -1) mark_edge(s, block, taken);
+    if (outcome == 0 || outcome == -1) mark_edge(s, block, block + 1);
+}
+
+// Meet of the arguments on edges known to run
+static void visit_phi(Solver* s, int p) {
+    const SsaForm* ssa = &s->ssa;
+    int block = ssa->phi_block[p];
+    Cell meet = { TOP, 0 };
+    for (int k = 0; k < ssa->phi_arg_start[p + 1] - ssa->phi_arg_start[p]; k++) {
+        if (!s->edge_live[ssa->pred_edge[ssa->pred_start[block] + k]]) continue;
+        int arg = ssa->phi_args[ssa->phi_arg_start[p] + k];
+        Cell c = arg >= 0 ? s->cells[arg] : (Cell){ BOTTOM, 0 };
+        if (c.state == TOP) continue;
+        if (meet.state == TOP) {
+            meet = c;
+        } else if (c.state == BOTTOM || c.value != meet.value) {
+            meet.state = BOTTOM;
+            break;
+        }
+    }
+    lower(s, ssa->phi_value[p], meet);
+}
+
+static void visit_block(Solver* s, int block) {
+    const SsaForm* ssa = &s->ssa;
+    for (int p = ssa->block_phi_start[block]; p < ssa->block_phi_start[block + 1]; p++) visit_phi(s, p);
+    if (s->block_live[block]) return;
+    s->block_live[block] = 1;
+
+    BasicBlock* b = &ssa->cfg.blocks[block];
+    for (int i = b->start; i < b->end; i++) visit_instruction(s, i);
+    if (b->end == b->start || !tac_is_cond_jump((TacOp)s->prog->code[b->end - 1].op)) {
+        for (int slot = 0; slot < b->succ_count; slot++) mark_edge(s, block, b->succ[slot]);
+    }
+}
+
+static void solve(Solver* s) {
+    const SsaForm* ssa = &s->ssa;
+    if (ssa->cfg.count > 0) visit_block(s, 0);
+
+    while (s->edge_top > 0 || s->value_top > 0) {
+        if (s->edge_top > 0) {
+            int edge = s->edge_work[--s->edge_top];
+            visit_block(s, ssa->cfg.blocks[edge / 2].succ[edge % 2]);
+            continue;
+        }
+        int v = s->value_work[--s->value_top];
+        for (int u = ssa->use_start[v]; u < ssa->use_start[v + 1]; u++) {
+            int user = ssa->users[u];
+            if (user < 0) {
+                int p = -user - 1;
+                if (s->block_live[ssa->phi_block[p]]) visit_phi(s, p);
+            } else if (s->block_live[ssa->instr_block[user]]) {
+                visit_instruction(s, user);
+            }
+        }
+    }
+}
+
+// A constant definition can go once its uses read the immediate, unless a
+// phi that is not constant merges it: the variable must then really hold it
+// at the join. That reaches through constant phis feeding such a phi.
+static char* find_needed(const Solver* s) {
+    const SsaForm* ssa = &s->ssa;
+    char* needed = checked_calloc(ssa->value_count, 1);
+    int* work = checked_calloc(ssa->phi_count, sizeof(int));
+    int top = 0;
+    for (int p = 0; p < ssa->phi_count; p++) {
+        if (s->block_live[ssa->phi_block[p]] && s->cells[ssa->phi_value[p]].state != CONSTANT) {
+            needed[ssa->phi_value[p]] = 1;
+            work[top++] = p;
+        }
+    }
+    while (top > 0) {
+        int p = work[--top];
+        int block = ssa->phi_block[p];
+        for (int k = 0; k < ssa->phi_arg_start[p + 1] - ssa->phi_arg_start[p]; k++) {
+            if (!s->edge_live[ssa->pred_edge[ssa->pred_start[block] + k]]) continue;
+            int arg = ssa->phi_args[ssa->phi_arg_start[p] + k];
+            if (arg < 0 || needed[arg]) continue;
+            needed[arg] = 1;
+            int site = ssa->value_site[arg];
+            if (site < 0 && site != SSA_ENTRY) work[top++] = -site - 1;
+        }
+    }
+    free(work);
+    return needed;
+}
+
+static int count_branches(const TacProgram* prog) {
+    int branches = 0;
+    for (int i = 0; i < prog->count; i++) branches += tac_is_cond_jump((TacOp)prog->code[i].op);
+    return branches;
+}
+
+void sccp_optimize(TacProgram* prog, SccpStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->before = prog->count;
+    stats->branches_before = count_branches(prog);
+
+    Solver s;
+    memset(&s, 0, sizeof(s));
+    s.prog = prog;
+    ssa_build(prog, &s.ssa);
+    SsaForm* ssa = &s.ssa;
+    stats->phis = ssa->phi_count;
+
+    int blocks = ssa->cfg.count;
+    s.cells = checked_calloc(ssa->value_count, sizeof(Cell));
+    for (int v = 0; v < ssa->name_count; v++) s.cells[v] = (Cell){ CONSTANT, 0 };  // zeroed on entry
+    s.edge_live = checked_calloc((size_t)blocks * 2, 1);
+    s.block_live = checked_calloc(blocks, 1);
+    s.edge_work = checked_calloc((size_t)blocks * 2, sizeof(int));
+    s.value_work = checked_calloc((size_t)ssa->value_count * 2, sizeof(int));
+    solve(&s);
+
+    char* needed = find_needed(&s);
+    char* keep = checked_calloc(prog->count, 1);
+    for (int b = 0; b < blocks; b++) {
+        BasicBlock* block = &ssa->cfg.blocks[b];
+        if (!s.block_live[b]) {
+            stats->blocks_removed++;
+            continue;
+        }
+        for (int i = block->start; i < block->end; i++) {
+            TACInstruction* ins = &prog->code[i];
+            keep[i] = 1;
+            int def = ssa->def[i];
+            if (def >= 0 && s.cells[def].state == CONSTANT) {
+                if (!needed[def]) {
+                    keep[i] = 0;
+                    stats->defs_removed++;
+                    continue;
+                }
+                if (ins->op != TAC_COPY || ins->a_kind != OPND_IMM) stats->constants++;
+                ins->op = TAC_COPY;
+                ins->a_kind = OPND_IMM;
+                ins->a = s.cells[def].value;
+                ins->b_kind = OPND_NONE;
+                ins->b = 0;
+                continue;
+            }
+
+            int outcome = tac_is_cond_jump((TacOp)ins->op) ? branch_outcome(&s, i) : -1;
+            if (ssa->use_a[i] >= 0 && s.cells[ssa->use_a[i]].state == CONSTANT) {
+                ins->a_kind = OPND_IMM;
+                ins->a = s.cells[ssa->use_a[i]].value;
+                stats->constants++;
+            }
+            if (ssa->use_b[i] >= 0 && s.cells[ssa->use_b[i]].state == CONSTANT) {
+                ins->b_kind = OPND_IMM;
+                ins->b = s.cells[ssa->use_b[i]].value;
+                stats->constants++;
+            }
+            if (outcome >= 0) {
+                stats->branches_resolved++;
+                if (outcome == 0) {
+                    keep[i] = 0;
+                } else {
+                    ins->op = TAC_GOTO;
+                    ins->a_kind = ins->b_kind = OPND_NONE;
+                    ins->a = ins->b = 0;
+                }
+            }
+        }
+    }
+
+    int out = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (keep[i]) prog->code[out++] = prog->code[i];
+    }
+    prog->count = out;
+
+    free(keep);
+    free(needed);
+    free(s.cells);
+    free(s.edge_live);
+    free(s.block_live);
+    free(s.edge_work);
+    free(s.value_work);
+    ssa_free(ssa);
+
+    stats->after = prog->count;
+    stats->branches_after = count_branches(prog);
+}
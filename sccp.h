@@ -0,0 +1,26 @@
+// sccp.h
+
+#ifndef SCCP_H
+#define SCCP_H
+
+#include "tac.h"
+
+typedef struct {
+    int before;             // instruction count going in
+    int after;              // instruction count coming out
+    int phis;               // phis the SSA form needed
+    int constants;          // operands and definitions replaced by the constant they hold
+    int defs_removed;       // constant definitions nothing reads any more
+    int branches_before;    // conditional jumps going in
+    int branches_after;
+    int branches_resolved;  // conditional jumps that always go the same way
+    int blocks_removed;     // blocks no executable edge reaches
+} SccpStats;
+
+// Sparse conditional constant propagation (Wegman and Zadeck) on the SSA
+// form of the program: values are constant until shown otherwise, and only
+// edges proven executable carry them. Constant operands become immediates,
+// decided branches become gotos or disappear, unreachable blocks go.
+void sccp_optimize(TacProgram* prog, SccpStats* stats);
+
+#endif
@@ -2,249 +2,524 @@
 #include <stdlib.h>
 #include <string.h>
 #include "semantic.h"
+#include "symtab.h"
+#include "intern.h"
+#include "trace.h"
+#include "walk.h"
+#include "context.h"
 
-typedef struct Symbol {
-    char* name;
-    Type type;
-    int scope_level;
-    struct Symbol* next;
-} Symbol;
+static _Thread_local SymbolTable symbols;
+static _Thread_local int symbols_ready = 0;
+static _Thread_local int error_count = 0;
 
-Symbol* symbol_table = NULL;
-
-int is_declared(const char* name) {
-    Symbol* curr = symbol_table;
-    while (curr) {
-        if (strcmp(curr->name, name) == 0) return 1;
-        curr = curr->next;
-    }
-    return 0;
+int is_declared(int name_id) {
+    return symtab_lookup(&symbols, name_id) != NULL;
 }
 
-void declare(const char* name, Type type, int scope) {
-    printf("DEBUG: Declaring symbol '%s' with type %d\n", name, type);
-    Symbol* sym = malloc(sizeof(Symbol));
-    if (!sym) {
-        fprintf(stderr, "Memory allocation failed for symbol\n");
-        exit(1);
-    }
-    sym->name = strdup(name);
-    sym->type = type;
-    sym->scope_level = scope;
-    sym->next = symbol_table;
-    symbol_table = sym;
-    printf("DEBUG: Symbol declared successfully\n");
+int declare(int name_id, Type type) {
+    TRACE(TRACE_SYMBOLS, TRACE_DEBUG, "Declaring symbol '%s' with type %d\n", intern_name(name_id), type);
+    Symbol* sym = symtab_insert(&symbols, name_id, type);
+    TRACE(TRACE_SYMBOLS, TRACE_DEBUG, "Symbol declared successfully\n");
+    return (int)(sym - symbols.symbols);
 }
 
 void semantic_error(const char* msg, const char* name) {
-    fprintf(stderr, "Semantic error: %s '%s'\n", msg, name);
-    exit(1);
+    fprintf(diag_stream(), "Semantic error: %s '%s'\n", msg, name);
+    error_count++;
 }
 
-Type get_type(ASTNode* node) {
+void semantic_begin() {
+    if (symbols_ready) symtab_clear(&symbols);
+    else symtab_init(&symbols);
+    symbols_ready = 1;
+    error_count = 0;
+}
+
+int semantic_end() {
+    return error_count;
+}
+
+void semantic_enter_scope() {
+    symtab_enter_scope(&symbols);
+}
+
+void semantic_leave_scope() {
+    symtab_leave_scope(&symbols);
+}
+
+// The walks below run on explicit stacks kept between calls, so nesting
+// depth costs heap memory instead of C stack.
+static _Thread_local WalkStack type_stack;
+static _Thread_local WalkStack check_stack;
+
+// A BINOP whose type is still to be worked out
+static int needs_walk(ASTNode* node) {
+    return node && node->type == NODE_BINOP && node->resolved_type == TYPE_UNKNOWN;
+}
+
+Type semantic_operand_type(ASTNode* node) {
     if (!node) {
-        printf("DEBUG: get_type called with NULL node\n");
+        TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "get_type called with NULL node\n");
         return TYPE_ERROR;
     }
+    if (node->resolved_type != TYPE_UNKNOWN) return node->resolved_type;
 
-    printf("DEBUG: get_type processing node of type %d\n", node->type);
+    TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "get_type processing node of type %d\n", node->type);
 
     switch (node->type) {
         case NODE_INT:
-            printf("DEBUG: get_type - found INT node with value %d\n", node->int_value);
-            return TYPE_INT;
+            TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "get_type - found INT node with value %d\n", node->int_value);
+            node->resolved_type = TYPE_INT;
+            break;
             
         case NODE_BOOL:
-            printf("DEBUG: get_type - found BOOL node with value %d\n", node->int_value);
-            return TYPE_BOOL;
+            TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "get_type - found BOOL node with value %d\n", node->int_value);
+            node->resolved_type = TYPE_BOOL;
+            break;
 
         case NODE_VAR: {
-            printf("DEBUG: get_type - checking variable '%s'\n", node->var_name);
-            if (!is_declared(node->var_name)) {
-                semantic_error("Use of undeclared variable", node->var_name);
-            }
-            Symbol* curr = symbol_table;
-            while (curr) {
-                if (strcmp(curr->name, node->var_name) == 0) {
-                    printf("DEBUG: get_type - variable '%s' has type %d\n", node->var_name, curr->type);
-                    return curr->type;
-                }
-                curr = curr->next;
+            TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "get_type - checking variable '%s'\n", intern_name(node->var_id));
+            Symbol* sym = symtab_lookup(&symbols, node->var_id);
+            if (!sym) {
+                semantic_error("Use of undeclared variable", intern_name(node->var_id));
+                node->resolved_type = TYPE_ERROR;
+                break;
             }
-            return TYPE_ERROR; // shouldn't happen
+            TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "get_type - variable '%s' has type %d\n", intern_name(node->var_id), sym->type);
+            node->var_symbol = (int)(sym - symbols.symbols);
+            node->resolved_type = sym->type;
+            break;
         }
 
-        case NODE_BINOP: {
-            printf("DEBUG: get_type - processing binary operation '%s'\n", node->binop.op);
-            Type left = get_type(node->binop.left);
-            Type right = get_type(node->binop.right);
-            if (left != TYPE_INT || right != TYPE_INT) {
-                fprintf(stderr, "Type error: binary operator applied to non-int\n");
-                exit(1);
-            }
-            return TYPE_INT;
+        default:
+            fprintf(diag_stream(), "Unknown expression type %d in type check\n", node->type);
+            node->resolved_type = TYPE_ERROR;
+            break;
+    }
+    return node->resolved_type;
+}
+
+static Type combine_types(Type left, Type right, int strict) {
+    if (left == TYPE_ERROR || right == TYPE_ERROR) return TYPE_ERROR;
+    if (left != TYPE_INT || right != TYPE_INT) {
+        if (strict) {
+            fprintf(diag_stream(), "Type error: binary operator applied to non-int\n");
+            error_count++;
         }
+        return TYPE_ERROR;
+    }
+    return TYPE_INT;
+}
 
-        case NODE_ASSIGN: {
-            printf("DEBUG: get_type - processing assignment to '%s'\n", node->assign.var_name);
-            Type rhs = get_type(node->assign.expr);
+Type semantic_binop_type(ASTNode* node, int strict) {
+    ASTNode* left = node->binop.left;
+    ASTNode* right = node->binop.right;
+    node->resolved_type = combine_types(left ? left->resolved_type : TYPE_ERROR,
+                                        right ? right->resolved_type : TYPE_ERROR, strict);
+    return node->resolved_type;
+}
 
-            Symbol* curr = symbol_table;
-            while (curr) {
-                if (strcmp(curr->name, node->assign.var_name) == 0) {
-                    if (curr->type != rhs) {
-                        semantic_error("Type mismatch in assignment to variable", curr->name);
-                    }
-                    return curr->type;
-                }
-                curr = curr->next;
+// A BINOP on the stack waits for its left subtree, or for its right one
+// once the left has been typed.
+enum { TYPE_WANT_LEFT, TYPE_WANT_RIGHT };
+
+// Post-order with a left-spine descent, like generate_expr. Operands are
+// typed in source order, so diagnostics come out as a recursive walk
+// would report them, and subtrees typed before are not entered again.
+static Type infer_type(ASTNode* node, int strict) {
+    if (!needs_walk(node)) return semantic_operand_type(node);
+
+    WalkStack* stack = &type_stack;
+    ASTNode* next = node;
+
+    for (;;) {
+        int right_done = 0;
+
+        if (next) {
+            node = next;
+            for (;;) {
+                TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "get_type processing node of type %d\n", node->type);
+                TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "get_type - processing binary operation '%s'\n", binop_symbol(node->binop.op));
+                if (!needs_walk(node->binop.left)) break;
+                walk_push(stack, node, TYPE_WANT_LEFT);
+                node = node->binop.left;
             }
+            semantic_operand_type(node->binop.left);
+        } else if (stack->count > 0) {
+            WalkFrame frame = walk_pop(stack);
+            node = frame.node;
+            right_done = frame.state == TYPE_WANT_RIGHT;
+        } else {
+            return node->resolved_type;
+        }
 
-            semantic_error("Assignment to undeclared variable", node->assign.var_name);
-            return TYPE_ERROR;
+        if (!right_done) {
+            if (needs_walk(node->binop.right)) {
+                walk_push(stack, node, TYPE_WANT_RIGHT);
+                next = node->binop.right;
+                continue;
+            }
+            semantic_operand_type(node->binop.right);
         }
 
+        semantic_binop_type(node, strict);
+        next = NULL;
+    }
+}
+
+Type get_type(ASTNode* node) {
+    return infer_type(node, 1);
+}
+
+void semantic_declare(ASTNode* node) {
+    TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node - processing declaration of '%s'\n", intern_name(node->decl.var_id));
+    if (is_declared(node->decl.var_id)) {
+        semantic_error("Variable redeclared", intern_name(node->decl.var_id));
+    }
+    node->decl.symbol = declare(node->decl.var_id, node->decl.declared_type);
+}
+
+void semantic_check_init(ASTNode* node) {
+    Type init_type = node->decl.init_value->resolved_type;
+    TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "Got type %d for initializer\n", init_type);
+    if (init_type != TYPE_ERROR && init_type != node->decl.declared_type) {
+        semantic_error("Type mismatch in initialization", intern_name(node->decl.var_id));
+    }
+}
+
+void semantic_check_assign(ASTNode* node) {
+    TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node - processing assignment to '%s'\n", intern_name(node->assign.var_id));
+    Symbol* sym = symtab_lookup(&symbols, node->assign.var_id);
+    if (!sym) {
+        semantic_error("Assignment to undeclared variable", intern_name(node->assign.var_id));
+        return;
+    }
+    node->assign.symbol = (int)(sym - symbols.symbols);
+}
+
+// Declarations, assignments, prints and bare expressions: nothing in
+// them can open a scope. Values that are stored are fully checked; the
+// operands of print only have to resolve.
+static void check_simple_node(ASTNode* node) {
+    TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node processing node of type %d\n", node->type);
+
+    switch (node->type) {
         case NODE_DECL:
-            printf("DEBUG: get_type - processing declaration of '%s' with type %d\n", 
-                  node->decl.var_name, node->decl.declared_type);
-            return node->decl.declared_type;
+            semantic_declare(node);
+            if (node->decl.init_value) {
+                TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "About to get type of initializer for %s, node type: %d\n", 
+                       intern_name(node->decl.var_id), node->decl.init_value->type);
+                TRACE(TRACE_SEMANTIC, TRACE_VERBOSE, "Initializer address: %p\n", (void*)node->decl.init_value);
+                infer_type(node->decl.init_value, 1);
+                semantic_check_init(node);
+            }
+            break;
+
+        case NODE_ASSIGN:
+            semantic_check_assign(node);
+            infer_type(node->assign.expr, 1);
+            break;
 
         case NODE_PRINT:
-            printf("DEBUG: get_type - processing print statement\n");
-            get_type(node->print_expr);
-            return TYPE_INT;
-
-        case NODE_IF:
-            printf("DEBUG: get_type - processing if statement\n");
-            get_type(node->if_stmt.condition);
-            get_type(node->if_stmt.if_body);
-            if (node->if_stmt.else_body)
-                get_type(node->if_stmt.else_body);
-            return TYPE_INT;
+            TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node - processing print statement\n");
+            infer_type(node->print_expr, 0);
+            break;
 
         default:
-            fprintf(stderr, "Unknown expression type %d in type check\n", node->type);
-            return TYPE_ERROR;
+            infer_type(node, 0);
+            break;
     }
 }
 
+// Statement lists resume at the index kept in `state`, so only nested
+// lists, IFs and WHILEs are pushed, and the walk descends into the last child it
+// queues through `current` rather than pushing it. Marker frames
+// (node == NULL) close the scope of an if branch or loop body, or open the
+// one of the else branch, once everything pushed above them is checked.
+enum { CHECK_ENTER_SCOPE = -1, CHECK_LEAVE_SCOPE = -2 };
+
 void check_node(ASTNode* node) {
+    WalkStack* stack = &check_stack;
+    int base = stack->count;
+    WalkFrame current = { node, 0, { 0, 0 } };
+
     if (!node) {
-        printf("DEBUG: check_node called with NULL node\n");
+        TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node called with NULL node\n");
         return;
     }
 
-    printf("DEBUG: check_node processing node of type %d\n", node->type);
+    for (;;) {
+        if (!current.node) {
+            if (stack->count == base) break;
+            current = walk_pop(stack);
+            if (current.state == CHECK_ENTER_SCOPE) {
+                symtab_enter_scope(&symbols);
+                current.node = NULL;
+                continue;
+            }
+            if (current.state == CHECK_LEAVE_SCOPE) {
+                symtab_leave_scope(&symbols);
+                current.node = NULL;
+                continue;
+            }
+        }
+        WalkFrame frame = current;
+        node = frame.node;
+        current.node = NULL;
+
+        switch (node->type) {
+            case NODE_STMT_LIST:
+                if (frame.state == 0) {
+                    TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node processing node of type %d\n", node->type);
+                    TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node - processing statement list with %d statements\n", 
+                           node->stmt_list.count);
+                }
+                for (int i = frame.state; i < node->stmt_list.count; i++) {
+                    ASTNode* stmt = node->stmt_list.stmts[i];
+                    if (!stmt) {
+                        TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node called with NULL node\n");
+                        continue;
+                    }
+                    if (stmt->type == NODE_IF || stmt->type == NODE_WHILE ||
+                        stmt->type == NODE_STMT_LIST) {
+                        if (i + 1 < node->stmt_list.count) walk_push(stack, node, i + 1);
+                        current.node = stmt;
+                        current.state = 0;
+                        break;
+                    }
+                    check_simple_node(stmt);
+                }
+                break;
 
-    switch (node->type) {
-        case NODE_STMT_LIST:
-            printf("DEBUG: check_node - processing statement list with %d statements\n", 
-                   node->stmt_list.count);
-            for (int i = 0; i < node->stmt_list.count; i++) {
-                check_node(node->stmt_list.stmts[i]);
+            case NODE_IF:
+                TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node processing node of type %d\n", node->type);
+                TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node - processing if statement\n");
+                infer_type(node->if_stmt.condition, 0);
+                if (node->if_stmt.else_body) {
+                    walk_push(stack, NULL, CHECK_LEAVE_SCOPE);
+                    walk_push(stack, node->if_stmt.else_body, 0);
+                    walk_push(stack, NULL, CHECK_ENTER_SCOPE);
+                }
+                walk_push(stack, NULL, CHECK_LEAVE_SCOPE);
+                symtab_enter_scope(&symbols);
+                if (node->if_stmt.if_body) {
+                    current.node = node->if_stmt.if_body;
+                    current.state = 0;
+                } else {
+                    TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node called with NULL node\n");
+                }
+                break;
+
+            case NODE_WHILE:
+                TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node processing node of type %d\n", node->type);
+                TRACE(TRACE_SEMANTIC, TRACE_DEBUG, "check_node - processing while statement\n");
+                infer_type(node->while_stmt.condition, 0);
+                walk_push(stack, NULL, CHECK_LEAVE_SCOPE);
+                symtab_enter_scope(&symbols);
+                current.node = node->while_stmt.body;
+                current.state = 0;
+                break;
+
+            default:
+                check_simple_node(node);
+                break;
+        }
+    }
+}
+
+// Operand types of the flat expression being scanned
+static _Thread_local Type* flat_types = NULL;
+static _Thread_local uint32_t flat_types_size = 0;
+
+// In post-order every operator comes after its operands, so an expression
+// is typed by one forward scan over its range with a stack of types.
+// Diagnostics come out in the same order as from infer_type.
+static Type flat_expr_type(const FlatAst* flat, uint32_t root, int strict) {
+    if (root == FLAT_NONE) return TYPE_ERROR;
+    uint32_t start = flat_expr_start(flat, root);
+    if (root - start + 1 > flat_types_size) {
+        flat_types_size = root - start + 1;
+        flat_types = realloc(flat_types, sizeof(Type) * flat_types_size);
+        if (!flat_types) {
+            fprintf(stderr, "Memory allocation failed for type stack\n");
+            exit(1);
+        }
+    }
+
+    Type* types = flat_types;
+    int depth = 0;
+    for (uint32_t i = start; i <= root; i++) {
+        int32_t value = flat->value[i];
+        switch ((NodeType)flat->kind[i]) {
+            case NODE_INT:
+                types[depth++] = TYPE_INT;
+                break;
+
+            case NODE_BOOL:
+                types[depth++] = TYPE_BOOL;
+                break;
+
+            case NODE_VAR: {
+                Symbol* sym = symtab_lookup(&symbols, value);
+                if (!sym) semantic_error("Use of undeclared variable", intern_name(value));
+                types[depth++] = sym ? sym->type : TYPE_ERROR;
+                break;
             }
-            break;
 
+            case NODE_BINOP:
+                depth--;
+                types[depth - 1] = combine_types(types[depth - 1], types[depth], strict);
+                break;
+
+            default:
+                fprintf(diag_stream(), "Unknown expression type %d in type check\n", flat->kind[i]);
+                types[depth++] = TYPE_ERROR;
+                break;
+        }
+    }
+    return types[0];
+}
+
+static void check_flat_simple(const FlatAst* flat, uint32_t node) {
+    int32_t name = flat->value[node];
+
+    switch ((NodeType)flat->kind[node]) {
         case NODE_DECL:
-            printf("DEBUG: check_node - processing declaration of '%s'\n", node->decl.var_name);
-            if (is_declared(node->decl.var_name)) {
-                semantic_error("Variable redeclared", node->decl.var_name);
-            }
-            declare(node->decl.var_name, node->decl.declared_type, 0);
-            if (node->decl.init_value) {
-                printf("DEBUG: About to get type of initializer for %s, node type: %d\n", 
-                       node->decl.var_name, node->decl.init_value->type);
-                printf("DEBUG: Initializer address: %p\n", (void*)node->decl.init_value);
-                Type init_type = get_type(node->decl.init_value);
-                printf("DEBUG: Got type %d for initializer\n", init_type);
-                if (init_type != node->decl.declared_type) {
-                    semantic_error("Type mismatch in initialization", node->decl.var_name);
+            if (is_declared(name)) semantic_error("Variable redeclared", intern_name(name));
+            declare(name, (Type)flat->rhs[node]);
+            if (flat->lhs[node] != FLAT_NONE) {
+                Type init_type = flat_expr_type(flat, flat->lhs[node], 1);
+                if (init_type != TYPE_ERROR && init_type != (Type)flat->rhs[node]) {
+                    semantic_error("Type mismatch in initialization", intern_name(name));
                 }
             }
             break;
 
         case NODE_ASSIGN:
-            printf("DEBUG: check_node - processing assignment to '%s'\n", node->assign.var_name);
-            if (!is_declared(node->assign.var_name)) {
-                semantic_error("Assignment to undeclared variable", node->assign.var_name);
-            }
-            get_type(node->assign.expr);
+            if (!is_declared(name)) semantic_error("Assignment to undeclared variable", intern_name(name));
+            flat_expr_type(flat, flat->lhs[node], 1);
             break;
 
         case NODE_PRINT:
-            printf("DEBUG: check_node - processing print statement\n");
-            check_node(node->print_expr);
+            flat_expr_type(flat, flat->lhs[node], 0);
             break;
 
-        case NODE_BINOP:
-            printf("DEBUG: check_node - processing binary operation\n");
-            check_node(node->binop.left);
-            check_node(node->binop.right);
+        default:
+            flat_expr_type(flat, node, 0);
             break;
+    }
+}
 
-        case NODE_IF:
-            printf("DEBUG: check_node - processing if statement\n");
-            check_node(node->if_stmt.condition);
-            check_node(node->if_stmt.if_body);
-            if (node->if_stmt.else_body)
-                check_node(node->if_stmt.else_body);
-            break;
+// The statement walk of check_node over a FlatAst. Frames carry the node
+// index in data[0]; a statement list resumes at the position in `state`,
+// and negative states are the scope markers.
+int semantic_check_flat(const FlatAst* flat) {
+    TRACE(TRACE_SEMANTIC, TRACE_INFO, "Starting semantic check...\n");
+    semantic_begin();
+    if (flat->count == 0) return semantic_end();
+
+    WalkStack* stack = &check_stack;
+    walk_push(stack, NULL, 0)->data[0] = (int32_t)(flat->count - 1);
 
-        case NODE_VAR:
-            printf("DEBUG: check_node - processing variable '%s'\n", node->var_name);
-            if (!is_declared(node->var_name)) {
-                semantic_error("Use of undeclared variable", node->var_name);
+    while (stack->count > 0) {
+        WalkFrame frame = walk_pop(stack);
+        if (frame.state == CHECK_ENTER_SCOPE) {
+            symtab_enter_scope(&symbols);
+            continue;
+        }
+        if (frame.state == CHECK_LEAVE_SCOPE) {
+            symtab_leave_scope(&symbols);
+            continue;
+        }
+        uint32_t node = (uint32_t)frame.data[0];
+
+        switch ((NodeType)flat->kind[node]) {
+            case NODE_STMT_LIST: {
+                const uint32_t* items = flat->items + flat->lhs[node];
+                uint32_t count = flat->rhs[node];
+                for (uint32_t i = (uint32_t)frame.state; i < count; i++) {
+                    uint8_t kind = flat->kind[items[i]];
+                    if (kind == NODE_IF || kind == NODE_WHILE || kind == NODE_STMT_LIST) {
+                        if (i + 1 < count) walk_push(stack, NULL, (int)(i + 1))->data[0] = (int32_t)node;
+                        walk_push(stack, NULL, 0)->data[0] = (int32_t)items[i];
+                        break;
+                    }
+                    check_flat_simple(flat, items[i]);
+                }
+                break;
             }
-            break;
 
-        case NODE_INT:
-            printf("DEBUG: check_node - processing integer value: %d\n", node->int_value);
-            break;
-            
-        case NODE_BOOL:
-            printf("DEBUG: check_node - processing boolean value: %d\n", node->int_value);
-            break;
+            case NODE_IF:
+                flat_expr_type(flat, flat->lhs[node], 0);
+                if ((uint32_t)flat->value[node] != FLAT_NONE) {
+                    walk_push(stack, NULL, CHECK_LEAVE_SCOPE);
+                    walk_push(stack, NULL, 0)->data[0] = flat->value[node];
+                    walk_push(stack, NULL, CHECK_ENTER_SCOPE);
+                }
+                walk_push(stack, NULL, CHECK_LEAVE_SCOPE);
+                walk_push(stack, NULL, 0)->data[0] = (int32_t)flat->rhs[node];
+                symtab_enter_scope(&symbols);
+                break;
 
-        default:
-            fprintf(stderr, "Unknown node type %d\n", node->type);
-            break;
+            case NODE_WHILE:
+                flat_expr_type(flat, flat->lhs[node], 0);
+                walk_push(stack, NULL, CHECK_LEAVE_SCOPE);
+                walk_push(stack, NULL, 0)->data[0] = (int32_t)flat->rhs[node];
+                symtab_enter_scope(&symbols);
+                break;
+
+            default:
+                check_flat_simple(flat, node);
+                break;
+        }
     }
+
+    TRACE(TRACE_SEMANTIC, TRACE_INFO, "Semantic check completed.\n");
+    return semantic_end();
 }
 
-void semantic_check(ASTNode* root) {
-    printf("Starting semantic check...\n");
+int semantic_check(ASTNode* root) {
+    TRACE(TRACE_SEMANTIC, TRACE_INFO, "Starting semantic check...\n");
     if (!root) {
-        printf("ERROR: semantic_check received NULL root\n");
-        return;
+        fprintf(stderr, "semantic_check received NULL root\n");
+        return 1;
     }
-    printf("Root node type: %d\n", root->type);
+    TRACE(TRACE_SEMANTIC, TRACE_VERBOSE, "Root node type: %d\n", root->type);
+
+    semantic_begin();
     
     // If it's a statement list, let's print debug info about it
     if (root->type == NODE_STMT_LIST) {
-        printf("Statement list has %d statements\n", root->stmt_list.count);
+        TRACE(TRACE_SEMANTIC, TRACE_VERBOSE, "Statement list has %d statements\n", root->stmt_list.count);
         for (int i = 0; i < root->stmt_list.count; i++) {
             if (root->stmt_list.stmts[i]) {
-                printf("Statement %d has type %d\n", i, root->stmt_list.stmts[i]->type);
+                TRACE(TRACE_SEMANTIC, TRACE_VERBOSE, "Statement %d has type %d\n", i, root->stmt_list.stmts[i]->type);
             } else {
-                printf("Statement %d is NULL\n", i);
+                TRACE(TRACE_SEMANTIC, TRACE_VERBOSE, "Statement %d is NULL\n", i);
             }
         }
     }
     
     check_node(root);
-    printf("Semantic check completed.\n");
+    TRACE(TRACE_SEMANTIC, TRACE_INFO, "Semantic check completed.\n");
+    return semantic_end();
 }
 
 void print_symbol_table() {
     printf("Symbol Table:\n");
     printf("%-10s | %-5s | %-5s\n", "Name", "Type", "Scope");
     printf("-----------------------------\n");
-    Symbol* curr = symbol_table;
-    while (curr) {
-        const char* type_str = (curr->type == TYPE_INT) ? "int" :
-                       (curr->type == TYPE_BOOL) ? "bool" : "unknown";
+    // Newest first, as the old linked list printed them
+    for (int i = symbols.count - 1; i >= 0; i--) {
+        Symbol* sym = &symbols.symbols[i];
+        const char* type_str = (sym->type == TYPE_INT) ? "int" :
+                       (sym->type == TYPE_BOOL) ? "bool" : "unknown";
+        char scope_str[16];
+        if (sym->scope_level == 0)
+            snprintf(scope_str, sizeof(scope_str), "global");
+        else
+            snprintf(scope_str, sizeof(scope_str), "%d", sym->scope_level);
 
-        printf("%-10s | %-5s | %-5s\n", curr->name, type_str, "global"); // only one scope for now
-        curr = curr->next;
+        printf("%-10s | %-5s | %-5s\n", intern_name(sym->name_id), type_str, scope_str);
     }
 }
@@ -2,10 +2,29 @@
 #define SEMANTIC_H
 
 #include "ast.h"
+#include "flatast.h"
 
-void semantic_check(ASTNode* root);
+// Returns the number of errors reported
+int semantic_check(ASTNode* root);
+// The same checks over the flat layout; nothing is cached on it
+int semantic_check_flat(const FlatAst* flat);
 Type get_type(ASTNode* node);
 void check_node(ASTNode* node);
 void print_symbol_table();
 
+// Hooks for checking while another walk (generate_code_checked) visits
+// the tree. Types land in each node's resolved_type and variables are
+// bound to their symbol index; a node that already has a type is taken
+// as it is.
+void semantic_begin();
+int semantic_end();                     // number of errors reported
+void semantic_enter_scope();
+void semantic_leave_scope();
+Type semantic_operand_type(ASTNode* node);
+// Children must be typed first; non-strict only resolves, as for print
+Type semantic_binop_type(ASTNode* node, int strict);
+void semantic_declare(ASTNode* decl);
+void semantic_check_init(ASTNode* decl);
+void semantic_check_assign(ASTNode* assign);
+
 #endif
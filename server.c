@@ -0,0 +1,402 @@
+// server.c
+//
+// The listener hands each accepted connection to a queue; a fixed pool of
+// workers takes connections from it and answers their requests one after
+// the other. Compiler state is thread-local, so a worker resets its arenas
+// and tables between requests rather than freeing them, and keeps its
+// source, TAC and diagnostic buffers for the next one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "server.h"
+#include "context.h"
+#include "ast.h"
+#include "intern.h"
+#include "tac.h"
+#include "trace.h"
+
+// Percentiles cover the latest requests only, so memory stays bounded
+#define LATENCY_WINDOW 65536
+
+// A socket connection that sends nothing, or stops reading its responses,
+// for this long is closed so it cannot hold a worker forever
+#define IDLE_TIMEOUT_SECONDS 30
+
+typedef struct {
+    pthread_mutex_t lock;
+    double samples[LATENCY_WINDOW];     // seconds, a ring
+    long requests;
+    long failed;
+    double total;
+    double max;
+} LatencyLog;
+
+// Accepted connections waiting for a worker
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    int* fds;
+    int head;
+    int count;
+    int capacity;
+} ConnectionQueue;
+
+// What a worker keeps from one request to the next
+typedef struct {
+    char* source;
+    size_t source_capacity;
+    TacProgram tac;
+    FILE* tac_out;              // memory streams, rewound per request
+    char* tac_buffer;
+    size_t tac_size;
+    FILE* diag;
+    char* diag_buffer;
+    size_t diag_size;
+} Session;
+
+static const BatchOptions* options;
+static LatencyLog latency = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static ConnectionQueue connections = {
+    .lock = PTHREAD_MUTEX_INITIALIZER, .ready = PTHREAD_COND_INITIALIZER
+};
+static volatile sig_atomic_t stopping = 0;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void record_latency(double seconds, int failed) {
+    pthread_mutex_lock(&latency.lock);
+    latency.samples[latency.requests % LATENCY_WINDOW] = seconds;
+    latency.requests++;
+    latency.failed += failed;
+    latency.total += seconds;
+    if (seconds > latency.max) latency.max = seconds;
+    pthread_mutex_unlock(&latency.lock);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double* sorted, long count, double p) {
+    if (count == 0) return 0;
+    long rank = (long)(p * count + 0.999999);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static void write_latency_report(FILE* out) {
+    static double sorted[LATENCY_WINDOW];
+    static pthread_mutex_t sorted_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&sorted_lock);
+    pthread_mutex_lock(&latency.lock);
+    long requests = latency.requests, failed = latency.failed;
+    double total = latency.total, max = latency.max;
+    long count = requests < LATENCY_WINDOW ? requests : LATENCY_WINDOW;
+    memcpy(sorted, latency.samples, sizeof(double) * count);
+    pthread_mutex_unlock(&latency.lock);
+
+    qsort(sorted, count, sizeof(double), compare_doubles);
+    fprintf(out, "requests %ld\nfailed %ld\n", requests, failed);
+    fprintf(out, "mean_ms %.3f\n", requests ? total / requests * 1e3 : 0.0);
+    fprintf(out, "p50_ms %.3f\np90_ms %.3f\np99_ms %.3f\np999_ms %.3f\n",
+            percentile(sorted, count, 0.50) * 1e3, percentile(sorted, count, 0.90) * 1e3,
+            percentile(sorted, count, 0.99) * 1e3, percentile(sorted, count, 0.999) * 1e3);
+    fprintf(out, "max_ms %.3f\n", max * 1e3);
+    pthread_mutex_unlock(&sorted_lock);
+}
+
+static void session_init(Session* s) {
+    memset(s, 0, sizeof(*s));
+    tac_init(&s->tac);
+    s->tac_out = open_memstream(&s->tac_buffer, &s->tac_size);
+    s->diag = open_memstream(&s->diag_buffer, &s->diag_size);
+    if (!s->tac_out || !s->diag) {
+        perror("open_memstream");
+        exit(1);
+    }
+}
+
+static void session_free(Session* s) {
+    fclose(s->tac_out);
+    fclose(s->diag);
+    free(s->tac_buffer);
+    free(s->diag_buffer);
+    free(s->source);
+    tac_free(&s->tac);
+}
+
+// Room for `length` bytes of source and the two NULs flex scans up to.
+// `length` is at most SERVER_MAX_REQUEST; NULL if memory ran out, which
+// fails the request rather than the server.
+static char* source_buffer(Session* s, size_t length) {
+    if (length + 2 > s->source_capacity) {
+        size_t capacity = length + 2 > 2 * s->source_capacity ? length + 2 : 2 * s->source_capacity;
+        char* source = realloc(s->source, capacity);
+        if (!source) return NULL;
+        s->source = source;
+        s->source_capacity = capacity;
+    }
+    return s->source;
+}
+
+// Replies ERROR with a one-line message
+static void reply_error(FILE* out, const char* message) {
+    fprintf(out, "ERROR %zu\n%s\n", strlen(message) + 1, message);
+    fflush(out);
+}
+
+// Compiles s->source[0, length), or the file at `path` when it is not
+// NULL. On success the TAC is in tac_buffer; diagnostics are in
+// diag_buffer either way. Returns nonzero on failure.
+static int compile_request(Session* s, const char* path, size_t length,
+                           long* tac_length, long* diag_length) {
+    fseek(s->tac_out, 0, SEEK_SET);
+    fseek(s->diag, 0, SEEK_SET);
+    diag_redirect(s->diag);
+
+    CompileContext ctx;
+    int failed = 0;
+    if (path) {
+        if (context_load(&ctx, path) != 0) {
+            fprintf(s->diag, "Cannot read '%s'\n", path);
+            failed = 1;
+        }
+    } else {
+        memset(&ctx, 0, sizeof(ctx));
+        s->source[length] = s->source[length + 1] = '\0';
+        ctx.buffer = s->source;
+        ctx.length = length;
+    }
+
+    if (!failed) {
+        parse_context(&ctx);
+        if (path) context_release(&ctx);
+        failed = ctx.syntax_errors > 0 || !ctx.root;
+        if (!failed) failed = batch_compile_tree(ctx.root, &s->tac, options, NULL);
+        if (!failed) tac_write(&s->tac, s->tac_out);
+    }
+
+    // Variable names in the TAC point into the intern table, so this comes last
+    ast_arena_reset();
+    intern_reset();
+    diag_redirect(NULL);
+
+    *tac_length = failed ? 0 : ftell(s->tac_out);
+    *diag_length = ftell(s->diag);
+    fflush(s->tac_out);
+    fflush(s->diag);
+    return failed;
+}
+
+static void serve_connection(Session* s, FILE* in, FILE* out) {
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        char verb[16];
+        size_t length;
+        if (sscanf(line, "%15s %zu", verb, &length) != 2) {
+            reply_error(out, "Malformed request header");
+            break;
+        }
+
+        if (strcmp(verb, "STATS") == 0) {
+            char* report = NULL;
+            size_t report_size = 0;
+            FILE* f = open_memstream(&report, &report_size);
+            if (!f) break;
+            write_latency_report(f);
+            fclose(f);
+            fprintf(out, "STATS %zu\n", report_size);
+            fwrite(report, 1, report_size, out);
+            free(report);
+            fflush(out);
+            continue;
+        }
+
+        int is_file = strcmp(verb, "FILE") == 0;
+        if (!is_file && strcmp(verb, "SOURCE") != 0) {
+            fprintf(out, "ERROR %zu\nUnknown request '%s'\n", strlen(verb) + 19, verb);
+            break;
+        }
+        // The payload is not read, so the connection cannot continue
+        if (length > SERVER_MAX_REQUEST) {
+            reply_error(out, "Request too large");
+            break;
+        }
+        char* payload = source_buffer(s, length);
+        if (!payload) {
+            reply_error(out, "Out of memory for request");
+            break;
+        }
+        if (fread(payload, 1, length, in) != length) break;
+        payload[length] = '\0';
+
+        double start = now_seconds();
+        long tac_length, diag_length;
+        int failed = compile_request(s, is_file ? payload : NULL, length, &tac_length, &diag_length);
+        if (failed) {
+            fprintf(out, "ERROR %ld\n", diag_length);
+        } else {
+            fprintf(out, "OK %ld %ld\n", tac_length, diag_length);
+            fwrite(s->tac_buffer, 1, tac_length, out);
+        }
+        fwrite(s->diag_buffer, 1, diag_length, out);
+        fflush(out);
+        record_latency(now_seconds() - start, failed);
+    }
+}
+
+static int take_connection() {
+    pthread_mutex_lock(&connections.lock);
+    while (connections.count == 0) pthread_cond_wait(&connections.ready, &connections.lock);
+    int fd = connections.fds[connections.head];
+    connections.head = (connections.head + 1) % connections.capacity;
+    connections.count--;
+    pthread_mutex_unlock(&connections.lock);
+    return fd;
+}
+
+static void queue_connection(int fd) {
+    pthread_mutex_lock(&connections.lock);
+    if (connections.count == connections.capacity) {
+        int capacity = connections.capacity ? connections.capacity * 2 : 64;
+        int* fds = malloc(sizeof(int) * capacity);
+        if (!fds) {
+            fprintf(stderr, "Memory allocation failed for connection queue\n");
+            exit(1);
+        }
+        for (int i = 0; i < connections.count; i++) {
+            fds[i] = connections.fds[(connections.head + i) % connections.capacity];
+        }
+        free(connections.fds);
+        connections.fds = fds;
+        connections.head = 0;
+        connections.capacity = capacity;
+    }
+    connections.fds[(connections.head + connections.count) % connections.capacity] = fd;
+    connections.count++;
+    pthread_cond_signal(&connections.ready);
+    pthread_mutex_unlock(&connections.lock);
+}
+
+static void set_idle_timeout(int fd) {
+    struct timeval timeout = { IDLE_TIMEOUT_SECONDS, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static void* worker_main(void* arg) {
+    Session session;
+    session_init(&session);
+    for (;;) {
+        int fd = take_connection();
+        // A read or write that times out ends the connection like EOF
+        set_idle_timeout(fd);
+        int out_fd = dup(fd);
+        FILE* in = fdopen(fd, "r");
+        FILE* out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+        if (in && out) serve_connection(&session, in, out);
+        if (in) fclose(in); else close(fd);
+        if (out) fclose(out); else if (out_fd >= 0) close(out_fd);
+    }
+    return NULL;
+}
+
+static void on_stop(int sig) {
+    stopping = 1;
+}
+
+int serve(const char* socket_path, const BatchOptions* opts) {
+    options = opts;
+    // Traces would land in the protocol stream
+    trace_mask = 0;
+    // A client that hangs up must not take the server with it
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!socket_path) {
+        Session session;
+        session_init(&session);
+        serve_connection(&session, stdin, stdout);
+        session_free(&session);
+        write_latency_report(stderr);
+        return 0;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 128) != 0) {
+        perror(socket_path);
+        close(listener);
+        return 1;
+    }
+
+    // Only the listener sees the stop signals, so they interrupt accept()
+    struct sigaction stop;
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = on_stop;
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    sigset_t blocked, saved;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+
+    int workers = opts->threads < 1 ? 1 : opts->threads;
+    for (int i = 0; i < workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, NULL) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+        pthread_detach(thread);
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    printf("Serving on %s with %d workers\n", socket_path, workers);
+    fflush(stdout);
+
+    while (!stopping) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            break;
+        }
+        queue_connection(fd);
+    }
+
+    // Open connections are dropped when the process exits
+    close(listener);
+    unlink(socket_path);
+    write_latency_report(stdout);
+    return 0;
+}
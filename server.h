@@ -0,0 +1,34 @@
+// server.h
+//
+// Compile server: the compiler stays resident, so a compile skips process
+// startup and runs on warm arenas, tables and buffers. Clients speak a
+// framed protocol over a Unix domain socket, or over standard input and
+// output for a single client:
+//
+//   request    SOURCE <n>\n<n bytes of source>    compile the bytes
+//              FILE <n>\n<n bytes of path>        compile a file the server reads
+//              STATS 0\n                          latency report
+//   response   OK <t> <d>\n<t bytes of TAC><d bytes of warnings>
+//              ERROR <d>\n<d bytes of diagnostics>
+//              STATS <n>\n<n bytes of "name value" lines>
+//
+// A connection may send any number of requests and ends at EOF. Each
+// connection is served start to end by one worker of the pool. A request
+// longer than SERVER_MAX_REQUEST bytes is answered with ERROR and ends its
+// connection. A socket connection idle for 30 seconds is closed.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "batch.h"
+
+// Largest SOURCE or FILE payload a request may announce
+#define SERVER_MAX_REQUEST ((size_t)256 << 20)
+
+// Serves until SIGINT or SIGTERM (socket) or end of input (stdio), then
+// prints the latency report. `socket_path` NULL means standard input and
+// output; options->threads is the pool size. Returns 0 unless the server
+// could not start.
+int serve(const char* socket_path, const BatchOptions* options);
+
+#endif
@@ -0,0 +1,480 @@
+// ssa.c
+//
+// Construction follows Cooper, Harvey and Kennedy for dominators and
+// dominance frontiers, Briggs' semi-pruned phi placement, and the usual
+// renaming walk over the dominator tree, all on explicit stacks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssa.h"
+
+static void* checked_malloc(size_t size) {
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed for SSA form\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static int* new_ints(size_t count, int fill) {
+    int* ints = checked_malloc(sizeof(int) * count);
+    for (size_t i = 0; i < count; i++) ints[i] = fill;
+    return ints;
+}
+
+int ssa_name(const TacProgram* prog, TacOperand o) {
+    if (o.kind == OPND_VAR) return o.value;
+    if (o.kind == OPND_TEMP) return prog->var_count + o.value;
+    return SSA_NONE;
+}
+
+static int defines(const TACInstruction* ins) {
+    return (ins->op == TAC_COPY || tac_is_binop((TacOp)ins->op)) &&
+           (ins->dst_kind == OPND_VAR || ins->dst_kind == OPND_TEMP);
+}
+
+static void build_preds(SsaForm* ssa) {
+    int n = ssa->cfg.count;
+    ssa->pred_start = new_ints(n + 1, 0);
+    for (int b = 0; b < n; b++) {
+        for (int s = 0; s < ssa->cfg.blocks[b].succ_count; s++) ssa->pred_start[ssa->cfg.blocks[b].succ[s] + 1]++;
+    }
+    for (int b = 0; b < n; b++) ssa->pred_start[b + 1] += ssa->pred_start[b];
+
+    int edges = ssa->pred_start[n];
+    ssa->preds = new_ints(edges, 0);
+    ssa->pred_edge = new_ints(edges, 0);
+    int* fill = new_ints(n, 0);
+    for (int b = 0; b < n; b++) {
+        for (int s = 0; s < ssa->cfg.blocks[b].succ_count; s++) {
+            int to = ssa->cfg.blocks[b].succ[s];
+            int slot = ssa->pred_start[to] + fill[to]++;
+            ssa->preds[slot] = b;
+            ssa->pred_edge[slot] = b * 2 + s;
+        }
+    }
+    free(fill);
+}
+
+// Depth-first from the entry; postorder reversed
+static void order_blocks(SsaForm* ssa, int* rpo_index) {
+    int n = ssa->cfg.count;
+    int* stack = new_ints(n, 0);
+    int* next_succ = new_ints(n, 0);
+    char* seen = calloc(n ? n : 1, 1);
+    int* post = new_ints(n, 0);
+    if (!seen) {
+        fprintf(stderr, "Memory allocation failed for SSA form\n");
+        exit(1);
+    }
+    int top = 0, post_count = 0;
+    if (n > 0) {
+        stack[top++] = 0;
+        seen[0] = 1;
+    }
+    while (top > 0) {
+        int b = stack[top - 1];
+        BasicBlock* block = &ssa->cfg.blocks[b];
+        if (next_succ[b] < block->succ_count) {
+            int s = block->succ[next_succ[b]++];
+            if (!seen[s]) {
+                seen[s] = 1;
+                stack[top++] = s;
+            }
+            continue;
+        }
+        post[post_count++] = b;
+        top--;
+    }
+
+    ssa->rpo = new_ints(post_count, 0);
+    ssa->rpo_count = post_count;
+    for (int i = 0; i < post_count; i++) {
+        ssa->rpo[i] = post[post_count - 1 - i];
+        rpo_index[ssa->rpo[i]] = i;
+    }
+    free(stack);
+    free(next_succ);
+    free(seen);
+    free(post);
+}
+
+static int intersect(const int* idom, const int* rpo_index, int a, int b) {
+    while (a != b) {
+        while (rpo_index[a] > rpo_index[b]) a = idom[a];
+        while (rpo_index[b] > rpo_index[a]) b = idom[b];
+    }
+    return a;
+}
+
+static void find_dominators(SsaForm* ssa, const int* rpo_index) {
+    ssa->idom = new_ints(ssa->cfg.count, SSA_NONE);
+    if (ssa->rpo_count == 0) return;
+    ssa->idom[0] = 0;      // so intersect stops at the entry
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < ssa->rpo_count; i++) {
+            int b = ssa->rpo[i];
+            int dom = SSA_NONE;
+            for (int p = ssa->pred_start[b]; p < ssa->pred_start[b + 1]; p++) {
+                int pred = ssa->preds[p];
+                if (ssa->idom[pred] == SSA_NONE) continue;
+                dom = dom == SSA_NONE ? pred : intersect(ssa->idom, rpo_index, pred, dom);
+            }
+            if (dom != ssa->idom[b]) {
+                ssa->idom[b] = dom;
+                changed = 1;
+            }
+        }
+    }
+}
+
+// Dominance frontiers as lists: block b's are df[df_start[b] .. df_start[b + 1])
+static void find_frontiers(const SsaForm* ssa, int** df_start_out, int** df_out) {
+    int n = ssa->cfg.count;
+    int capacity = n + 16, count = 0;
+    int* from = checked_malloc(sizeof(int) * capacity);
+    int* to = checked_malloc(sizeof(int) * capacity);
+    int* last = new_ints(n, SSA_NONE);
+
+    for (int i = 0; i < ssa->rpo_count; i++) {
+        int b = ssa->rpo[i];
+        if (ssa->pred_start[b + 1] - ssa->pred_start[b] < 2) continue;
+        for (int p = ssa->pred_start[b]; p < ssa->pred_start[b + 1]; p++) {
+            int runner = ssa->preds[p];
+            if (runner != 0 && ssa->idom[runner] == SSA_NONE) continue;     // unreachable
+            while (runner != ssa->idom[b] && last[runner] != b) {
+                if (count == capacity) {
+                    capacity *= 2;
+                    from = realloc(from, sizeof(int) * capacity);
+                    to = realloc(to, sizeof(int) * capacity);
+                    if (!from || !to) {
+                        fprintf(stderr, "Memory allocation failed for SSA form\n");
+                        exit(1);
+                    }
+                }
+                last[runner] = b;
+                from[count] = runner;
+                to[count++] = b;
+                if (runner == 0) break;
+                runner = ssa->idom[runner];
+            }
+        }
+    }
+
+    int* df_start = new_ints(n + 1, 0);
+    for (int i = 0; i < count; i++) df_start[from[i] + 1]++;
+    for (int b = 0; b < n; b++) df_start[b + 1] += df_start[b];
+    int* df = new_ints(count, 0);
+    for (int b = 0; b < n; b++) last[b] = df_start[b];
+    for (int i = 0; i < count; i++) df[last[from[i]]++] = to[i];
+
+    free(from);
+    free(to);
+    free(last);
+    *df_start_out = df_start;
+    *df_out = df;
+}
+
+// Names read in some block before that block writes them are the only
+// ones that can need a phi; the blocks writing each of them seed the
+// placement.
+static void place_phis(const TacProgram* prog, SsaForm* ssa) {
+    int n = ssa->cfg.count;
+    int names = ssa->name_count;
+    int* last_def = new_ints(names, SSA_NONE);
+    char* global = calloc(names ? names : 1, 1);
+    int* def_start = new_ints(names + 1, 0);
+    if (!global) {
+        fprintf(stderr, "Memory allocation failed for SSA form\n");
+        exit(1);
+    }
+
+    for (int b = 0; b < n; b++) {
+        for (int i = ssa->cfg.blocks[b].start; i < ssa->cfg.blocks[b].end; i++) {
+            const TACInstruction* ins = &prog->code[i];
+            int a = ssa_name(prog, tac_a(ins)), c = ssa_name(prog, tac_b(ins));
+            if (a >= 0 && last_def[a] != b) global[a] = 1;
+            if (c >= 0 && last_def[c] != b) global[c] = 1;
+            if (!defines(ins)) continue;
+            int d = ssa_name(prog, tac_dst(ins));
+            if (last_def[d] != b) {
+                last_def[d] = b;
+                def_start[d + 1]++;
+            }
+        }
+    }
+    for (int v = 0; v < names; v++) def_start[v + 1] += def_start[v];
+    int* def_blocks = new_ints(def_start[names], 0);
+    int* fill = new_ints(names, 0);
+    for (int v = 0; v < names; v++) last_def[v] = SSA_NONE;
+    for (int b = 0; b < n; b++) {
+        for (int i = ssa->cfg.blocks[b].start; i < ssa->cfg.blocks[b].end; i++) {
+            if (!defines(&prog->code[i])) continue;
+            int d = ssa_name(prog, tac_dst(&prog->code[i]));
+            if (last_def[d] != b) {
+                last_def[d] = b;
+                def_blocks[def_start[d] + fill[d]++] = b;
+            }
+        }
+    }
+    free(fill);
+    free(last_def);
+
+    int* df_start;
+    int* df;
+    find_frontiers(ssa, &df_start, &df);
+
+    // (block, name) of every phi, in placement order
+    int capacity = 1024, count = 0;
+    int* phi_at = checked_malloc(sizeof(int) * capacity * 2);
+    int* has_phi = new_ints(n, SSA_NONE);
+    int* queued = new_ints(n, SSA_NONE);
+    int* work = new_ints(n, 0);
+    for (int v = 0; v < names; v++) {
+        if (!global[v]) continue;
+        int top = 0;
+        for (int k = def_start[v]; k < def_start[v + 1]; k++) {
+            work[top++] = def_blocks[k];
+            queued[def_blocks[k]] = v;
+        }
+        while (top > 0) {
+            int b = work[--top];
+            for (int k = df_start[b]; k < df_start[b + 1]; k++) {
+                int join = df[k];
+                if (has_phi[join] == v) continue;
+                has_phi[join] = v;
+                if (count == capacity) {
+                    capacity *= 2;
+                    phi_at = realloc(phi_at, sizeof(int) * capacity * 2);
+                    if (!phi_at) {
+                        fprintf(stderr, "Memory allocation failed for SSA form\n");
+                        exit(1);
+                    }
+                }
+                phi_at[count * 2] = join;
+                phi_at[count * 2 + 1] = v;
+                count++;
+                if (queued[join] != v) {
+                    queued[join] = v;
+                    work[top++] = join;
+                }
+            }
+        }
+    }
+    free(has_phi);
+    free(queued);
+    free(work);
+    free(df_start);
+    free(df);
+    free(def_start);
+    free(def_blocks);
+    free(global);
+
+    // Group by block; arguments follow the block's predecessor order
+    ssa->phi_count = count;
+    ssa->block_phi_start = new_ints(n + 1, 0);
+    for (int p = 0; p < count; p++) ssa->block_phi_start[phi_at[p * 2] + 1]++;
+    for (int b = 0; b < n; b++) ssa->block_phi_start[b + 1] += ssa->block_phi_start[b];
+    ssa->phi_block = new_ints(count, 0);
+    ssa->phi_name = new_ints(count, 0);
+    ssa->phi_value = new_ints(count, SSA_NONE);
+    int* next = new_ints(n, 0);
+    for (int b = 0; b < n; b++) next[b] = ssa->block_phi_start[b];
+    for (int p = 0; p < count; p++) {
+        int slot = next[phi_at[p * 2]]++;
+        ssa->phi_block[slot] = phi_at[p * 2];
+        ssa->phi_name[slot] = phi_at[p * 2 + 1];
+    }
+    free(next);
+    free(phi_at);
+
+    ssa->phi_arg_start = new_ints(count + 1, 0);
+    for (int p = 0; p < count; p++) {
+        int b = ssa->phi_block[p];
+        ssa->phi_arg_start[p + 1] = ssa->phi_arg_start[p] + ssa->pred_start[b + 1] - ssa->pred_start[b];
+    }
+    ssa->phi_args = new_ints(ssa->phi_arg_start[count], SSA_NONE);
+}
+
+// Preorder over the dominator tree with one current value per name. Each
+// definition logs the value it hides, and leaving a block unwinds the log
+// to where it stood on entry.
+static void rename_values(const TacProgram* prog, SsaForm* ssa) {
+    int n = ssa->cfg.count;
+    int names = ssa->name_count;
+
+    int* child_start = new_ints(n + 1, 0);
+    for (int b = 1; b < n; b++) {
+        if (ssa->idom[b] != SSA_NONE) child_start[ssa->idom[b] + 1]++;
+    }
+    for (int b = 0; b < n; b++) child_start[b + 1] += child_start[b];
+    int* children = new_ints(child_start[n], 0);
+    int* fill = new_ints(n, 0);
+    for (int b = 1; b < n; b++) {
+        int parent = ssa->idom[b];
+        if (parent != SSA_NONE) children[child_start[parent] + fill[parent]++] = b;
+    }
+    free(fill);
+
+    int definitions = 0;
+    for (int i = 0; i < prog->count; i++) definitions += defines(&prog->code[i]);
+    ssa->value_site = new_ints((size_t)names + definitions + ssa->phi_count, SSA_ENTRY);
+    ssa->value_count = names;
+    ssa->use_a = new_ints(prog->count, SSA_NONE);
+    ssa->use_b = new_ints(prog->count, SSA_NONE);
+    ssa->def = new_ints(prog->count, SSA_NONE);
+
+    int* current = new_ints(names, 0);
+    for (int v = 0; v < names; v++) current[v] = v;
+    int* log_name = new_ints((size_t)definitions + ssa->phi_count, 0);
+    int* log_value = new_ints((size_t)definitions + ssa->phi_count, 0);
+    int log_count = 0;
+
+    int* stack_block = new_ints(n, 0);
+    int* stack_mark = new_ints(n, 0);
+    int top = 0;
+    if (ssa->rpo_count > 0) {
+        stack_block[top] = 0;
+        stack_mark[top++] = -1;
+    }
+
+    while (top > 0) {
+        int b = stack_block[top - 1];
+        if (stack_mark[top - 1] >= 0) {
+            int mark = stack_mark[--top];
+            while (log_count > mark) {
+                log_count--;
+                current[log_name[log_count]] = log_value[log_count];
+            }
+            continue;
+        }
+        stack_mark[top - 1] = log_count;
+
+        for (int p = ssa->block_phi_start[b]; p < ssa->block_phi_start[b + 1]; p++) {
+            int v = ssa->value_count++;
+            ssa->value_site[v] = -(p + 1);
+            ssa->phi_value[p] = v;
+            log_name[log_count] = ssa->phi_name[p];
+            log_value[log_count++] = current[ssa->phi_name[p]];
+            current[ssa->phi_name[p]] = v;
+        }
+
+        for (int i = ssa->cfg.blocks[b].start; i < ssa->cfg.blocks[b].end; i++) {
+            const TACInstruction* ins = &prog->code[i];
+            int a = ssa_name(prog, tac_a(ins)), c = ssa_name(prog, tac_b(ins));
+            if (a >= 0) ssa->use_a[i] = current[a];
+            if (c >= 0) ssa->use_b[i] = current[c];
+            if (!defines(ins)) continue;
+            int d = ssa_name(prog, tac_dst(ins));
+            int v = ssa->value_count++;
+            ssa->value_site[v] = i;
+            ssa->def[i] = v;
+            log_name[log_count] = d;
+            log_value[log_count++] = current[d];
+            current[d] = v;
+        }
+
+        BasicBlock* block = &ssa->cfg.blocks[b];
+        for (int s = 0; s < block->succ_count; s++) {
+            int to = block->succ[s];
+            int slot = ssa->pred_start[to];
+            while (ssa->pred_edge[slot] != b * 2 + s) slot++;    // both edges may reach one block
+            slot -= ssa->pred_start[to];
+            for (int p = ssa->block_phi_start[to]; p < ssa->block_phi_start[to + 1]; p++) {
+                ssa->phi_args[ssa->phi_arg_start[p] + slot] = current[ssa->phi_name[p]];
+            }
+        }
+
+        for (int k = child_start[b]; k < child_start[b + 1]; k++) {
+            stack_block[top] = children[k];
+            stack_mark[top++] = -1;
+        }
+    }
+
+    free(child_start);
+    free(children);
+    free(current);
+    free(log_name);
+    free(log_value);
+    free(stack_block);
+    free(stack_mark);
+}
+
+static void link_users(const TacProgram* prog, SsaForm* ssa) {
+    int values = ssa->value_count;
+    ssa->use_start = new_ints(values + 1, 0);
+    for (int i = 0; i < prog->count; i++) {
+        if (ssa->use_a[i] >= 0) ssa->use_start[ssa->use_a[i] + 1]++;
+        if (ssa->use_b[i] >= 0) ssa->use_start[ssa->use_b[i] + 1]++;
+    }
+    int args = ssa->phi_arg_start[ssa->phi_count];
+    for (int k = 0; k < args; k++) {
+        if (ssa->phi_args[k] >= 0) ssa->use_start[ssa->phi_args[k] + 1]++;
+    }
+    for (int v = 0; v < values; v++) ssa->use_start[v + 1] += ssa->use_start[v];
+
+    ssa->users = new_ints(ssa->use_start[values], 0);
+    int* fill = new_ints(values, 0);
+    for (int v = 0; v < values; v++) fill[v] = ssa->use_start[v];
+    for (int i = 0; i < prog->count; i++) {
+        if (ssa->use_a[i] >= 0) ssa->users[fill[ssa->use_a[i]]++] = i;
+        if (ssa->use_b[i] >= 0) ssa->users[fill[ssa->use_b[i]]++] = i;
+    }
+    for (int p = 0; p < ssa->phi_count; p++) {
+        for (int k = ssa->phi_arg_start[p]; k < ssa->phi_arg_start[p + 1]; k++) {
+            if (ssa->phi_args[k] >= 0) ssa->users[fill[ssa->phi_args[k]]++] = -(p + 1);
+        }
+    }
+    free(fill);
+}
+
+void ssa_build(const TacProgram* prog, SsaForm* ssa) {
+    memset(ssa, 0, sizeof(*ssa));
+    build_cfg(prog, &ssa->cfg);
+    int n = ssa->cfg.count;
+    ssa->name_count = prog->var_count + prog->temp_count;
+
+    ssa->instr_block = new_ints(prog->count, 0);
+    for (int b = 0; b < n; b++) {
+        for (int i = ssa->cfg.blocks[b].start; i < ssa->cfg.blocks[b].end; i++) ssa->instr_block[i] = b;
+    }
+
+    build_preds(ssa);
+    int* rpo_index = new_ints(n, -1);
+    order_blocks(ssa, rpo_index);
+    find_dominators(ssa, rpo_index);
+    free(rpo_index);
+    if (n > 0) ssa->idom[0] = SSA_NONE;
+
+    place_phis(prog, ssa);
+    rename_values(prog, ssa);
+    link_users(prog, ssa);
+}
+
+void ssa_free(SsaForm* ssa) {
+    free_blocks(&ssa->cfg);
+    free(ssa->pred_start);
+    free(ssa->preds);
+    free(ssa->pred_edge);
+    free(ssa->idom);
+    free(ssa->rpo);
+    free(ssa->instr_block);
+    free(ssa->use_a);
+    free(ssa->use_b);
+    free(ssa->def);
+    free(ssa->value_site);
+    free(ssa->block_phi_start);
+    free(ssa->phi_block);
+    free(ssa->phi_name);
+    free(ssa->phi_value);
+    free(ssa->phi_arg_start);
+    free(ssa->phi_args);
+    free(ssa->use_start);
+    free(ssa->users);
+    memset(ssa, 0, sizeof(*ssa));
+}
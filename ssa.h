@@ -0,0 +1,59 @@
+// ssa.h
+//
+// SSA form of a TacProgram, kept beside the instructions rather than in
+// them: every definition and phi gets a value number, and every operand
+// that reads a variable or temp is mapped to the value that reaches it.
+// Phis are placed with dominance frontiers at the joins codegen makes for
+// NODE_IF and at the loop heads of NODE_WHILE (semi-pruned: only for names
+// live across a block boundary).
+//
+// Variables and temps share one name space: variable v is name v, temp t
+// is name var_count + t. Value n < name_count is the value name n holds
+// on entry, which is 0 because every backend zeroes its variables.
+
+#ifndef SSA_H
+#define SSA_H
+
+#include <limits.h>
+#include "tac.h"
+#include "cfg.h"
+
+#define SSA_NONE  -1
+#define SSA_ENTRY INT_MIN       // value_site of an entry value
+
+typedef struct {
+    BlockList cfg;
+    int* pred_start;        // block b's predecessors: preds[pred_start[b] .. pred_start[b + 1])
+    int* preds;
+    int* pred_edge;         // edge of each preds[] entry, pred * 2 + successor slot
+    int* idom;              // immediate dominator, SSA_NONE for the entry and unreachable blocks
+    int* rpo;               // reachable blocks in reverse postorder
+    int rpo_count;
+    int* instr_block;       // block of each instruction
+
+    int name_count;
+    int value_count;
+    int* use_a;             // value read by operand a, b of each instruction, or SSA_NONE
+    int* use_b;
+    int* def;               // value defined by each instruction, or SSA_NONE
+    int* value_site;        // defining instruction, -(phi + 1) for a phi, or SSA_ENTRY
+
+    int phi_count;          // phis are grouped by block
+    int* block_phi_start;   // block b's phis: [block_phi_start[b], block_phi_start[b + 1])
+    int* phi_block;
+    int* phi_name;
+    int* phi_value;
+    int* phi_arg_start;     // one argument per predecessor, in preds[] order;
+    int* phi_args;          // SSA_NONE from an unreachable predecessor
+
+    int* use_start;         // users of value v: users[use_start[v] .. use_start[v + 1]),
+    int* users;             // an instruction index or -(phi + 1)
+} SsaForm;
+
+void ssa_build(const TacProgram* prog, SsaForm* ssa);
+void ssa_free(SsaForm* ssa);
+
+// Name an operand refers to, or SSA_NONE for immediates, labels and spills
+int ssa_name(const TacProgram* prog, TacOperand o);
+
+#endif
@@ -0,0 +1,108 @@
+// stats.c
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "stats.h"
+
+#define MAX_PHASES 16
+
+static int enabled = 0;
+static PhaseStats phases[MAX_PHASES];
+static int phase_count = 0;
+static double phase_start;
+static int cycles_fd = -1;
+static int instructions_fd = -1;
+static long long cycles_start, instructions_start;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int open_counter(unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long read_counter(int fd) {
+    long long value;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) return -1;
+    return value;
+}
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void stats_start(int hardware) {
+    enabled = 1;
+    phase_count = 0;
+    if (!hardware) return;
+    cycles_fd = open_counter(PERF_COUNT_HW_CPU_CYCLES);
+    instructions_fd = open_counter(PERF_COUNT_HW_INSTRUCTIONS);
+    if (cycles_fd < 0 || instructions_fd < 0) {
+        perror("perf_event_open");
+        fprintf(stderr, "Hardware counters unavailable; reporting time and memory only\n");
+        if (cycles_fd >= 0) close(cycles_fd);
+        if (instructions_fd >= 0) close(instructions_fd);
+        cycles_fd = instructions_fd = -1;
+    }
+}
+
+void stats_phase_begin(const char* name) {
+    if (!enabled || phase_count == MAX_PHASES) return;
+    phases[phase_count].name = name;
+    cycles_start = read_counter(cycles_fd);
+    instructions_start = read_counter(instructions_fd);
+    phase_start = now_seconds();
+}
+
+void stats_phase_end() {
+    if (!enabled || phase_count == MAX_PHASES) return;
+    PhaseStats* p = &phases[phase_count++];
+    p->seconds = now_seconds() - phase_start;
+    long long cycles = read_counter(cycles_fd);
+    long long instructions = read_counter(instructions_fd);
+    p->cycles = cycles >= 0 ? cycles - cycles_start : -1;
+    p->instructions = instructions >= 0 ? instructions - instructions_start : -1;
+    p->peak_rss_kb = peak_rss_kb();
+}
+
+void stats_report(long tokens, size_t ast_nodes, int tac_instructions) {
+    if (!enabled) return;
+    int hardware = cycles_fd >= 0;
+    printf("\n----------------------STATISTICS----------------\n");
+    printf("%-10s %12s %14s", "Phase", "Time (ms)", "Peak RSS (KB)");
+    if (hardware) printf(" %14s %14s %6s", "Cycles", "Instructions", "IPC");
+    printf("\n");
+
+    double total = 0;
+    for (int i = 0; i < phase_count; i++) {
+        PhaseStats* p = &phases[i];
+        total += p->seconds;
+        printf("%-10s %12.3f %14ld", p->name, p->seconds * 1e3, p->peak_rss_kb);
+        if (hardware) {
+            printf(" %14lld %14lld %6.2f", p->cycles, p->instructions,
+                   p->cycles > 0 ? (double)p->instructions / p->cycles : 0.0);
+        }
+        printf("\n");
+    }
+    printf("%-10s %12.3f %14ld\n", "total", total * 1e3, peak_rss_kb());
+    printf("Tokens: %ld, AST nodes: %zu, TAC instructions: %d\n",
+           tokens, ast_nodes, tac_instructions);
+}
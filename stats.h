@@ -0,0 +1,27 @@
+// stats.h
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+
+typedef struct {
+    const char* name;
+    double seconds;
+    long peak_rss_kb;           // process peak at the end of the phase
+    long long cycles;           // -1 without hardware counters
+    long long instructions;
+} PhaseStats;
+
+// Turns phase timing on; with `hardware` also opens cycle and instruction
+// counters through perf_event_open, falling back to timing alone when the
+// kernel refuses
+void stats_start(int hardware);
+
+// No-ops until stats_start() has been called
+void stats_phase_begin(const char* name);
+void stats_phase_end();
+
+void stats_report(long tokens, size_t ast_nodes, int tac_instructions);
+
+#endif
@@ -0,0 +1,116 @@
+// symtab.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "symtab.h"
+#include "intern.h"
+
+#define SYMTAB_INITIAL_SLOTS 64
+
+static void* checked_realloc(void* ptr, size_t size) {
+    void* p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for symbol table\n");
+        exit(1);
+    }
+    return p;
+}
+
+void symtab_init(SymbolTable* st) {
+    memset(st, 0, sizeof(*st));
+    st->slots = checked_realloc(NULL, sizeof(uint32_t) * SYMTAB_INITIAL_SLOTS);
+    memset(st->slots, 0, sizeof(uint32_t) * SYMTAB_INITIAL_SLOTS);
+    st->slot_mask = SYMTAB_INITIAL_SLOTS - 1;
+}
+
+void symtab_free(SymbolTable* st) {
+    free(st->symbols);
+    free(st->slots);
+    free(st->scope_marks);
+    memset(st, 0, sizeof(*st));
+}
+
+void symtab_clear(SymbolTable* st) {
+    st->count = 0;
+    st->live_count = 0;
+    st->scope_depth = 0;
+    memset(st->slots, 0, sizeof(uint32_t) * (st->slot_mask + 1));
+}
+
+static void place(SymbolTable* st, int index) {
+    uint32_t i = st->symbols[index].hash & st->slot_mask;
+    while (st->slots[i]) {
+        i = (i + 1) & st->slot_mask;
+    }
+    st->slots[i] = (uint32_t)index + 1;
+}
+
+// Keeps the load factor at or below 1/2. Live symbols are re-placed in
+// declaration order so that LIFO removal stays valid after the rehash.
+static void grow_slots(SymbolTable* st) {
+    uint32_t size = (st->slot_mask + 1) * 2;
+    free(st->slots);
+    st->slots = checked_realloc(NULL, sizeof(uint32_t) * size);
+    memset(st->slots, 0, sizeof(uint32_t) * size);
+    st->slot_mask = size - 1;
+    for (int i = 0; i < st->count; i++) {
+        if (st->symbols[i].live) place(st, i);
+    }
+}
+
+Symbol* symtab_lookup(SymbolTable* st, int name_id) {
+    uint32_t i = intern_hash(name_id) & st->slot_mask;
+    while (st->slots[i]) {
+        Symbol* sym = &st->symbols[st->slots[i] - 1];
+        if (sym->name_id == name_id) return sym;
+        i = (i + 1) & st->slot_mask;
+    }
+    return NULL;
+}
+
+Symbol* symtab_insert(SymbolTable* st, int name_id, Type type) {
+    if (st->count == st->capacity) {
+        st->capacity = st->capacity ? st->capacity * 2 : 64;
+        st->symbols = checked_realloc(st->symbols, sizeof(Symbol) * st->capacity);
+    }
+    if ((uint32_t)(st->live_count + 1) * 2 > st->slot_mask + 1) {
+        grow_slots(st);
+    }
+
+    int index = st->count++;
+    Symbol* sym = &st->symbols[index];
+    sym->name_id = name_id;
+    sym->hash = intern_hash(name_id);
+    sym->type = type;
+    sym->scope_level = st->scope_depth;
+    sym->live = 1;
+    place(st, index);
+    st->live_count++;
+    return sym;
+}
+
+void symtab_enter_scope(SymbolTable* st) {
+    if (st->scope_depth == st->scope_capacity) {
+        st->scope_capacity = st->scope_capacity ? st->scope_capacity * 2 : 8;
+        st->scope_marks = checked_realloc(st->scope_marks, sizeof(int) * st->scope_capacity);
+    }
+    st->scope_marks[st->scope_depth++] = st->count;
+}
+
+void symtab_leave_scope(SymbolTable* st) {
+    if (st->scope_depth == 0) return;
+    int mark = st->scope_marks[--st->scope_depth];
+
+    for (int index = st->count - 1; index >= mark; index--) {
+        Symbol* sym = &st->symbols[index];
+        if (!sym->live) continue;
+        uint32_t i = sym->hash & st->slot_mask;
+        while (st->slots[i] != (uint32_t)index + 1) {
+            i = (i + 1) & st->slot_mask;
+        }
+        st->slots[i] = 0;
+        sym->live = 0;
+        st->live_count--;
+    }
+}
@@ -0,0 +1,48 @@
+// symtab.h
+
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include <stdint.h>
+#include "ast.h"
+
+typedef struct Symbol {
+    int name_id;        // interned identifier
+    uint32_t hash;      // precomputed from the interned name
+    Type type;
+    int scope_level;    // 0 = global, n = nth nested block
+    int live;           // cleared when the declaring scope is left
+} Symbol;
+
+// Open-addressing (linear probing) table over a scope stack.
+// Every declared symbol is kept in `symbols` in declaration order; the slot
+// array only indexes the ones that are currently visible. Because scopes are
+// left in LIFO order, removing a scope's symbols from the newest to the oldest
+// restores the exact probe layout from before the scope was entered, so no
+// tombstones are needed.
+typedef struct {
+    Symbol* symbols;
+    int count;
+    int capacity;
+
+    uint32_t* slots;    // symbol index + 1, 0 = empty
+    uint32_t slot_mask;
+    int live_count;
+
+    int* scope_marks;   // first symbol index of each open nested scope
+    int scope_depth;
+    int scope_capacity;
+} SymbolTable;
+
+void symtab_init(SymbolTable* st);
+void symtab_free(SymbolTable* st);
+void symtab_clear(SymbolTable* st);    // forgets every symbol, keeps the memory
+
+// Returned pointers stay valid until the next symtab_insert.
+Symbol* symtab_lookup(SymbolTable* st, int name_id);
+Symbol* symtab_insert(SymbolTable* st, int name_id, Type type);
+
+void symtab_enter_scope(SymbolTable* st);
+void symtab_leave_scope(SymbolTable* st);
+
+#endif
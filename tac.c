@@ -0,0 +1,227 @@
+// tac.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tac.h"
+
+static void* checked_realloc(void* ptr, size_t size) {
+    void* p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for TAC buffer\n");
+        exit(1);
+    }
+    return p;
+}
+
+void tac_init(TacProgram* prog) {
+    memset(prog, 0, sizeof(*prog));
+}
+
+void tac_free(TacProgram* prog) {
+    free(prog->code);
+    free(prog->var_names);
+    memset(prog, 0, sizeof(*prog));
+}
+
+// Forget the instructions but keep the buffers for the next compilation
+void tac_clear(TacProgram* prog) {
+    prog->count = 0;
+    prog->var_count = 0;
+    prog->temp_count = 0;
+    prog->spill_count = 0;
+    prog->label_count = 0;
+}
+
+TacOperand tac_none()              { TacOperand o = { OPND_NONE, 0 }; return o; }
+TacOperand tac_temp(int index)     { TacOperand o = { OPND_TEMP, index }; return o; }
+TacOperand tac_var(int index)      { TacOperand o = { OPND_VAR, index }; return o; }
+TacOperand tac_imm(int value)      { TacOperand o = { OPND_IMM, value }; return o; }
+TacOperand tac_label(int index)    { TacOperand o = { OPND_LABEL, index }; return o; }
+TacOperand tac_spill(int index)    { TacOperand o = { OPND_SPILL, index }; return o; }
+
+TacOperand tac_dst(const TACInstruction* ins) { TacOperand o = { ins->dst_kind, ins->dst }; return o; }
+TacOperand tac_a(const TACInstruction* ins)   { TacOperand o = { ins->a_kind, ins->a }; return o; }
+TacOperand tac_b(const TACInstruction* ins)   { TacOperand o = { ins->b_kind, ins->b }; return o; }
+
+TacOperand tac_new_temp(TacProgram* prog) {
+    return tac_temp(prog->temp_count++);
+}
+
+TacOperand tac_new_label(TacProgram* prog) {
+    return tac_label(prog->label_count++);
+}
+
+int tac_add_var(TacProgram* prog, const char* name) {
+    if (prog->var_count == prog->var_capacity) {
+        prog->var_capacity = prog->var_capacity ? prog->var_capacity * 2 : 64;
+        prog->var_names = checked_realloc(prog->var_names, sizeof(char*) * prog->var_capacity);
+    }
+    prog->var_names[prog->var_count] = name;
+    return prog->var_count++;
+}
+
+void tac_emit(TacProgram* prog, TacOp op, TacOperand dst, TacOperand a, TacOperand b) {
+    if (prog->count == prog->capacity) {
+        prog->capacity = prog->capacity ? prog->capacity * 2 : 1024;
+        prog->code = checked_realloc(prog->code, sizeof(TACInstruction) * prog->capacity);
+    }
+    TACInstruction* ins = &prog->code[prog->count++];
+    ins->op = (uint8_t)op;
+    ins->dst_kind = dst.kind;
+    ins->a_kind = a.kind;
+    ins->b_kind = b.kind;
+    ins->dst = dst.value;
+    ins->a = a.value;
+    ins->b = b.value;
+}
+
+int tac_is_binop(TacOp op) {
+    return (op >= TAC_ADD && op <= TAC_GE) || op == TAC_SHL || op == TAC_SHR;
+}
+
+int tac_is_cond_jump(TacOp op) {
+    return op == TAC_IFGOTO || (op >= TAC_IF_EQ && op <= TAC_IF_GE);
+}
+
+int tac_is_jump(TacOp op) {
+    return op == TAC_GOTO || tac_is_cond_jump(op);
+}
+
+TacOp tac_negate_compare(TacOp op) {
+    switch (op) {
+        case TAC_EQ:    return TAC_NE;
+        case TAC_NE:    return TAC_EQ;
+        case TAC_LT:    return TAC_GE;
+        case TAC_LE:    return TAC_GT;
+        case TAC_GT:    return TAC_LE;
+        case TAC_GE:    return TAC_LT;
+        case TAC_IF_EQ: return TAC_IF_NE;
+        case TAC_IF_NE: return TAC_IF_EQ;
+        case TAC_IF_LT: return TAC_IF_GE;
+        case TAC_IF_LE: return TAC_IF_GT;
+        case TAC_IF_GT: return TAC_IF_LE;
+        case TAC_IF_GE: return TAC_IF_LT;
+        default:        return op;
+    }
+}
+
+int tac_evaluate(TacOp op, int32_t l, int32_t r, int32_t* result) {
+    if (op >= TAC_IF_EQ && op <= TAC_IF_GE) op = (TacOp)(op - TAC_IF_EQ + TAC_EQ);
+    switch (op) {
+        case TAC_ADD: *result = (int32_t)((uint32_t)l + (uint32_t)r); return 1;
+        case TAC_SUB: *result = (int32_t)((uint32_t)l - (uint32_t)r); return 1;
+        case TAC_MUL: *result = (int32_t)((uint32_t)l * (uint32_t)r); return 1;
+        case TAC_DIV:
+            if (r == 0) return 0;
+            *result = r == -1 ? (int32_t)(0u - (uint32_t)l) : l / r;
+            return 1;
+        case TAC_EQ:  *result = l == r; return 1;
+        case TAC_NE:  *result = l != r; return 1;
+        case TAC_LT:  *result = l < r;  return 1;
+        case TAC_LE:  *result = l <= r; return 1;
+        case TAC_GT:  *result = l > r;  return 1;
+        case TAC_GE:  *result = l >= r; return 1;
+        case TAC_SHL: *result = (int32_t)((uint32_t)l << (r & 31)); return 1;
+        case TAC_SHR: {
+            // Negative values are biased by 2^n - 1 so the shift truncates
+            int n = r & 31;
+            uint32_t bias = n ? (uint32_t)(l >> 31) >> (32 - n) : 0;
+            *result = (int32_t)((uint32_t)l + bias) >> n;
+            return 1;
+        }
+        default:      return 0;
+    }
+}
+
+const char* tac_op_symbol(TacOp op) {
+    switch (op) {
+        case TAC_COPY:   return "=";
+        case TAC_ADD:    return "+";
+        case TAC_SUB:    return "-";
+        case TAC_MUL:    return "*";
+        case TAC_DIV:    return "/";
+        case TAC_EQ:     return "==";
+        case TAC_NE:     return "!=";
+        case TAC_LT:     return "<";
+        case TAC_LE:     return "<=";
+        case TAC_GT:     return ">";
+        case TAC_GE:     return ">=";
+        case TAC_PRINT:  return "print";
+        case TAC_IFGOTO: return "ifgoto";
+        case TAC_GOTO:   return "goto";
+        case TAC_LABEL:  return "label";
+        case TAC_IF_EQ:  return "==";
+        case TAC_IF_NE:  return "!=";
+        case TAC_IF_LT:  return "<";
+        case TAC_IF_LE:  return "<=";
+        case TAC_IF_GT:  return ">";
+        case TAC_IF_GE:  return ">=";
+        case TAC_SHL:    return "<<";
+        case TAC_SHR:    return ">>";
+    }
+    return "?";
+}
+
+static void write_operand(const TacProgram* prog, TacOperand o, FILE* f) {
+    switch (o.kind) {
+        case OPND_TEMP:  fprintf(f, "t%d", o.value); break;
+        case OPND_VAR:   fputs(prog->var_names[o.value], f); break;
+        case OPND_IMM:   fprintf(f, "%d", o.value); break;
+        case OPND_LABEL: fprintf(f, "L%d", o.value); break;
+        case OPND_SPILL: fprintf(f, "s%d", o.value); break;
+        default:         fputs("?", f); break;
+    }
+}
+
+void tac_write(const TacProgram* prog, FILE* f) {
+    for (int i = 0; i < prog->count; i++) {
+        const TACInstruction* ins = &prog->code[i];
+        switch ((TacOp)ins->op) {
+            case TAC_PRINT:
+                fputs("print ", f);
+                write_operand(prog, tac_a(ins), f);
+                break;
+            case TAC_COPY:
+                write_operand(prog, tac_dst(ins), f);
+                fputs(" = ", f);
+                write_operand(prog, tac_a(ins), f);
+                break;
+            case TAC_IFGOTO:
+                fputs("if ", f);
+                write_operand(prog, tac_a(ins), f);
+                fputs(" goto ", f);
+                write_operand(prog, tac_dst(ins), f);
+                break;
+            case TAC_IF_EQ:
+            case TAC_IF_NE:
+            case TAC_IF_LT:
+            case TAC_IF_LE:
+            case TAC_IF_GT:
+            case TAC_IF_GE:
+                fputs("if ", f);
+                write_operand(prog, tac_a(ins), f);
+                fprintf(f, " %s ", tac_op_symbol((TacOp)ins->op));
+                write_operand(prog, tac_b(ins), f);
+                fputs(" goto ", f);
+                write_operand(prog, tac_dst(ins), f);
+                break;
+            case TAC_GOTO:
+                fputs("goto ", f);
+                write_operand(prog, tac_dst(ins), f);
+                break;
+            case TAC_LABEL:
+                write_operand(prog, tac_dst(ins), f);
+                fputc(':', f);
+                break;
+            default:
+                write_operand(prog, tac_dst(ins), f);
+                fputs(" = ", f);
+                write_operand(prog, tac_a(ins), f);
+                fprintf(f, " %s ", tac_op_symbol((TacOp)ins->op));
+                write_operand(prog, tac_b(ins), f);
+                break;
+        }
+        fputc('\n', f);
+    }
+}
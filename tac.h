@@ -0,0 +1,109 @@
+// tac.h
+
+#ifndef TAC_H
+#define TAC_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    TAC_COPY,       // dst = a
+    TAC_ADD,        // dst = a op b, in the same order as BinOp
+    TAC_SUB,
+    TAC_MUL,
+    TAC_DIV,
+    TAC_EQ,
+    TAC_NE,
+    TAC_LT,
+    TAC_LE,
+    TAC_GT,
+    TAC_GE,
+    TAC_PRINT,      // print a
+    TAC_IFGOTO,     // if a goto dst
+    TAC_GOTO,       // goto dst
+    TAC_LABEL,      // dst:
+    TAC_IF_EQ,      // if a op b goto dst, in the same order as TAC_EQ..TAC_GE
+    TAC_IF_NE,
+    TAC_IF_LT,
+    TAC_IF_LE,
+    TAC_IF_GT,
+    TAC_IF_GE,
+    TAC_SHL,        // dst = a << b: a * 2^b
+    TAC_SHR         // dst = a >> b rounded toward zero: a / 2^b
+} TacOp;
+
+typedef enum {
+    OPND_NONE,
+    OPND_TEMP,      // t<value>
+    OPND_VAR,       // index into TacProgram.var_names
+    OPND_IMM,       // integer constant
+    OPND_LABEL,     // L<value>
+    OPND_SPILL      // s<value>, a memory slot for a temp that did not fit the pool
+} OperandKind;
+
+typedef struct {
+    uint8_t kind;
+    int32_t value;
+} TacOperand;
+
+// 16 bytes per instruction
+typedef struct {
+    uint8_t op;
+    uint8_t dst_kind;
+    uint8_t a_kind;
+    uint8_t b_kind;
+    int32_t dst;
+    int32_t a;
+    int32_t b;
+} TACInstruction;
+
+typedef struct {
+    TACInstruction* code;
+    int count;
+    int capacity;
+
+    const char** var_names;     // not owned; usually interned strings
+    int var_count;
+    int var_capacity;
+
+    int temp_count;
+    int spill_count;
+    int label_count;
+} TacProgram;
+
+void tac_init(TacProgram* prog);
+void tac_free(TacProgram* prog);
+void tac_clear(TacProgram* prog);
+
+TacOperand tac_none();
+TacOperand tac_temp(int index);
+TacOperand tac_var(int index);
+TacOperand tac_imm(int value);
+TacOperand tac_label(int index);
+TacOperand tac_spill(int index);
+
+TacOperand tac_dst(const TACInstruction* ins);
+TacOperand tac_a(const TACInstruction* ins);
+TacOperand tac_b(const TACInstruction* ins);
+
+TacOperand tac_new_temp(TacProgram* prog);
+TacOperand tac_new_label(TacProgram* prog);
+int        tac_add_var(TacProgram* prog, const char* name);
+
+void tac_emit(TacProgram* prog, TacOp op, TacOperand dst, TacOperand a, TacOperand b);
+
+int   tac_is_binop(TacOp op);        // dst = a op b: TAC_ADD..TAC_GE and the shifts
+int   tac_is_cond_jump(TacOp op);    // ifgoto or a fused compare-and-branch
+int   tac_is_jump(TacOp op);         // any instruction whose dst is a label
+TacOp tac_negate_compare(TacOp op);  // TAC_LT -> TAC_GE, TAC_IF_EQ -> TAC_IF_NE, ...
+
+// Evaluates a binop (or the compare of a compare-and-branch) like the
+// generated code does: two's-complement wrap-around, truncating division
+// and shift counts taken mod 32. Returns 0 when the operation must be left
+// to run time.
+int tac_evaluate(TacOp op, int32_t l, int32_t r, int32_t* result);
+
+const char* tac_op_symbol(TacOp op);
+void        tac_write(const TacProgram* prog, FILE* f);
+
+#endif
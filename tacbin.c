@@ -0,0 +1,249 @@
+// tacbin.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tacbin.h"
+
+_Static_assert(sizeof(TACInstruction) == 16, "TACInstruction is a 16-byte record on disk");
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+void emit_TAC_binary(const TacProgram* prog, const char* filename) {
+    size_t string_bytes = 0;
+    for (int i = 0; i < prog->var_count; i++) string_bytes += strlen(prog->var_names[i]) + 1;
+
+    TacBinHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TACBIN_MAGIC, 4);
+    header.version = TACBIN_VERSION;
+    header.instruction_count = prog->count;
+    header.label_count = prog->label_count;
+    header.var_count = prog->var_count;
+    header.temp_count = prog->temp_count;
+    header.spill_count = prog->spill_count;
+    header.string_bytes = string_bytes;
+    header.code_offset = align8(sizeof(header));
+    header.labels_offset = align8(header.code_offset + sizeof(TACInstruction) * prog->count);
+    header.vars_offset = align8(header.labels_offset + sizeof(uint32_t) * prog->label_count);
+    header.strings_offset = align8(header.vars_offset + sizeof(uint32_t) * prog->var_count);
+    size_t size = header.strings_offset + string_bytes;
+
+    char* buffer = calloc(1, size);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed for binary TAC\n");
+        exit(1);
+    }
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + header.code_offset, prog->code, sizeof(TACInstruction) * prog->count);
+
+    uint32_t* labels = (uint32_t*)(buffer + header.labels_offset);
+    for (int i = 0; i < prog->label_count; i++) labels[i] = TACBIN_NO_LABEL;
+    for (int i = 0; i < prog->count; i++) {
+        if (prog->code[i].op == TAC_LABEL) labels[prog->code[i].dst] = (uint32_t)i;
+    }
+
+    uint32_t* vars = (uint32_t*)(buffer + header.vars_offset);
+    char* strings = buffer + header.strings_offset;
+    size_t offset = 0;
+    for (int i = 0; i < prog->var_count; i++) {
+        size_t n = strlen(prog->var_names[i]) + 1;
+        vars[i] = (uint32_t)offset;
+        memcpy(strings + offset, prog->var_names[i], n);
+        offset += n;
+    }
+
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        perror("fopen");
+        exit(1);
+    }
+    if (fwrite(buffer, 1, size, f) != size || fclose(f) != 0) {
+        perror("fwrite");
+        exit(1);
+    }
+    free(buffer);
+}
+
+static int invalid(const char* filename, const char* what) {
+    fprintf(stderr, "%s: not a usable binary TAC file (%s)\n", filename, what);
+    return -1;
+}
+
+// A section of `count` items of `width` bytes at `offset` fits in the file
+static int fits(size_t size, uint64_t offset, uint64_t count, size_t width) {
+    return offset <= size && count <= (size - offset) / width;
+}
+
+// The backends keep every count in an int and lay the slots out as
+// [variables][temps][spills], which the VM follows with up to two
+// immediates per instruction and the JIT addresses as 4-byte offsets from
+// one base register. Counts that overflow any of those are rejected here,
+// before operand_ok compares against them.
+static int counts_ok(const TacBinHeader* h) {
+    if (h->instruction_count > INT32_MAX || h->label_count >= INT32_MAX ||
+        h->var_count > INT32_MAX || h->temp_count > INT32_MAX || h->spill_count > INT32_MAX)
+        return 0;
+    uint64_t slots = (uint64_t)h->var_count + h->temp_count + h->spill_count;
+    return slots <= INT32_MAX / 4 && slots + 2 * (uint64_t)h->instruction_count <= INT32_MAX;
+}
+
+static int operand_ok(const TacBinHeader* h, uint8_t kind, int32_t value) {
+    switch (kind) {
+        case OPND_NONE:
+        case OPND_IMM:   return 1;
+        case OPND_TEMP:  return value >= 0 && (uint32_t)value < h->temp_count;
+        case OPND_VAR:   return value >= 0 && (uint32_t)value < h->var_count;
+        case OPND_SPILL: return value >= 0 && (uint32_t)value < h->spill_count;
+        case OPND_LABEL: return value >= 0 && (uint32_t)value < h->label_count;
+        default:         return 0;
+    }
+}
+
+// What an instruction does with each of dst, a and b
+enum { USE_NONE, USE_READ, USE_WRITE, USE_LABEL };
+
+static int use_ok(int use, uint8_t kind) {
+    switch (use) {
+        case USE_NONE:  return kind == OPND_NONE;
+        case USE_READ:  return kind == OPND_VAR || kind == OPND_TEMP || kind == OPND_SPILL ||
+                               kind == OPND_IMM;
+        case USE_WRITE: return kind == OPND_VAR || kind == OPND_TEMP || kind == OPND_SPILL;
+        default:        return kind == OPND_LABEL;
+    }
+}
+
+// The operand kinds the compiler emits for each opcode. The VM gives every
+// immediate it reads a constant slot, sized for two per instruction, so an
+// immediate where nothing is read, or an immediate destination, must not load.
+static int kinds_ok(const TACInstruction* ins) {
+    int dst = USE_WRITE, a = USE_READ, b = USE_READ;
+    switch ((TacOp)ins->op) {
+        case TAC_COPY:   b = USE_NONE; break;
+        case TAC_PRINT:  dst = USE_NONE; b = USE_NONE; break;
+        case TAC_IFGOTO: dst = USE_LABEL; b = USE_NONE; break;
+        case TAC_GOTO:
+        case TAC_LABEL:  dst = USE_LABEL; a = USE_NONE; b = USE_NONE; break;
+        case TAC_IF_EQ:
+        case TAC_IF_NE:
+        case TAC_IF_LT:
+        case TAC_IF_LE:
+        case TAC_IF_GT:
+        case TAC_IF_GE:  dst = USE_LABEL; break;
+        default:         break;
+    }
+    return use_ok(dst, ins->dst_kind) && use_ok(a, ins->a_kind) && use_ok(b, ins->b_kind);
+}
+
+// The interpreters index slots and jump targets without checks, so a file
+// must not be able to point anywhere the compiler could not
+static int code_ok(const TacBinHeader* h, const TACInstruction* code, const uint32_t* labels) {
+    for (uint32_t i = 0; i < h->label_count; i++) {
+        if (labels[i] == TACBIN_NO_LABEL) continue;
+        if (labels[i] >= h->instruction_count) return 0;
+        const TACInstruction* at = &code[labels[i]];
+        if (at->op != TAC_LABEL || at->dst != (int32_t)i) return 0;
+    }
+    for (uint32_t i = 0; i < h->instruction_count; i++) {
+        const TACInstruction* ins = &code[i];
+        if (ins->op > TAC_SHR || !kinds_ok(ins)) return 0;
+        if (!operand_ok(h, ins->dst_kind, ins->dst) || !operand_ok(h, ins->a_kind, ins->a) ||
+            !operand_ok(h, ins->b_kind, ins->b))
+            return 0;
+        if (ins->dst_kind == OPND_LABEL && labels[ins->dst] == TACBIN_NO_LABEL) return 0;
+    }
+    return 1;
+}
+
+int tac_image_open(TacImage* image, const char* filename) {
+    memset(image, 0, sizeof(*image));
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror(filename);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(filename);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size < sizeof(TacBinHeader)) {
+        close(fd);
+        return invalid(filename, "truncated header");
+    }
+    void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    image->base = base;
+    image->size = size;
+
+    const TacBinHeader* h = base;
+    const char* problem = NULL;
+    if (memcmp(h->magic, TACBIN_MAGIC, 4) != 0) problem = "bad magic";
+    else if (h->version != TACBIN_VERSION) problem = "unsupported version";
+    else if (h->code_offset % 8 || h->labels_offset % 8 || h->vars_offset % 8) problem = "misaligned section";
+    else if (!counts_ok(h)) problem = "count too large";
+    else if (!fits(size, h->code_offset, h->instruction_count, sizeof(TACInstruction)) ||
+             !fits(size, h->labels_offset, h->label_count, sizeof(uint32_t)) ||
+             !fits(size, h->vars_offset, h->var_count, sizeof(uint32_t)) ||
+             !fits(size, h->strings_offset, h->string_bytes, 1))
+        problem = "section out of bounds";
+    if (problem) {
+        tac_image_close(image);
+        return invalid(filename, problem);
+    }
+    const TACInstruction* code = (const TACInstruction*)((const char*)base + h->code_offset);
+    const uint32_t* labels = (const uint32_t*)((const char*)base + h->labels_offset);
+    if (!code_ok(h, code, labels)) {
+        tac_image_close(image);
+        return invalid(filename, "invalid instruction");
+    }
+
+    // Names are the only thing that needs a table of pointers
+    const uint32_t* vars = (const uint32_t*)((const char*)base + h->vars_offset);
+    const char* strings = (const char*)base + h->strings_offset;
+    const char** names = malloc(sizeof(char*) * (h->var_count ? h->var_count : 1));
+    if (!names) {
+        tac_image_close(image);
+        fprintf(stderr, "Memory allocation failed for binary TAC names\n");
+        return -1;
+    }
+    for (uint32_t i = 0; i < h->var_count; i++) {
+        if (vars[i] >= h->string_bytes || !memchr(strings + vars[i], '\0', h->string_bytes - vars[i])) {
+            free(names);
+            tac_image_close(image);
+            return invalid(filename, "bad name offset");
+        }
+        names[i] = strings + vars[i];
+    }
+
+    image->header = h;
+    image->labels = labels;
+    image->prog.code = (TACInstruction*)((char*)base + h->code_offset);
+    image->prog.count = (int)h->instruction_count;
+    image->prog.capacity = 0;      // borrowed from the mapping; never tac_free() it
+    image->prog.var_names = names;
+    image->prog.var_count = (int)h->var_count;
+    image->prog.var_capacity = (int)h->var_count;
+    image->prog.temp_count = (int)h->temp_count;
+    image->prog.spill_count = (int)h->spill_count;
+    image->prog.label_count = (int)h->label_count;
+    return 0;
+}
+
+void tac_image_close(TacImage* image) {
+    free(image->prog.var_names);
+    if (image->base) munmap(image->base, image->size);
+    memset(image, 0, sizeof(*image));
+}
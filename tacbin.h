@@ -0,0 +1,57 @@
+// tacbin.h
+//
+// Binary TAC (.tacb): a header, then fixed-width sections that a reader can
+// use in place after mmap. All integers are native little-endian; every
+// section starts on an 8-byte boundary.
+//
+//   header       TacBinHeader
+//   code         instruction_count TACInstruction records (16 bytes each)
+//   labels       label_count uint32: instruction index of each label,
+//                TACBIN_NO_LABEL if the label was optimized away
+//   vars         var_count uint32: offset of each name in the string pool
+//   strings      NUL-terminated names
+
+#ifndef TACBIN_H
+#define TACBIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tac.h"
+
+#define TACBIN_MAGIC "TACB"
+#define TACBIN_VERSION 1
+#define TACBIN_NO_LABEL UINT32_MAX
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t instruction_count;
+    uint32_t label_count;
+    uint32_t var_count;
+    uint32_t temp_count;
+    uint32_t spill_count;
+    uint32_t string_bytes;
+    uint64_t code_offset;
+    uint64_t labels_offset;
+    uint64_t vars_offset;
+    uint64_t strings_offset;
+} TacBinHeader;
+
+// A mapped .tacb file; `prog` reads straight out of the mapping
+typedef struct {
+    void* base;
+    size_t size;
+    const TacBinHeader* header;
+    const uint32_t* labels;
+    TacProgram prog;
+} TacImage;
+
+// Serializes into one buffer and writes it with a single write
+void emit_TAC_binary(const TacProgram* prog, const char* filename);
+
+// Maps and validates a .tacb file. Returns 0 on success, -1 after
+// reporting what was wrong with it.
+int  tac_image_open(TacImage* image, const char* filename);
+void tac_image_close(TacImage* image);
+
+#endif
@@ -0,0 +1,40 @@
+// tacdump.c
+//
+// Prints a binary TAC file (.tacb) in the same text form as out.tac:
+//
+//     tacdump [--header] file.tacb
+
+#include <stdio.h>
+#include <string.h>
+#include "tacbin.h"
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    int show_header = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) show_header = 1;
+        else path = argv[i];
+    }
+    if (!path) {
+        fprintf(stderr, "usage: tacdump [--header] file.tacb\n");
+        return 1;
+    }
+
+    TacImage image;
+    if (tac_image_open(&image, path) != 0) return 1;
+
+    if (show_header) {
+        const TacBinHeader* h = image.header;
+        printf("; version %u, %zu bytes\n", h->version, image.size);
+        printf("; %u instructions, %u labels, %u variables, %u temps, %u spill slots\n",
+               h->instruction_count, h->label_count, h->var_count, h->temp_count, h->spill_count);
+        for (uint32_t i = 0; i < h->label_count; i++) {
+            if (image.labels[i] == TACBIN_NO_LABEL) printf("; L%u: removed\n", i);
+            else printf("; L%u: instruction %u\n", i, image.labels[i]);
+        }
+    }
+    tac_write(&image.prog, stdout);
+
+    tac_image_close(&image);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+# tests/batch.sh CC
+#
+# Compiles tests/*.src with `CC -j 2` under each optimization setting of
+# run.sh and compares every .tac it writes with the out.tac of a single
+# compile with the same flags. Exits 1 on the first mismatch.
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 path/to/compiler" >&2
+    exit 2
+fi
+
+cc=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+dir=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+cp "$dir"/*.src .
+
+failed=0
+for flags in "" "-O0" "--no-sccp" "--one-pass" "--flat"; do
+    "$cc" -j 2 $flags *.src > /dev/null 2>&1
+    for src in *.src; do
+        "$cc" $flags "$src" > /dev/null 2>&1
+        if ! cmp -s out.tac "${src%.src}.tac"; then
+            echo "FAIL: $src ${flags:-(default)}"
+            failed=1
+        fi
+    done
+done
+
+# --flat skips folding on the tree, which is what warns about a literal
+# zero divisor, so the warning shows whether the workers honored the flag
+printf 'int x = 1;\nint y = x / 0;\n' > zero.src
+if "$cc" -j 2 --flat zero.src 2>&1 | grep -q "division by constant zero"; then
+    echo "FAIL: -j ignored --flat"
+    failed=1
+fi
+if ! "$cc" -j 2 zero.src 2>&1 | grep -q "division by constant zero"; then
+    echo "FAIL: -j did not fold"
+    failed=1
+fi
+
+[ $failed -eq 0 ] && echo "Batch output matches single compiles"
+exit $failed
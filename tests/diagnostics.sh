@@ -0,0 +1,48 @@
+#!/bin/sh
+# tests/diagnostics.sh CC
+#
+# Compiles small programs and checks the warnings and errors the compiler
+# reports for them, line numbers included. Exits 1 on the first mismatch.
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 path/to/compiler" >&2
+    exit 2
+fi
+
+cc=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+failed=0
+
+# expect NAME SOURCE PATTERN: compiling SOURCE reports a line matching PATTERN
+expect() {
+    printf "$2" > test.src
+    "$cc" test.src > out 2>&1
+    if ! grep -q "$3" out; then
+        echo "FAIL: $1: no line matching '$3'"
+        head -5 out
+        failed=1
+    fi
+}
+
+# refuse NAME SOURCE PATTERN: no reported line matches PATTERN
+refuse() {
+    printf "$2" > test.src
+    "$cc" test.src > out 2>&1
+    if grep -q "$3" out; then
+        echo "FAIL: $1: unexpected '$(grep -m1 "$3" out)'"
+        failed=1
+    fi
+}
+
+zero="division by constant zero at line"
+expect "variable over zero"   'int x = 5;\nint y = x / 0;\nprint y;\n'            "$zero 2 "
+expect "constant over zero"   'int y = 7 / 0;\nprint y;\n'                         "$zero 1 "
+expect "zero after folding"   'int x = 1;\n\nprint x / (3 - 3);\n'                 "$zero 3 "
+expect "zero in a condition"  'int x = 1;\nwhile (x / 0 > 1) {\n    x = 2;\n}\n'   "$zero 2 "
+refuse "nonzero divisor"      'int x = 5;\nprint x / 2;\nprint x / (1 - 2);\n'     "$zero"
+
+[ $failed -eq 0 ] && echo "All diagnostics reported"
+exit $failed
@@ -0,0 +1,36 @@
+#!/bin/sh
+# tests/dispatch.sh CC SWITCH_CC [file.src...]
+#
+# Runs each program (default: tests/*.src) under `--bench-vm 1` with two
+# builds of the compiler: CC with the default computed-goto dispatch, and
+# SWITCH_CC built with -DVM_SWITCH_DISPATCH. Both interpreters must report
+# the same number of executed instructions. Exits 1 on the first mismatch.
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 path/to/compiler path/to/switch-dispatch-compiler [file.src...]" >&2
+    exit 2
+fi
+
+cc=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+switch_cc=$(cd "$(dirname "$2")" && pwd)/$(basename "$2")
+shift 2
+dir=$(cd "$(dirname "$0")" && pwd)
+[ $# -gt 0 ] || set -- "$dir"/*.src
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+failed=0
+for src in "$@"; do
+    for flags in "" "-O0" "--no-sccp"; do
+        "$cc" $flags "$src" --bench-vm 1 | grep '^VM:' | cut -d' ' -f2 > goto
+        "$switch_cc" $flags "$src" --bench-vm 1 | grep '^VM:' | cut -d' ' -f2 > switch
+        if [ ! -s goto ] || ! cmp -s goto switch; then
+            echo "FAIL: $(basename "$src") ${flags:-(default)}: computed goto $(cat goto), switch $(cat switch)"
+            failed=1
+        fi
+    done
+done
+
+[ $failed -eq 0 ] && echo "Both dispatch loops agree on $# files"
+exit $failed
@@ -0,0 +1,31 @@
+#!/bin/sh
+# tests/lex_diff.sh CC [file.src...]
+#
+# Runs `CC --lex-diff` on each file (default: tests/*.src and
+# tests/lex/*.src), which scans it with flex and every hand-written scanner
+# this CPU supports and stops at the first token they disagree on. The
+# files in tests/lex put runs of each length around the 16- and 32-byte
+# blocks at the end of the input, and include characters no token starts
+# with. Exits 1 if any file differs.
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 path/to/compiler [file.src...]" >&2
+    exit 2
+fi
+
+cc=$1
+shift
+dir=$(cd "$(dirname "$0")" && pwd)
+[ $# -gt 0 ] || set -- "$dir"/*.src "$dir"/lex/*.src
+
+failed=0
+for src in "$@"; do
+    if ! "$cc" --lex-diff "$src" > /dev/null 2>&1; then
+        echo "FAIL: $src"
+        "$cc" --lex-diff "$src" 2>&1 | grep -v '^Lex diff:' | head -5
+        failed=1
+    fi
+done
+
+[ $failed -eq 0 ] && echo "Scanners agree on $# files"
+exit $failed
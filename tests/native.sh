@@ -0,0 +1,53 @@
+#!/bin/sh
+# tests/native.sh CC [FILE...]
+#
+# Checks the -S backend against the VM: compiles each program with
+# `CC FLAGS FILE --run -S` under each setting below, assembles out.s with
+# $ASM_CC (default cc), runs it and compares its output with what --run
+# printed. Defaults to every tests/*.src. Exits 1 on any mismatch.
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 path/to/compiler [file.src...]" >&2
+    exit 2
+fi
+
+cc=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+shift
+dir=$(cd "$(dirname "$0")" && pwd)
+asm_cc=${ASM_CC:-cc}
+if [ $# -eq 0 ]; then
+    set -- "$dir"/*.src
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+count=0
+for src in "$@"; do
+    case $src in /*) ;; *) src=$(pwd)/$src ;; esac
+    # --no-sccp keeps arithmetic that SCCP would fold away, and
+    # --max-temps 2 forces most temps into stack slots.
+    for flags in "" "-O0" "--no-sccp" "--no-sccp --max-temps 2"; do
+        name="$(basename "$src") ${flags:-(default)}"
+        (cd "$work" && rm -f out.s &&
+            "$cc" $flags "$src" --run -S > log 2>&1) ||
+            { echo "FAIL: $name: compile"; failed=1; continue; }
+        sed -n '/-EXECUTION-/,$p' "$work/log" | grep -E '^-?[0-9]+$' > "$work/vm"
+        if ! "$asm_cc" -o "$work/program" "$work/out.s"; then
+            echo "FAIL: $name: assemble"
+            failed=1
+            continue
+        fi
+        "$work/program" > "$work/native"
+        if ! cmp -s "$work/vm" "$work/native"; then
+            echo "FAIL: $name"
+            diff "$work/vm" "$work/native" | head -10
+            failed=1
+        fi
+        count=$((count + 1))
+    done
+done
+
+[ $failed -eq 0 ] && echo "Native output matches the VM in $count runs"
+exit $failed
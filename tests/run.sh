@@ -0,0 +1,38 @@
+#!/bin/sh
+# tests/run.sh CC
+#
+# Runs every tests/*.src that has a .expected file next to it through
+# `CC FILE --run` with each optimization setting below, and compares the
+# values the program prints with the .expected file. Exits 1 on the first
+# mismatch.
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 path/to/compiler" >&2
+    exit 2
+fi
+
+cc=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+dir=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+failed=0
+for src in "$dir"/*.src; do
+    expected=${src%.src}.expected
+    [ -f "$expected" ] || continue
+    for flags in "" "-O0" "--no-sccp" "--one-pass" "--flat"; do
+        # The program's output follows the EXECUTION banner; status lines
+        # after it never start with a number.
+        "$cc" $flags "$src" --run 2>&1 |
+            sed -n '/-EXECUTION-/,$p' | grep -E '^-?[0-9]+$' > actual
+        if ! cmp -s actual "$expected"; then
+            echo "FAIL: $(basename "$src") ${flags:-(default)}"
+            diff "$expected" actual | head -10
+            failed=1
+        fi
+    done
+done
+
+[ $failed -eq 0 ] && echo "All tests passed"
+exit $failed
@@ -0,0 +1,63 @@
+#!/bin/sh
+# tests/tacbin.sh CC
+#
+# Writes a small program with `CC --binary`, then loads copies of out.tacb
+# with one field corrupted each. Every copy must be refused with "not a
+# usable binary TAC file" before anything runs; the untouched file must
+# load and print what the compiled program prints. Exits 1 otherwise.
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 path/to/compiler" >&2
+    exit 2
+fi
+
+cc=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+# At -O0 this is, one 16-byte record each from offset 64:
+#   x = 3 / t0 = x + 4 / y = t0 / print y
+printf 'int x = 3;\nint y = x + 4;\nprint(y);\n' > good.src
+"$cc" -O0 good.src --binary > /dev/null || exit 1
+cp out.tacb good.tacb
+
+failed=0
+if ! "$cc" --load good.tacb --run 2>&1 | grep -qx 7; then
+    echo "FAIL: unmodified file did not load and print 7"
+    failed=1
+fi
+
+# reject NAME OFFSET BYTES: overwrite BYTES (printf escapes) at OFFSET
+reject() {
+    cp good.tacb bad.tacb
+    printf "$3" | dd of=bad.tacb bs=1 seek="$2" conv=notrunc 2> /dev/null
+    if "$cc" --load bad.tacb --run > out 2>&1 || ! grep -q "not a usable binary TAC file" out; then
+        echo "FAIL: $1 was not rejected"
+        head -5 out
+        failed=1
+    fi
+}
+
+# Operand kinds: op, dst_kind, a_kind, b_kind start each record
+reject "add imm, imm -> imm"     80 '\001\003\003\003'
+reject "copy into an immediate"  64 '\000\003\003\000'
+reject "add reading a label"     80 '\001\001\004\003'
+reject "add with no right side"  80 '\001\001\002\000'
+reject "print with a dst"       112 '\013\002\002\000'
+reject "print of nothing"       112 '\013\000\000\000'
+reject "goto to a variable"     112 '\015\002\000\000'
+reject "label with an operand"  112 '\016\004\002\000'
+reject "unknown opcode"          64 '\177'
+reject "unknown operand kind"    64 '\000\002\011'
+
+# Operand values and the header
+reject "variable out of range"   68 '\011'
+reject "temp out of range"       84 '\011'
+reject "bad magic"                0 'TACX'
+reject "unsupported version"      4 '\007'
+reject "count too large"          8 '\000\000\000\200'
+reject "code out of bounds"      32 '\000\001'
+
+[ $failed -eq 0 ] && echo "All malformed files rejected"
+exit $failed
@@ -0,0 +1,40 @@
+// trace.c
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "trace.h"
+
+int trace_mask = TRACE_ALL;
+
+static const char* category_name(int category) {
+    switch (category) {
+        case TRACE_AST:      return "ast";
+        case TRACE_SEMANTIC: return "semantic";
+        case TRACE_SYMBOLS:  return "symbols";
+        default:             return "trace";
+    }
+}
+
+void trace_printf(int category, const char* fmt, ...) {
+    printf("[%s] ", category_name(category));
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+int trace_parse_categories(const char* list) {
+    int mask = 0;
+    while (*list) {
+        size_t n = strcspn(list, ",");
+        if (n == 3 && strncmp(list, "all", 3) == 0) mask |= TRACE_ALL;
+        else if (n == 3 && strncmp(list, "ast", 3) == 0) mask |= TRACE_AST;
+        else if (n == 8 && strncmp(list, "semantic", 8) == 0) mask |= TRACE_SEMANTIC;
+        else if (n == 7 && strncmp(list, "symbols", 7) == 0) mask |= TRACE_SYMBOLS;
+        else return -1;
+        list += n;
+        if (*list == ',') list++;
+    }
+    return mask;
+}
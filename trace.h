@@ -0,0 +1,47 @@
+// trace.h
+//
+// Diagnostic tracing by level and category. A TRACE() whose level is above
+// TRACE_LEVEL, or whose category is not in TRACE_CATEGORIES, is a constant
+// false branch and compiles to nothing, arguments included. Both are build
+// flags, e.g. -DTRACE_LEVEL=TRACE_DEBUG -DTRACE_CATEGORIES=TRACE_SEMANTIC.
+// Traces that are compiled in can still be filtered at run time (--trace).
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Levels
+#define TRACE_OFF       0
+#define TRACE_INFO      1   // phase progress
+#define TRACE_DEBUG     2   // per node and per symbol
+#define TRACE_VERBOSE   3   // raw node dumps
+
+// Categories
+#define TRACE_AST       (1 << 0)
+#define TRACE_SEMANTIC  (1 << 1)
+#define TRACE_SYMBOLS   (1 << 2)
+#define TRACE_ALL       (TRACE_AST | TRACE_SEMANTIC | TRACE_SYMBOLS)
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_OFF
+#endif
+
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES TRACE_ALL
+#endif
+
+// Categories enabled at run time; all of them unless --trace narrows it
+extern int trace_mask;
+
+void trace_printf(int category, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define TRACE(category, level, ...) \
+    do { \
+        if ((level) <= TRACE_LEVEL && ((category) & TRACE_CATEGORIES) && \
+            (trace_mask & (category))) \
+            trace_printf((category), __VA_ARGS__); \
+    } while (0)
+
+// Parses "ast,semantic,symbols" or "all" into a mask; -1 on an unknown name
+int trace_parse_categories(const char* list);
+
+#endif
@@ -0,0 +1,254 @@
+// vm.c
+//
+// Register bytecode interpreter for the TAC. Variables, temporaries and
+// constants all live in one flat int32 slot array, so every instruction is
+// just an opcode and three slot indices (or a jump target).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "vm.h"
+
+typedef enum {
+    VM_MOV,
+    VM_ADD,
+    VM_SUB,
+    VM_MUL,
+    VM_DIV,
+    VM_EQ,
+    VM_NE,
+    VM_LT,
+    VM_LE,
+    VM_GT,
+    VM_GE,
+    VM_PRINT,
+    VM_JNZ,     // if slot[a] != 0 jump to dst
+    VM_JMP,     // jump to dst
+    VM_JEQ,     // if slot[a] op slot[b] jump to dst
+    VM_JNE,
+    VM_JLT,
+    VM_JLE,
+    VM_JGT,
+    VM_JGE,
+    VM_SHL,
+    VM_SHR,
+    VM_HALT
+} VMOp;
+
+typedef struct {
+    int32_t op;
+    int32_t dst;
+    int32_t a;
+    int32_t b;
+} VMInstr;
+
+typedef struct {
+    VMInstr* code;
+    int count;
+    int32_t* slots;
+    int slot_count;
+} VMProgram;
+
+static void* checked_malloc(size_t size) {
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+// Slot layout: [variables][temporaries][spill slots][constants]
+static int32_t slot_of(const TacProgram* prog, VMProgram* vm, TacOperand o) {
+    switch (o.kind) {
+        case OPND_VAR:  return o.value;
+        case OPND_TEMP: return prog->var_count + o.value;
+        case OPND_SPILL: return prog->var_count + prog->temp_count + o.value;
+        case OPND_IMM:
+            vm->slots[vm->slot_count] = o.value;
+            return vm->slot_count++;
+        default:        return 0;
+    }
+}
+
+static void lower(const TacProgram* prog, VMProgram* vm) {
+    int* label_pc = checked_malloc(sizeof(int) * (prog->label_count + 1));
+    int pc = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (prog->code[i].op == TAC_LABEL) label_pc[prog->code[i].dst] = pc;
+        else pc++;
+    }
+
+    // Each instruction has at most two immediates
+    int fixed_slots = prog->var_count + prog->temp_count + prog->spill_count;
+    int max_slots = fixed_slots + 2 * prog->count;
+    vm->slots = checked_malloc(sizeof(int32_t) * max_slots);
+    memset(vm->slots, 0, sizeof(int32_t) * max_slots);
+    vm->slot_count = fixed_slots;
+    vm->code = checked_malloc(sizeof(VMInstr) * (pc + 1));
+    vm->count = 0;
+
+    for (int i = 0; i < prog->count; i++) {
+        const TACInstruction* ins = &prog->code[i];
+        VMInstr* out = &vm->code[vm->count];
+        memset(out, 0, sizeof(*out));
+        switch ((TacOp)ins->op) {
+            case TAC_LABEL:
+                continue;
+            case TAC_COPY:
+                out->op = VM_MOV;
+                out->dst = slot_of(prog, vm, tac_dst(ins));
+                out->a = slot_of(prog, vm, tac_a(ins));
+                break;
+            case TAC_PRINT:
+                out->op = VM_PRINT;
+                out->a = slot_of(prog, vm, tac_a(ins));
+                break;
+            case TAC_IFGOTO:
+                out->op = VM_JNZ;
+                out->dst = label_pc[ins->dst];
+                out->a = slot_of(prog, vm, tac_a(ins));
+                break;
+            case TAC_GOTO:
+                out->op = VM_JMP;
+                out->dst = label_pc[ins->dst];
+                break;
+            case TAC_IF_EQ:
+            case TAC_IF_NE:
+            case TAC_IF_LT:
+            case TAC_IF_LE:
+            case TAC_IF_GT:
+            case TAC_IF_GE:
+                out->op = VM_JEQ + (ins->op - TAC_IF_EQ);
+                out->dst = label_pc[ins->dst];
+                out->a = slot_of(prog, vm, tac_a(ins));
+                out->b = slot_of(prog, vm, tac_b(ins));
+                break;
+            case TAC_SHL:
+            case TAC_SHR:
+                out->op = VM_SHL + (ins->op - TAC_SHL);
+                out->dst = slot_of(prog, vm, tac_dst(ins));
+                out->a = slot_of(prog, vm, tac_a(ins));
+                out->b = slot_of(prog, vm, tac_b(ins));
+                break;
+            default:
+                // Binary operators share their order with VMOp
+                out->op = VM_ADD + (ins->op - TAC_ADD);
+                out->dst = slot_of(prog, vm, tac_dst(ins));
+                out->a = slot_of(prog, vm, tac_a(ins));
+                out->b = slot_of(prog, vm, tac_b(ins));
+                break;
+        }
+        vm->count++;
+    }
+    vm->code[vm->count].op = VM_HALT;
+    free(label_pc);
+}
+
+// Computed goto where available; build with -DVM_SWITCH_DISPATCH to force
+// the portable switch loop.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(VM_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+// Two's-complement wrap-around instead of signed overflow
+#define WRAP(expr) ((int32_t)(uint32_t)(expr))
+
+static int execute(VMProgram* vm, FILE* out, long long* executed) {
+    const VMInstr* ip = vm->code;
+    int32_t* s = vm->slots;
+    long long n = 0;
+
+#ifdef VM_COMPUTED_GOTO
+    static void* dispatch[] = {
+        &&op_MOV, &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV,
+        &&op_EQ, &&op_NE, &&op_LT, &&op_LE, &&op_GT, &&op_GE,
+        &&op_PRINT, &&op_JNZ, &&op_JMP,
+        &&op_JEQ, &&op_JNE, &&op_JLT, &&op_JLE, &&op_JGT, &&op_JGE,
+        &&op_SHL, &&op_SHR, &&op_HALT
+    };
+#define CASE(name) op_##name:
+#define NEXT do { n++; goto *dispatch[ip->op]; } while (0)
+    NEXT;
+#else
+#define CASE(name) case VM_##name:
+#define NEXT break
+    for (;;) {
+        n++;
+        switch (ip->op) {
+#endif
+
+    CASE(MOV)   s[ip->dst] = s[ip->a]; ip++; NEXT;
+    CASE(ADD)   s[ip->dst] = WRAP((uint32_t)s[ip->a] + (uint32_t)s[ip->b]); ip++; NEXT;
+    CASE(SUB)   s[ip->dst] = WRAP((uint32_t)s[ip->a] - (uint32_t)s[ip->b]); ip++; NEXT;
+    CASE(MUL)   s[ip->dst] = WRAP((uint32_t)s[ip->a] * (uint32_t)s[ip->b]); ip++; NEXT;
+    CASE(DIV)
+        if (s[ip->b] == 0) {
+            fprintf(stderr, "Runtime error: division by zero\n");
+            *executed = n;
+            return 1;
+        }
+        s[ip->dst] = s[ip->b] == -1 ? WRAP(0u - (uint32_t)s[ip->a]) : s[ip->a] / s[ip->b];
+        ip++; NEXT;
+    CASE(EQ)    s[ip->dst] = s[ip->a] == s[ip->b]; ip++; NEXT;
+    CASE(NE)    s[ip->dst] = s[ip->a] != s[ip->b]; ip++; NEXT;
+    CASE(LT)    s[ip->dst] = s[ip->a] <  s[ip->b]; ip++; NEXT;
+    CASE(LE)    s[ip->dst] = s[ip->a] <= s[ip->b]; ip++; NEXT;
+    CASE(GT)    s[ip->dst] = s[ip->a] >  s[ip->b]; ip++; NEXT;
+    CASE(GE)    s[ip->dst] = s[ip->a] >= s[ip->b]; ip++; NEXT;
+    CASE(PRINT)
+        if (out) fprintf(out, "%d\n", s[ip->a]);
+        ip++; NEXT;
+    CASE(JNZ)   ip = s[ip->a] ? vm->code + ip->dst : ip + 1; NEXT;
+    CASE(JMP)   ip = vm->code + ip->dst; NEXT;
+    CASE(JEQ)   ip = s[ip->a] == s[ip->b] ? vm->code + ip->dst : ip + 1; NEXT;
+    CASE(JNE)   ip = s[ip->a] != s[ip->b] ? vm->code + ip->dst : ip + 1; NEXT;
+    CASE(JLT)   ip = s[ip->a] <  s[ip->b] ? vm->code + ip->dst : ip + 1; NEXT;
+    CASE(JLE)   ip = s[ip->a] <= s[ip->b] ? vm->code + ip->dst : ip + 1; NEXT;
+    CASE(JGT)   ip = s[ip->a] >  s[ip->b] ? vm->code + ip->dst : ip + 1; NEXT;
+    CASE(JGE)   ip = s[ip->a] >= s[ip->b] ? vm->code + ip->dst : ip + 1; NEXT;
+    CASE(SHL)   s[ip->dst] = WRAP((uint32_t)s[ip->a] << (s[ip->b] & 31)); ip++; NEXT;
+    CASE(SHR) {
+        // Rounds toward zero like the division it replaces
+        int shift = s[ip->b] & 31;
+        uint32_t bias = shift ? (uint32_t)(s[ip->a] >> 31) >> (32 - shift) : 0;
+        s[ip->dst] = (int32_t)((uint32_t)s[ip->a] + bias) >> shift;
+        ip++; NEXT;
+    }
+    CASE(HALT)
+        *executed = n - 1;  // the halt itself does not count
+        return 0;
+
+#ifndef VM_COMPUTED_GOTO
+        }
+    }
+#endif
+#undef CASE
+#undef NEXT
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int vm_run(const TacProgram* prog, FILE* out, VMStats* stats) {
+    VMProgram vm;
+    lower(prog, &vm);
+
+    long long executed = 0;
+    double start = now_seconds();
+    int result = execute(&vm, out, &executed);
+    double elapsed = now_seconds() - start;
+
+    if (stats) {
+        stats->executed = executed;
+        stats->seconds = elapsed;
+    }
+    free(vm.code);
+    free(vm.slots);
+    return result;
+}
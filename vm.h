@@ -0,0 +1,18 @@
+// vm.h
+
+#ifndef VM_H
+#define VM_H
+
+#include <stdio.h>
+#include "tac.h"
+
+typedef struct {
+    long long executed;     // bytecode instructions dispatched
+    double seconds;         // time spent in the interpreter loop
+} VMStats;
+
+// Lowers the TAC to register bytecode and interprets it. `print` output goes
+// to `out` (NULL discards it). Returns 0 on success, 1 on a runtime error.
+int vm_run(const TacProgram* prog, FILE* out, VMStats* stats);
+
+#endif
@@ -0,0 +1,21 @@
+// walk.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "walk.h"
+
+void walk_grow(WalkStack* stack) {
+    stack->capacity = stack->capacity ? stack->capacity * 2 : 256;
+    stack->frames = realloc(stack->frames, sizeof(WalkFrame) * stack->capacity);
+    if (!stack->frames) {
+        fprintf(stderr, "Memory allocation failed for AST walk stack\n");
+        exit(1);
+    }
+}
+
+void walk_free(WalkStack* stack) {
+    free(stack->frames);
+    stack->frames = NULL;
+    stack->count = 0;
+    stack->capacity = 0;
+}
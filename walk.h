@@ -0,0 +1,41 @@
+// walk.h
+//
+// Explicit work stack for AST walks, so that nesting depth costs heap
+// memory instead of C stack. Each walker gives `state` and `data` its own
+// meaning: usually state 0 is "first visit" and later states resume the
+// node after a child has been processed.
+
+#ifndef WALK_H
+#define WALK_H
+
+#include <stdint.h>
+#include "ast.h"
+
+typedef struct {
+    ASTNode* node;
+    int state;
+    int32_t data[2];
+} WalkFrame;
+
+typedef struct {
+    WalkFrame* frames;
+    int count;
+    int capacity;
+} WalkStack;
+
+void walk_grow(WalkStack* stack);
+void walk_free(WalkStack* stack);
+
+static inline WalkFrame* walk_push(WalkStack* stack, ASTNode* node, int state) {
+    if (stack->count == stack->capacity) walk_grow(stack);
+    WalkFrame* frame = &stack->frames[stack->count++];
+    frame->node = node;
+    frame->state = state;
+    return frame;
+}
+
+static inline WalkFrame walk_pop(WalkStack* stack) {
+    return stack->frames[--stack->count];
+}
+
+#endif
@@ -0,0 +1,274 @@
+// x86.c
+//
+// Straightforward lowering of TAC to x86-64 (System V, AT&T syntax).
+// Variables are 32-bit globals, the first X86_TEMP_REGISTERS temps sit in
+// rbx/r12-r15 so they survive the print calls, and everything goes through
+// eax/ecx/edx/esi as scratch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "x86.h"
+
+static const char* temp_registers[X86_TEMP_REGISTERS] = {
+    "%ebx", "%r12d", "%r13d", "%r14d", "%r15d"
+};
+
+static const TacProgram* prog;
+static FILE* out;
+
+// Stack slots below the saved registers: temps past the register pool,
+// then spill slots
+static int frame_offset(int slot) {
+    return 44 + 4 * slot;
+}
+
+static void operand(TacOperand o, char* buf, size_t size) {
+    switch (o.kind) {
+        case OPND_IMM:
+            snprintf(buf, size, "$%d", o.value);
+            break;
+        case OPND_VAR:
+            snprintf(buf, size, "var_%s(%%rip)", prog->var_names[o.value]);
+            break;
+        case OPND_TEMP:
+            if (o.value < X86_TEMP_REGISTERS)
+                snprintf(buf, size, "%s", temp_registers[o.value]);
+            else
+                snprintf(buf, size, "-%d(%%rbp)", frame_offset(o.value - X86_TEMP_REGISTERS));
+            break;
+        case OPND_SPILL: {
+            int base = prog->temp_count > X86_TEMP_REGISTERS ? prog->temp_count - X86_TEMP_REGISTERS : 0;
+            snprintf(buf, size, "-%d(%%rbp)", frame_offset(base + o.value));
+            break;
+        }
+        default:
+            snprintf(buf, size, "$0");
+            break;
+    }
+}
+
+static int is_register(TacOperand o) {
+    return o.kind == OPND_TEMP && o.value < X86_TEMP_REGISTERS;
+}
+
+static void load(const char* reg, TacOperand o) {
+    char src[160];
+    operand(o, src, sizeof(src));
+    fprintf(out, "    movl %s, %s\n", src, reg);
+}
+
+static void store(TacOperand dst, const char* reg) {
+    char d[160];
+    operand(dst, d, sizeof(d));
+    fprintf(out, "    movl %s, %s\n", reg, d);
+}
+
+static const char* condition_suffix(TacOp op) {
+    switch (op) {
+        case TAC_EQ: case TAC_IF_EQ: return "e";
+        case TAC_NE: case TAC_IF_NE: return "ne";
+        case TAC_LT: case TAC_IF_LT: return "l";
+        case TAC_LE: case TAC_IF_LE: return "le";
+        case TAC_GT: case TAC_IF_GT: return "g";
+        case TAC_GE: case TAC_IF_GE: return "ge";
+        default:                     return "mp";
+    }
+}
+
+static void emit_instruction(const TACInstruction* ins) {
+    TacOperand dst = tac_dst(ins), a = tac_a(ins), b = tac_b(ins);
+    char bs[160];
+    operand(b, bs, sizeof(bs));
+
+    switch ((TacOp)ins->op) {
+        case TAC_COPY:
+            if (is_register(dst)) {
+                char d[160];
+                operand(dst, d, sizeof(d));
+                load(d, a);
+            } else {
+                load("%eax", a);
+                store(dst, "%eax");
+            }
+            break;
+
+        case TAC_ADD:
+        case TAC_SUB:
+        case TAC_MUL:
+            load("%eax", a);
+            fprintf(out, "    %s %s, %%eax\n",
+                    ins->op == TAC_ADD ? "addl" : ins->op == TAC_SUB ? "subl" : "imull", bs);
+            store(dst, "%eax");
+            break;
+
+        case TAC_DIV:
+            // Division by zero is a runtime error and INT_MIN / -1 wraps,
+            // matching the VM
+            load("%eax", a);
+            load("%ecx", b);
+            fprintf(out, "    testl %%ecx, %%ecx\n");
+            fprintf(out, "    je rt_div_zero\n");
+            fprintf(out, "    cmpl $-1, %%ecx\n");
+            fprintf(out, "    jne 1f\n");
+            fprintf(out, "    negl %%eax\n");
+            fprintf(out, "    jmp 2f\n");
+            fprintf(out, "1:\n");
+            fprintf(out, "    cltd\n");
+            fprintf(out, "    idivl %%ecx\n");
+            fprintf(out, "2:\n");
+            store(dst, "%eax");
+            break;
+
+        case TAC_EQ:
+        case TAC_NE:
+        case TAC_LT:
+        case TAC_LE:
+        case TAC_GT:
+        case TAC_GE:
+            load("%eax", a);
+            fprintf(out, "    cmpl %s, %%eax\n", bs);
+            fprintf(out, "    set%s %%al\n", condition_suffix((TacOp)ins->op));
+            fprintf(out, "    movzbl %%al, %%eax\n");
+            store(dst, "%eax");
+            break;
+
+        case TAC_IF_EQ:
+        case TAC_IF_NE:
+        case TAC_IF_LT:
+        case TAC_IF_LE:
+        case TAC_IF_GT:
+        case TAC_IF_GE:
+            load("%eax", a);
+            fprintf(out, "    cmpl %s, %%eax\n", bs);
+            fprintf(out, "    j%s .LL%d\n", condition_suffix((TacOp)ins->op), ins->dst);
+            break;
+
+        case TAC_IFGOTO:
+            load("%eax", a);
+            fprintf(out, "    testl %%eax, %%eax\n");
+            fprintf(out, "    jne .LL%d\n", ins->dst);
+            break;
+
+        case TAC_GOTO:
+            fprintf(out, "    jmp .LL%d\n", ins->dst);
+            break;
+
+        case TAC_LABEL:
+            fprintf(out, ".LL%d:\n", ins->dst);
+            break;
+
+        case TAC_PRINT:
+            load("%edi", a);
+            fprintf(out, "    call rt_print\n");
+            break;
+
+        case TAC_SHL:
+            load("%eax", a);
+            if (b.kind == OPND_IMM) {
+                fprintf(out, "    shll $%d, %%eax\n", b.value & 31);
+            } else {
+                load("%ecx", b);
+                fprintf(out, "    shll %%cl, %%eax\n");
+            }
+            store(dst, "%eax");
+            break;
+
+        case TAC_SHR:
+            // A negative value gets 2^n - 1 added first, so sar truncates
+            // toward zero like the division it replaces
+            load("%eax", a);
+            fprintf(out, "    cltd\n");
+            if (b.kind == OPND_IMM) {
+                int shift = b.value & 31;
+                fprintf(out, "    andl $%u, %%edx\n", shift ? (1u << shift) - 1 : 0u);
+                fprintf(out, "    addl %%edx, %%eax\n");
+                fprintf(out, "    sarl $%d, %%eax\n", shift);
+            } else {
+                load("%ecx", b);
+                fprintf(out, "    movl $-1, %%esi\n");
+                fprintf(out, "    shll %%cl, %%esi\n");
+                fprintf(out, "    notl %%esi\n");
+                fprintf(out, "    andl %%esi, %%edx\n");
+                fprintf(out, "    addl %%edx, %%eax\n");
+                fprintf(out, "    sarl %%cl, %%eax\n");
+            }
+            store(dst, "%eax");
+            break;
+    }
+}
+
+void emit_x86_to_file(const TacProgram* program, const char* filename) {
+    out = fopen(filename, "w");
+    if (!out) {
+        perror("fopen");
+        exit(1);
+    }
+    prog = program;
+
+    int stack_slots = prog->spill_count;
+    if (prog->temp_count > X86_TEMP_REGISTERS) stack_slots += prog->temp_count - X86_TEMP_REGISTERS;
+    // rbp and five saved registers leave rsp 8 bytes off 16-byte alignment
+    int frame = ((4 * stack_slots + 15) & ~15) + 8;
+
+    fprintf(out, "    .text\n");
+    fprintf(out, "    .globl main\n");
+    fprintf(out, "    .type main, @function\n");
+    fprintf(out, "main:\n");
+    fprintf(out, "    pushq %%rbp\n");
+    fprintf(out, "    movq %%rsp, %%rbp\n");
+    fprintf(out, "    pushq %%rbx\n");
+    fprintf(out, "    pushq %%r12\n");
+    fprintf(out, "    pushq %%r13\n");
+    fprintf(out, "    pushq %%r14\n");
+    fprintf(out, "    pushq %%r15\n");
+    fprintf(out, "    subq $%d, %%rsp\n", frame);
+
+    for (int i = 0; i < prog->count; i++) {
+        emit_instruction(&prog->code[i]);
+    }
+
+    fprintf(out, "    xorl %%eax, %%eax\n");
+    fprintf(out, "    leaq -40(%%rbp), %%rsp\n");
+    fprintf(out, "    popq %%r15\n");
+    fprintf(out, "    popq %%r14\n");
+    fprintf(out, "    popq %%r13\n");
+    fprintf(out, "    popq %%r12\n");
+    fprintf(out, "    popq %%rbx\n");
+    fprintf(out, "    popq %%rbp\n");
+    fprintf(out, "    ret\n");
+    fprintf(out, "    .size main, .-main\n\n");
+
+    // Runtime: print one int per line, and the division-by-zero trap
+    fprintf(out, "rt_print:\n");
+    fprintf(out, "    subq $8, %%rsp\n");
+    fprintf(out, "    movl %%edi, %%esi\n");
+    fprintf(out, "    leaq .Lprint_format(%%rip), %%rdi\n");
+    fprintf(out, "    xorl %%eax, %%eax\n");
+    fprintf(out, "    call printf@PLT\n");
+    fprintf(out, "    addq $8, %%rsp\n");
+    fprintf(out, "    ret\n\n");
+    fprintf(out, "rt_div_zero:\n");
+    fprintf(out, "    andq $-16, %%rsp\n");
+    fprintf(out, "    movq stderr@GOTPCREL(%%rip), %%rax\n");
+    fprintf(out, "    movq (%%rax), %%rsi\n");
+    fprintf(out, "    leaq .Ldiv_zero_message(%%rip), %%rdi\n");
+    fprintf(out, "    call fputs@PLT\n");
+    fprintf(out, "    movl $1, %%edi\n");
+    fprintf(out, "    call exit@PLT\n\n");
+
+    fprintf(out, "    .section .rodata\n");
+    fprintf(out, ".Lprint_format:\n");
+    fprintf(out, "    .string \"%%d\\n\"\n");
+    fprintf(out, ".Ldiv_zero_message:\n");
+    fprintf(out, "    .string \"Runtime error: division by zero\\n\"\n\n");
+
+    fprintf(out, "    .bss\n");
+    for (int v = 0; v < prog->var_count; v++) {
+        fprintf(out, "    .lcomm var_%s, 4\n", prog->var_names[v]);
+    }
+    fprintf(out, "    .section .note.GNU-stack,\"\",@progbits\n");
+
+    fclose(out);
+    out = NULL;
+    prog = NULL;
+}
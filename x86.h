@@ -0,0 +1,16 @@
+// x86.h
+
+#ifndef X86_H
+#define X86_H
+
+#include "tac.h"
+
+// Number of temps the backend keeps in callee-saved registers; the rest of
+// the temp pool and every spill slot live in the stack frame.
+#define X86_TEMP_REGISTERS 5
+
+// Writes GNU as x86-64 assembly for a standalone program (`main` plus a
+// small print runtime) that links against libc: cc out.s -o prog
+void emit_x86_to_file(const TacProgram* prog, const char* filename);
+
+#endif